@@ -0,0 +1,285 @@
+/*
+ * bench_hexfmt — Cost of formatting hex rows
+ *
+ * Formats the same random bytes into `OFFSET  XX XX ..  |ascii|` rows the
+ * way the view used to (one snprintf() per byte) and through each vib_hex
+ * path, for rows of 16 and 64 bytes in words of 1 and 4 bytes, and prints
+ * ns per row and GB/s of input. Before timing, every path's text is
+ * compared with the printf baseline for all partial row lengths of every
+ * width with a row kernel (and one without) and every word size. Byte classification is timed the
+ * same way over the whole input, after a check against VIB_HEX_CLASS.
+ *
+ * Usage: bench_hexfmt [--size=MIB] [--rounds=N]
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "common.h"
+#include "cstr.h"
+#include "memory.h"
+#include "vib_hex.h"
+
+#define BENCH_LINE_CAPACITY     (1024UL)
+
+typedef COPIED uint64_t (bench_format_fn) (BORROWED char * line, BORROWED const uint8_t * data, COPIED uint64_t offset, COPIED uint64_t length, COPIED uint64_t width, COPIED uint64_t word);
+
+static COPIED double bench_now_()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+/* What the view did before vib_hex: a printf per byte. */
+static COPIED uint64_t bench_printf_(BORROWED char * line, BORROWED const uint8_t * data, COPIED uint64_t offset, COPIED uint64_t length, COPIED uint64_t width, COPIED uint64_t word)
+{
+    COPIED int n = snprintf(line, BENCH_LINE_CAPACITY, "%08lX  ", offset);
+    for (uint64_t i = 0; i < width; i++)
+    {
+        if (i > 0 && EQ(i % 8, 0))
+        {
+            n += snprintf(line + n, BENCH_LINE_CAPACITY - (uint64_t) n, " ");
+        }
+        if (i >= length)
+        {
+            n += snprintf(line + n, BENCH_LINE_CAPACITY - (uint64_t) n, "  ");
+        }
+        else
+        {
+            n += snprintf(line + n, BENCH_LINE_CAPACITY - (uint64_t) n, "%02X", data[i]);
+        }
+        if (EQ((i + 1) % word, 0))
+        {
+            n += snprintf(line + n, BENCH_LINE_CAPACITY - (uint64_t) n, " ");
+        }
+    }
+    n += snprintf(line + n, BENCH_LINE_CAPACITY - (uint64_t) n, " |");
+    for (uint64_t i = 0; i < length; i++)
+    {
+        COPIED uint8_t b = data[i];
+        n += snprintf(line + n, BENCH_LINE_CAPACITY - (uint64_t) n, "%c", (0x20 <= b && b < 0x7f) ? (char) b : '.');
+    }
+    n += snprintf(line + n, BENCH_LINE_CAPACITY - (uint64_t) n, "|");
+    return (uint64_t) n;
+}
+
+/* The view's row layout built from the vib_hex pieces; the path is whatever vib_hex_use() last pinned. */
+static COPIED uint64_t bench_hex_(BORROWED char * line, BORROWED const uint8_t * data, COPIED uint64_t offset, COPIED uint64_t length, COPIED uint64_t width, COPIED uint64_t word)
+{
+    COPIED uint64_t n = vib_hex_offset(line, offset, 8);
+    line[n++] = ' ';
+    line[n++] = ' ';
+    n += vib_hex_digits(line + n, data, length, width, word);
+    line[n++] = ' ';
+    line[n++] = '|';
+    n += vib_hex_ascii(line + n, data, length);
+    line[n++] = '|';
+    line[n]   = '\0';
+    return n;
+}
+
+/* Every partial length of every row shape must come out as the baseline does. */
+static COPIED bool bench_verify_(BORROWED const uint8_t * data)
+{
+    char expected[BENCH_LINE_CAPACITY];
+    char actual[BENCH_LINE_CAPACITY];
+
+    COPIED uint64_t widths[] = { 8, 16, 24, 32, 64 };
+    for (uint64_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++)
+    {
+        COPIED uint64_t width = widths[w];
+        for (uint64_t word = 1; word <= VIB_HEX_WORD_MAX && EQ(width % word, 0); word *= 2)
+        {
+            for (uint64_t length = 0; length <= width; length++)
+            {
+                for (uint64_t start = 0; start < 4 * width; start += width + 3)
+                {
+                    COPIED uint64_t n = bench_printf_(expected, data + start, start * 0x1F3, length, width, word);
+                    COPIED uint64_t m = bench_hex_(actual, data + start, start * 0x1F3, length, width, word);
+                    if (!EQ(n, m) || !EQ(memcmp(expected, actual, n + 1), 0))
+                    {
+                        fprintf(stderr, "bench_hexfmt: row of %lu/%lu bytes in words of %lu differs\n  want %s\n  got  %s\n",
+                                length, width, word, expected, actual);
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+/* Best time over `rounds` to format every row of `data`. */
+static COPIED double bench_run_(BORROWED bench_format_fn * format, BORROWED const uint8_t * data, COPIED uint64_t size, COPIED uint64_t width, COPIED uint64_t word, COPIED uint64_t rounds, BORROWED uint64_t * sink)
+{
+    char   line[BENCH_LINE_CAPACITY];
+    double best = 0.0;
+
+    for (uint64_t round = 0; round < rounds; round++)
+    {
+        COPIED double start = bench_now_();
+        for (uint64_t offset = 0; offset + width <= size; offset += width)
+        {
+            *sink += format(line, data + offset, offset, width, width, word);
+            *sink += (uint8_t) line[width];
+        }
+        COPIED double seconds = bench_now_() - start;
+        if (EQ(round, 0) || seconds < best)
+        {
+            best = seconds;
+        }
+    }
+    return best;
+}
+
+/* Every path must label every length as the table does. */
+static COPIED bool bench_verify_classes_(BORROWED const uint8_t * data)
+{
+    uint8_t classes[256];
+
+    for (uint64_t length = 0; length <= sizeof(classes); length++)
+    {
+        vib_hex_classify(classes, data, length);
+        for (uint64_t i = 0; i < length; i++)
+        {
+            if (NEQ(classes[i], VIB_HEX_CLASS[data[i]]))
+            {
+                fprintf(stderr, "bench_hexfmt: byte 0x%02X of a %lu-byte run classified %u, want %u\n",
+                        data[i], length, classes[i], VIB_HEX_CLASS[data[i]]);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/* Best time over `rounds` to classify `data` in rows of `width`. */
+static COPIED double bench_classify_(BORROWED const uint8_t * data, COPIED uint64_t size, COPIED uint64_t width, COPIED uint64_t rounds, BORROWED uint64_t * sink)
+{
+    uint8_t classes[BENCH_LINE_CAPACITY];
+    double  best = 0.0;
+
+    for (uint64_t round = 0; round < rounds; round++)
+    {
+        COPIED double start = bench_now_();
+        for (uint64_t offset = 0; offset + width <= size; offset += width)
+        {
+            *sink += vib_hex_classify(classes, data + offset, width);
+            *sink += classes[width - 1];
+        }
+        COPIED double seconds = bench_now_() - start;
+        if (EQ(round, 0) || seconds < best)
+        {
+            best = seconds;
+        }
+    }
+    return best;
+}
+
+static void bench_report_(BORROWED const char * name, COPIED double seconds, COPIED uint64_t size, COPIED uint64_t width, COPIED double baseline)
+{
+    COPIED uint64_t rows = size / width;
+    printf("  %-10s %8.1f ns/row   %6.2f GB/s   %6.1fx\n",
+           name,
+           seconds * 1e9 / (double) rows,
+           (double) (rows * width) / seconds / 1e9,
+           baseline / seconds);
+}
+
+int main(int argc, char ** argv)
+{
+    COPIED uint64_t mib    = 16;
+    COPIED uint64_t rounds = 3;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (cstr_starts_with(argv[i], "--size="))
+        {
+            mib = strtoull(argv[i] + 7, NIL, 10);
+        }
+        else if (cstr_starts_with(argv[i], "--rounds="))
+        {
+            rounds = strtoull(argv[i] + 9, NIL, 10);
+        }
+    }
+    mib    = mib ? mib : 1;
+    rounds = rounds ? rounds : 1;
+
+    /* xorshift bytes: every value shows up, printable or not */
+    COPIED uint64_t   size  = mib << 20;
+    OWNED  uint64_t * words = new(size);
+    COPIED uint64_t   state = 0x9E3779B97F4A7C15UL;
+    for (uint64_t i = 0; i < size / sizeof(uint64_t); i++)
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        words[i] = state;
+    }
+    BORROWED const uint8_t * data = (const uint8_t *) words;
+
+    COPIED vib_hex_path_t paths[] = { VIB_HEX_SCALAR, VIB_HEX_SSE2, VIB_HEX_AVX2 };
+    COPIED uint64_t       widths[] = { 16, 64 };
+    COPIED uint64_t       word_sizes[] = { 1, 4 };
+    COPIED uint64_t       sink  = 0;
+    COPIED bool           same  = true;
+
+    for (uint64_t p = 0; p < sizeof(paths) / sizeof(paths[0]); p++)
+    {
+        if (EQ(vib_hex_use(paths[p]), paths[p]))
+        {
+            same = bench_verify_(data) && same;
+        }
+    }
+
+    printf("bench_hexfmt: %lu MiB of random bytes, best of %lu\n", mib, rounds);
+    for (uint64_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++)
+    {
+        for (uint64_t k = 0; k < sizeof(word_sizes) / sizeof(word_sizes[0]); k++)
+        {
+            COPIED uint64_t width    = widths[w];
+            COPIED uint64_t word     = word_sizes[k];
+            COPIED double   baseline = bench_run_(bench_printf_, data, size, width, word, rounds, &sink);
+
+            printf("rows of %lu bytes, words of %lu\n", width, word);
+            bench_report_("printf", baseline, size, width, baseline);
+            for (uint64_t p = 0; p < sizeof(paths) / sizeof(paths[0]); p++)
+            {
+                COPIED vib_hex_path_t used = vib_hex_use(paths[p]);
+                if (!EQ(used, paths[p]))
+                {
+                    printf("  %-10s n/a on this CPU\n", vib_hex_path_name(paths[p]));
+                    continue;
+                }
+                bench_report_(vib_hex_path_name(used), bench_run_(bench_hex_, data, size, width, word, rounds, &sink), size, width, baseline);
+            }
+        }
+    }
+
+    printf("classes, rows of 64 bytes\n");
+    COPIED double classify_baseline = 0.0;
+    for (uint64_t p = 0; p < sizeof(paths) / sizeof(paths[0]); p++)
+    {
+        COPIED vib_hex_path_t used = vib_hex_use(paths[p]);
+        if (!EQ(used, paths[p]))
+        {
+            printf("  %-10s n/a on this CPU\n", vib_hex_path_name(paths[p]));
+            continue;
+        }
+        same = bench_verify_classes_(data) && same;
+        COPIED double seconds = bench_classify_(data, size, 64, rounds, &sink);
+        if (EQ(p, 0))
+        {
+            classify_baseline = seconds;
+        }
+        bench_report_(vib_hex_path_name(used), seconds, size, 64, classify_baseline);
+    }
+
+    free_smart(words);
+    printf("  (sink %lu)\n", sink);
+    return same ? 0 : 1;
+}
@@ -0,0 +1,354 @@
+/*
+ * bench_huge — Scan throughput with and without huge pages
+ *
+ * Runs the same passes twice, once with ordinary pages and once with the
+ * vib_huge policy on, and prints GB/s for each:
+ *
+ *   - mapping:  map the file afresh and fold it front to back (page faults
+ *               included, as when a file is first opened);
+ *   - probes:   one 8 byte read in every 4 KiB of a fresh mapping, in random
+ *               order, which is where the TLB hurts most;
+ *   - cache:    fold the file through a vib_pcache large enough to hold it,
+ *               once to fill it and again from the resident pages;
+ *   - scan:     a vib_scan pass into its block ring.
+ *
+ * After each mode it prints how much of the process was backed by huge pages
+ * (AnonHugePages and FilePmdMapped from /proc/self/smaps_rollup); when these
+ * stay 0 the kernel declined (THP disabled, hugetlbfs pool empty, or no large
+ * folio support for file mappings on this filesystem).
+ *
+ * Usage: bench_huge [FILE] [--size=MIB] [--rounds=N]
+ *
+ * Without FILE a scratch file of --size MiB (default 1024) is created in
+ * /tmp and removed afterwards.
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "cstr.h"
+#include "memory.h"
+#include "vib_huge.h"
+#include "vib_pcache.h"
+#include "vib_scan.h"
+
+#define BENCH_PASSES    (5)
+
+typedef struct bench_result_t bench_result_t;
+
+struct bench_result_t
+{
+    COPIED uint64_t bytes;
+    COPIED uint64_t checksum;
+    COPIED double   seconds;
+};
+
+static const char * bench_names[BENCH_PASSES] = { "mapping", "probes", "cache fill", "cache resident", "scan" };
+
+static COPIED double bench_now_()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+static COPIED uint64_t bench_fold_(COPIED uint64_t sum, BORROWED const uint8_t * data, COPIED uint64_t length)
+{
+    for (uint64_t i = 0; i + 8 <= length; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        sum += word;
+    }
+    return sum;
+}
+
+/* Kilobytes of one smaps_rollup field, 0 if missing. */
+static COPIED uint64_t bench_smaps_(BORROWED const char * field)
+{
+    FILE * f = fopen("/proc/self/smaps_rollup", "r");
+    if (!f)
+    {
+        return 0;
+    }
+
+    char            line[256];
+    COPIED uint64_t kib = 0;
+    COPIED uint64_t len = strlen(field);
+    while (fgets(line, sizeof(line), f))
+    {
+        if (EQ(strncmp(line, field, len), 0) && EQ(line[len], ':'))
+        {
+            kib = strtoull(line + len + 1, NIL, 10);
+            break;
+        }
+    }
+    fclose(f);
+    return kib;
+}
+
+static void bench_backing_(BORROWED uint64_t * anon, BORROWED uint64_t * file)
+{
+    COPIED uint64_t a = bench_smaps_("AnonHugePages");
+    COPIED uint64_t f = bench_smaps_("FilePmdMapped");
+    *anon = (a > *anon) ? a : *anon;
+    *file = (f > *file) ? f : *file;
+}
+
+static OWNED uint8_t * bench_map_(COPIED int fd, COPIED uint64_t size, COPIED bool huge)
+{
+    void * map = huge ? vib_huge_map_file(fd, size) : mmap(NIL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (EQ(map, MAP_FAILED))
+    {
+        fprintf(stderr, "bench_huge: mmap failed: %s\n", strerror(errno));
+        exit(1);
+    }
+    return map;
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Passes
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+static COPIED bench_result_t bench_mapping_(COPIED int fd, COPIED uint64_t size, COPIED bool huge, BORROWED uint64_t * anon, BORROWED uint64_t * file)
+{
+    COPIED bench_result_t r     = { .bytes = size };
+    COPIED double         start = bench_now_();
+    OWNED  uint8_t      * map   = bench_map_(fd, size, huge);
+
+    r.checksum = bench_fold_(0, map, size);
+    r.seconds  = bench_now_() - start;
+    bench_backing_(anon, file);
+    munmap(map, size);
+    return r;
+}
+
+static COPIED bench_result_t bench_probes_(COPIED int fd, COPIED uint64_t size, COPIED bool huge)
+{
+    COPIED bench_result_t r     = { 0 };
+    COPIED uint64_t       pages = size / 4096;
+    COPIED double         start = bench_now_();
+    OWNED  uint8_t      * map   = bench_map_(fd, size, huge);
+
+    /* a full-period LCG over a power of two visits every page once, in no useful order */
+    COPIED uint64_t span = 1;
+    while (span < pages)
+    {
+        span <<= 1;
+    }
+    COPIED uint64_t x = 0;
+    for (uint64_t i = 0; i < span; i++)
+    {
+        x = (x * 6364136223846793005ULL + 1442695040888963407ULL) & (span - 1);
+        if (x < pages)
+        {
+            uint64_t word;
+            memcpy(&word, map + x * 4096, sizeof(word));
+            r.checksum += word;
+            r.bytes    += 4096;
+        }
+    }
+
+    r.seconds = bench_now_() - start;
+    munmap(map, size);
+    return r;
+}
+
+static COPIED int64_t bench_fill_(BORROWED void * ctx, BORROWED uint8_t * dst, COPIED uint64_t offset, COPIED uint64_t length)
+{
+    return pread(*CAST(ctx, int *), dst, length, (off_t) offset);
+}
+
+static COPIED uint64_t bench_cache_pass_(BORROWED vib_pcache_t * cache, COPIED uint64_t size)
+{
+    COPIED uint64_t sum = 0;
+    for (uint64_t offset = 0; offset < size; offset += VIB_PCACHE_PAGE_SIZE)
+    {
+        COPIED vib_span_t span = vib_pcache_span(cache, offset, VIB_PCACHE_PAGE_SIZE);
+        sum = bench_fold_(sum, span.data, span.length);
+    }
+    return sum;
+}
+
+static void bench_cache_(BORROWED int * fd, COPIED uint64_t size, BORROWED bench_result_t * fill, BORROWED bench_result_t * resident, BORROWED uint64_t * anon, BORROWED uint64_t * file)
+{
+    OWNED vib_pcache_t * cache = mk_vib_pcache(size + VIB_PCACHE_PAGE_SIZE, VIB_GOVERNOR_COST_READ, bench_fill_, fd);
+
+    COPIED double start = bench_now_();
+    fill->checksum = bench_cache_pass_(cache, size);
+    fill->seconds  = bench_now_() - start;
+    fill->bytes    = size;
+
+    start = bench_now_();
+    resident->checksum = bench_cache_pass_(cache, size);
+    resident->seconds  = bench_now_() - start;
+    resident->bytes    = size;
+
+    bench_backing_(anon, file);
+    vib_pcache_dispose(cache);
+}
+
+static COPIED bench_result_t bench_scan_(COPIED int fd, COPIED uint64_t size, BORROWED uint64_t * anon, BORROWED uint64_t * file)
+{
+    COPIED bench_result_t r     = { 0 };
+    COPIED double         start = bench_now_();
+    OWNED  vib_scan_t   * scan  = mk_vib_scan(fd, 0, size, VIB_SCAN_AUTO);
+
+    for (vib_span_t span = vib_scan_next(scan); span.length > 0; span = vib_scan_next(scan))
+    {
+        r.bytes   += span.length;
+        r.checksum = bench_fold_(r.checksum, span.data, span.length);
+    }
+    bench_backing_(anon, file);
+    vib_scan_dispose(scan);
+    r.seconds = bench_now_() - start;
+    return r;
+}
+
+/* Fill a scratch file with a cheap xorshift stream so nothing compresses or dedups. */
+static COPIED int bench_scratch_(BORROWED char * path, COPIED uint64_t size)
+{
+    int fd = mkstemp(path);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    OWNED  uint64_t * chunk = new(VIB_SCAN_BLOCK_SIZE);
+    COPIED uint64_t   state = 0x9E3779B97F4A7C15UL;
+    for (uint64_t written = 0; written < size; written += VIB_SCAN_BLOCK_SIZE)
+    {
+        for (uint64_t i = 0; i < VIB_SCAN_BLOCK_SIZE / sizeof(uint64_t); i++)
+        {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            chunk[i] = state;
+        }
+        if (write(fd, chunk, VIB_SCAN_BLOCK_SIZE) < 0)
+        {
+            free_smart(chunk);
+            close(fd);
+            return -1;
+        }
+    }
+    free_smart(chunk);
+    return fd;
+}
+
+int main(int argc, char ** argv)
+{
+    BORROWED const char * path   = NIL;
+    COPIED   uint64_t     mib    = 1024;
+    COPIED   uint64_t     rounds = 3;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (cstr_starts_with(argv[i], "--size="))
+        {
+            mib = strtoull(argv[i] + 7, NIL, 10);
+        }
+        else if (cstr_starts_with(argv[i], "--rounds="))
+        {
+            rounds = strtoull(argv[i] + 9, NIL, 10);
+        }
+        else
+        {
+            path = argv[i];
+        }
+    }
+    rounds = rounds ? rounds : 1;
+
+    char scratch[] = "/tmp/vib-bench-huge-XXXXXX";
+    if (!path)
+    {
+        int fd = bench_scratch_(scratch, mib << 20);
+        if (fd < 0)
+        {
+            fprintf(stderr, "bench_huge: cannot create %s: %s\n", scratch, strerror(errno));
+            return 1;
+        }
+        close(fd);
+        path = scratch;
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0 || EQ(st.st_size, 0))
+    {
+        fprintf(stderr, "bench_huge: cannot open %s: %s\n", path, fd < 0 ? strerror(errno) : "empty file");
+        return 1;
+    }
+    COPIED uint64_t size = (uint64_t) st.st_size & ~7UL;
+
+    printf("bench_huge: %s, %.1f MiB, page cache\n", path, (double) size / (1024.0 * 1024.0));
+
+    /* warm the page cache once so both modes compare pages, not the disk */
+    OWNED uint8_t * warm = bench_map_(fd, size, false);
+    bench_fold_(0, warm, size);
+    munmap(warm, size);
+
+    COPIED bool same = true;
+    COPIED uint64_t reference[BENCH_PASSES] = { 0 };
+    for (int mode = 0; mode < 2; mode++)
+    {
+        COPIED bool           huge  = EQ(mode, 1);
+        COPIED bench_result_t best[BENCH_PASSES] = { 0 };
+        COPIED uint64_t       anon  = 0;
+        COPIED uint64_t       file  = 0;
+
+        vib_huge_enable(huge);
+        for (uint64_t round = 0; round < rounds; round++)
+        {
+            COPIED bench_result_t r[BENCH_PASSES];
+            r[0] = bench_mapping_(fd, size, huge, &anon, &file);
+            r[1] = bench_probes_(fd, size, huge);
+            bench_cache_(&fd, size, &r[2], &r[3], &anon, &file);
+            r[4] = bench_scan_(fd, size, &anon, &file);
+            for (int i = 0; i < BENCH_PASSES; i++)
+            {
+                if (EQ(round, 0) || r[i].seconds < best[i].seconds)
+                {
+                    best[i] = r[i];
+                }
+            }
+        }
+
+        printf("%s\n", huge ? "huge pages" : "base pages");
+        for (int i = 0; i < BENCH_PASSES; i++)
+        {
+            printf("  %-16s %8.2f GB/s   %7.3f s   checksum %016lX\n",
+                   bench_names[i],
+                   (double) best[i].bytes / best[i].seconds / 1e9,
+                   best[i].seconds,
+                   best[i].checksum);
+            if (EQ(mode, 0))
+            {
+                reference[i] = best[i].checksum;
+            }
+            same = same && EQ(reference[i], best[i].checksum);
+        }
+        printf("  backed by huge pages: %lu KiB anonymous, %lu KiB file\n", anon, file);
+    }
+
+    close(fd);
+    if (path == scratch)
+    {
+        unlink(scratch);
+    }
+
+    if (!same)
+    {
+        fprintf(stderr, "bench_huge: checksums differ\n");
+    }
+    return same ? 0 : 1;
+}
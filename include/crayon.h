@@ -93,3 +93,47 @@ void crayon_bg_white(borrowed FILE * stream);
 void crayon_bg_gray(borrowed FILE * stream);
 
 void crayon_end(borrowed FILE * stream);
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Pen State
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+/*
+ * A pen is what the next character is drawn with. crayon_sgr() encodes the
+ * change from one pen to another as a single SGR sequence, choosing between
+ * switching off what goes away and starting from a reset, whichever is
+ * shorter, so adjacent cells that differ in one attribute or color cost a
+ * few bytes, not a full restatement.
+ */
+
+#define CRAYON_ATTR_BOLD            (1U << 0)
+#define CRAYON_ATTR_DIM             (1U << 1)
+#define CRAYON_ATTR_ITALIC          (1U << 2)
+#define CRAYON_ATTR_UNDERLINE       (1U << 3)
+#define CRAYON_ATTR_BLINK           (1U << 4)
+#define CRAYON_ATTR_REVERSED        (1U << 5)
+#define CRAYON_ATTR_STRIKETHRU      (1U << 6)
+
+/* Pen colors: the terminal default, an entry of the 256-color palette, or 24-bit RGB */
+#define CRAYON_COLOR_DEFAULT        (0U)
+#define CRAYON_COLOR_INDEX(n)       ((1U << 24) | ((uint32_t) (n) & 0xFFU))
+#define CRAYON_COLOR_RGB(r, g, b)   ((2U << 24) | (((uint32_t) (r) & 0xFFU) << 16) | (((uint32_t) (g) & 0xFFU) << 8) | ((uint32_t) (b) & 0xFFU))
+
+/* Longest crayon_sgr() output: a reset, every attribute and two RGB colors. */
+#define CRAYON_SGR_MAX              (64UL)
+
+typedef struct crayon_pen_t crayon_pen_t;
+
+struct crayon_pen_t
+{
+    copied uint32_t attrs;      /* CRAYON_ATTR_* */
+    copied uint32_t fg;         /* CRAYON_COLOR_* */
+    copied uint32_t bg;
+};
+
+/**
+ * Write to `dst` (CRAYON_SGR_MAX bytes) the shortest SGR sequence taking the
+ * terminal from pen `from` to pen `to`. Returns its length, 0 if the pens
+ * are the same.
+ */
+copied uint64_t crayon_sgr(borrowed char * dst, borrowed const crayon_pen_t * from, borrowed const crayon_pen_t * to);
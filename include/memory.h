@@ -12,10 +12,11 @@
  * free_smart(ptr):
  *      1. Frees the pointer if not NIL.
  *      2. Sets the pointer to NIL after freeing.
+ *      3. Only for blocks from the helpers below, which account for them.
  */
 #define free_smart(ptr)                                             \
         do {                                                        \
-            if ( (ptr) ) free( ptr );                               \
+            if ( (ptr) ) free_( ptr );                              \
             ptr = NIL;                                              \
         } while (0)
 
@@ -35,11 +36,24 @@
 #define zeros(n)                                                    \
         zeros_( n )
 
+/**
+ * new_aligned(alignment, bytes):
+ *      1. Allocates `n` bytes whose address is a multiple of `alignment`.
+ *      2. Aborts the program if failed to allocate.
+ *      3. Released with free_smart() / dispose() like any other block.
+ */
+#define new_aligned(a, n)                                           \
+        new_aligned_( a, n )
+
 
 // -------------------------------------------------------------
 // | Memory Allocation Helpers |
 // -------------------------------------------------------------
+// Every block is reported to vib_governor, which keeps the process
+// within its memory budget.
 OWNED void * new_(COPIED uint64_t bytes);
 OWNED void * zeros_(COPIED uint64_t bytes);
+OWNED void * new_aligned_(COPIED uint64_t alignment, COPIED uint64_t bytes);
 OWNED void * realloc_smart(OWNED void * arg, COPIED uint64_t new_bytes);
+void free_(OWNED void * ptr);
 COPIED void * dispose(OWNED void * arg);
@@ -0,0 +1,196 @@
+#pragma once
+
+/*
+ * vib_buffer — File buffer module
+ *
+ * Gives the renderer zero-copy access to the bytes of the opened file.
+ * Regular files are mapped read-only, so opening costs the same for a
+ * 4 KiB config file and an 80 GB disk image: nothing is read up front,
+ * pages are faulted in as the renderer touches them.
+ *
+ * Block devices are read with O_DIRECT into the same cache, in whole
+ * logical blocks, so browsing a production disk leaves the kernel page
+ * cache to the workload that owns it.
+ *
+ * Inputs that cannot be mapped (/proc files, character devices, some FUSE
+ * mounts) go through a paged read cache instead and expose the same spans.
+ *
+ * Pipes and sockets (including stdin as "-") are streamed into an
+ * append-only store; the buffer grows while the writer keeps sending.
+ * In follow mode, regular files grow the same way, woken by inotify.
+ *
+ * gzip files are shown decompressed: a checkpoint index built on the first
+ * open lets any offset be reached by inflating at most a few MiB, and the
+ * decompressed pages live in the same bounded cache.
+ *
+ * Sparse regular files have their holes mapped once with SEEK_DATA and
+ * SEEK_HOLE, so callers can step over terabytes of zeros without reading them.
+ *
+ * Edits never touch the backend: the first one lays a piece table over the
+ * original bytes and spans are resolved through it from then on.
+ */
+#include "common.h"
+#include "result.h"
+
+#define VIB_BUFFER_STDIN    "-"
+
+typedef struct vib_span_t vib_span_t;
+typedef struct vib_buffer_t vib_buffer_t;
+typedef struct vib_buffer_options_t vib_buffer_options_t;
+typedef struct vib_extent_t vib_extent_t;
+
+/**
+ * A contiguous run of bytes borrowed from a buffer.
+ * `length` may be shorter than requested; callers loop until satisfied.
+ * The span stays valid until the next call into the buffer.
+ */
+struct vib_span_t
+{
+    BORROWED const uint8_t * data;
+    COPIED   uint64_t        length;
+};
+
+/** The byte range [offset, offset + length). */
+struct vib_extent_t
+{
+    COPIED uint64_t offset;
+    COPIED uint64_t length;
+};
+
+typedef enum vib_buffer_kind_t
+{
+    VIB_BUFFER_MMAP = 0,    /* read-only shared mapping of a regular file */
+    VIB_BUFFER_PAGED,       /* pread() into a bounded page cache */
+    VIB_BUFFER_STREAM,      /* pipe or socket read into an append-only store */
+    VIB_BUFFER_BLOCK,       /* block device, O_DIRECT reads into a bounded page cache */
+    VIB_BUFFER_GZIP,        /* gzip file, inflated from checkpoints into a bounded page cache */
+} vib_buffer_kind_t;
+
+/** Access pattern hints, translated into madvise() by the backend. */
+typedef enum vib_access_t
+{
+    VIB_ACCESS_SCROLL = 0,  /* interactive paging around a small window */
+    VIB_ACCESS_SCAN,        /* one front-to-back pass over the whole file */
+} vib_access_t;
+
+struct vib_buffer_options_t
+{
+    COPIED uint64_t cache_budget;   /* bytes of page data for the paged backend */
+    COPIED bool     follow;         /* keep up with a regular file that grows */
+    COPIED bool     raw;            /* show compressed files as stored */
+};
+
+struct vib_buffer_t
+{
+    COPIED vib_buffer_kind_t            kind;
+    OWNED  char                       * path;
+    COPIED int                          fd;
+    COPIED uint64_t                     size;
+    COPIED bool                         size_known;         /* false while the end has not been read yet */
+    COPIED vib_access_t                 access;
+
+    /* VIB_BUFFER_MMAP */
+    OWNED  uint8_t                    * map;
+    COPIED uint64_t                     map_length;
+
+    /* VIB_BUFFER_PAGED, VIB_BUFFER_BLOCK, VIB_BUFFER_GZIP */
+    OWNED  struct vib_pcache_t        * cache;
+    COPIED uint64_t                     block_size;         /* logical block size of a block device */
+
+    /* VIB_BUFFER_STREAM */
+    OWNED  struct vib_stream_t        * stream;
+
+    /* VIB_BUFFER_GZIP */
+    OWNED  struct vib_gzip_t          * gzip;
+
+    /* Sparse regular files: holes in original offsets, sorted, NIL if none */
+    OWNED  vib_extent_t               * holes;
+    COPIED uint64_t                     hole_count;
+
+    /* Scroll prediction, NIL until the first scroll; not used for streams */
+    OWNED  struct vib_readahead_t     * readahead;
+
+    /* Follow mode */
+    COPIED int                          watch_fd;           /* inotify descriptor, -1 when not following */
+
+    /* Edits, NIL until the first one */
+    OWNED  struct vib_piece_table_t   * pieces;
+    COPIED uint64_t                     original;           /* bytes of the file the pieces refer to */
+    COPIED uint64_t                     generation;         /* bumped on every edit and whenever bytes already read may change */
+};
+
+/**
+ * Open `path` read-only, or standard input for VIB_BUFFER_STDIN. The
+ * backend follows from fstat(): regular files are mapped, block devices
+ * read directly, pipes streamed, and anything else (or anything mmap()
+ * refuses) falls back to the paged cache. `options` may be NIL for the defaults.
+ * Returns RESULT_OK(vib_buffer_t *) or RESULT_ERR(errno).
+ */
+COPIED result_t vib_buffer_open(BORROWED const char * path, BORROWED const vib_buffer_options_t * options);
+
+/** Borrow up to `length` bytes starting at `offset`. Empty past the end. */
+COPIED vib_span_t vib_buffer_span(BORROWED vib_buffer_t * buf, COPIED uint64_t offset, COPIED uint64_t length);
+
+/** Bytes known so far; grows while `size_known` is false. */
+COPIED uint64_t vib_buffer_size(BORROWED vib_buffer_t * buf);
+
+/**
+ * True if a byte exists at `offset`. For inputs whose size the kernel does
+ * not report (/proc, character devices) this reads ahead to find out.
+ */
+COPIED bool vib_buffer_reaches(BORROWED vib_buffer_t * buf, COPIED uint64_t offset);
+
+/**
+ * The hole around `offset`, in offsets of the edited file, or an empty
+ * extent if `offset` holds data. Bytes in a hole read as zeros but take no
+ * disk space; edits split holes like any other original bytes.
+ */
+COPIED vib_extent_t vib_buffer_hole(BORROWED vib_buffer_t * buf, COPIED uint64_t offset);
+
+/**
+ * Descriptor to wait on for more input, or -1 when the buffer cannot grow.
+ * When it polls readable, call vib_buffer_pump().
+ */
+COPIED int vib_buffer_poll_fd(BORROWED vib_buffer_t * buf);
+
+/**
+ * Take in whatever input arrived without blocking; returns the bytes added.
+ * A followed file may also shrink, so compare sizes rather than trusting 0.
+ */
+COPIED uint64_t vib_buffer_pump(BORROWED vib_buffer_t * buf);
+
+/**
+ * Tell the backend how the bytes around [offset, offset + length) are about
+ * to be read. Switching between scrolling and scanning changes the kernel
+ * readahead policy for the whole file. Scrolling also prefetches the window
+ * and lets a background thread read the screens the scroll is heading for.
+ */
+void vib_buffer_advise(BORROWED vib_buffer_t * buf, COPIED vib_access_t access, COPIED uint64_t offset, COPIED uint64_t length);
+
+/**
+ * Start an in-order bulk read of [offset, offset + length) of the original
+ * bytes, for passes that touch the whole input once (see vib_scan).
+ * Returns NIL for streams, which are already in memory, for gzip files,
+ * whose bytes on disk are not the ones shown, and for edited buffers,
+ * whose bytes have to be read through spans.
+ */
+OWNED struct vib_scan_t * vib_buffer_scan(BORROWED vib_buffer_t * buf, COPIED uint64_t offset, COPIED uint64_t length);
+
+/*
+ * Edits. Offsets are in the edited file. All return RESULT_OK(0), or
+ * RESULT_ERR(EINVAL) past the end and RESULT_ERR(ENOTSUP) while the size of
+ * the input is still unknown.
+ */
+COPIED result_t vib_buffer_insert(BORROWED vib_buffer_t * buf, COPIED uint64_t offset, BORROWED const uint8_t * data, COPIED uint64_t length);
+COPIED result_t vib_buffer_delete(BORROWED vib_buffer_t * buf, COPIED uint64_t offset, COPIED uint64_t length);
+COPIED result_t vib_buffer_replace(BORROWED vib_buffer_t * buf, COPIED uint64_t offset, BORROWED const uint8_t * data, COPIED uint64_t length);
+COPIED bool vib_buffer_is_modified(BORROWED vib_buffer_t * buf);
+
+/**
+ * The file at `path` was replaced (e.g. by a save): open it again, drop all
+ * edits and start over on the new contents. Regular files only; returns
+ * RESULT_OK(0), RESULT_ERR(ENOTSUP) for other inputs or RESULT_ERR(errno).
+ */
+COPIED result_t vib_buffer_reload(BORROWED vib_buffer_t * buf);
+
+COPIED void * vib_buffer_dispose(OWNED void * arg);
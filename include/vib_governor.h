@@ -0,0 +1,96 @@
+#pragma once
+
+/*
+ * vib_governor — Process-wide memory budget
+ *
+ * Each cache sizes itself on its own, so with several large files open the
+ * sum can outgrow the machine. The governor holds one budget for the whole
+ * process. The allocation layer in memory.c reports every heap block into
+ * it, so `heap` is what vib actually holds (file mappings live in the
+ * kernel page cache and are not counted).
+ *
+ * Caches that can give memory back join as consumers: a kind, a refill cost
+ * (how expensive a byte is to get again) and a shrink callback. Before a
+ * consumer grows it calls vib_governor_reserve(); if that would cross the
+ * budget, consumers are shrunk, those idle longest per unit of cost first.
+ * A page read back with pread() is cheap to lose, one that took inflating
+ * megabytes of gzip is not.
+ *
+ * Shrink callbacks run on the thread calling vib_governor_reserve(), which
+ * must be the thread that owns every consumer (the UI thread): a consumer
+ * may lose memory behind any call into any other one. Charges and the
+ * counters may be updated from any thread.
+ */
+#include "common.h"
+
+#define VIB_GOVERNOR_DEFAULT_SHARE  (4UL)   /* default budget: physical memory / share */
+
+/* Refill costs, relative to a buffered pread() */
+#define VIB_GOVERNOR_COST_READ      (1UL)
+#define VIB_GOVERNOR_COST_DIRECT    (2UL)   /* O_DIRECT: the kernel keeps no copy */
+#define VIB_GOVERNOR_COST_INFLATE   (16UL)  /* inflating from a checkpoint */
+
+typedef struct vib_consumer_t vib_consumer_t;
+typedef struct vib_governor_stats_t vib_governor_stats_t;
+
+typedef enum vib_memory_kind_t
+{
+    VIB_MEMORY_PAGES = 0,       /* page caches of buffers */
+    VIB_MEMORY_MATCHES,         /* search match lists */
+    VIB_MEMORY_ANALYSIS,        /* derived data: formatted rows, statistics */
+    VIB_MEMORY_KINDS,
+} vib_memory_kind_t;
+
+/** Give back about `bytes`; returns the bytes actually freed. */
+typedef COPIED uint64_t (vib_governor_shrink_fn) (BORROWED void * ctx, COPIED uint64_t bytes);
+
+struct vib_governor_stats_t
+{
+    COPIED uint64_t budget;                     /* 0 when unlimited */
+    COPIED uint64_t heap;                       /* live bytes allocated through memory.c */
+    COPIED uint64_t charged[VIB_MEMORY_KINDS];  /* part of `heap` held by consumers, per kind */
+    COPIED uint64_t consumers;
+    COPIED uint64_t hits;                       /* summed over consumers, including departed ones */
+    COPIED uint64_t misses;
+    COPIED uint64_t evictions;
+    COPIED uint64_t reclaims;                   /* shrink calls made to stay under budget */
+    COPIED uint64_t reclaimed;                  /* bytes they freed */
+};
+
+/** Set the budget in bytes; 0 lifts it. Takes effect at the next reserve. */
+void vib_governor_set_budget(COPIED uint64_t bytes);
+
+/** Physical memory / VIB_GOVERNOR_DEFAULT_SHARE, or 0 if unknown. */
+COPIED uint64_t vib_governor_default_budget();
+
+/** Called by memory.c for every block allocated (positive) or freed (negative). */
+void vib_governor_heap(COPIED int64_t delta);
+
+/**
+ * Register a cache. `cost` is its refill cost (VIB_GOVERNOR_COST_*); `shrink`
+ * may be NIL for consumers that only want accounting.
+ */
+OWNED vib_consumer_t * vib_governor_join(COPIED vib_memory_kind_t kind, COPIED uint64_t cost, BORROWED vib_governor_shrink_fn * shrink, BORROWED void * ctx);
+
+/** The consumer now holds `delta` more (or fewer) bytes. */
+void vib_governor_charge(BORROWED vib_consumer_t * consumer, COPIED int64_t delta);
+
+/** Counters; hits and misses also mark the consumer as recently used. */
+void vib_governor_hit(BORROWED vib_consumer_t * consumer);
+void vib_governor_miss(BORROWED vib_consumer_t * consumer);
+void vib_governor_evicted(BORROWED vib_consumer_t * consumer, COPIED uint64_t count);
+
+/**
+ * Make room for `bytes` about to be allocated, shrinking consumers as needed.
+ * Returns false if the budget cannot be met; callers that can should make do
+ * with what they hold rather than allocate anyway.
+ */
+COPIED bool vib_governor_reserve(COPIED uint64_t bytes);
+
+COPIED vib_governor_stats_t vib_governor_stats();
+
+/**
+ * Leave the governor, releasing whatever the consumer still had charged.
+ * Waits for a shrink callback another thread is running on it to return.
+ */
+COPIED void * vib_consumer_dispose(OWNED void * arg);
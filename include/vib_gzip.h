@@ -0,0 +1,54 @@
+#pragma once
+
+/*
+ * vib_gzip — Random access into gzip files
+ *
+ * Deflate streams can only be decoded from the start, so the first open
+ * decompresses the whole file once and records a checkpoint at a block
+ * boundary roughly every VIB_GZIP_SPAN bytes of output: where it is in both
+ * streams, the bits of a byte already half consumed, and the last 32 KiB of
+ * output the decoder needs as its dictionary. A read then starts at the
+ * nearest checkpoint at or before it and decompresses at most one span.
+ *
+ * The index is saved under $XDG_CACHE_HOME/vib (else ~/.cache/vib), keyed by
+ * device and inode and checked against size and mtime, so later opens of
+ * an unchanged file skip the first pass. Dictionaries are kept deflated,
+ * in memory and on disk.
+ *
+ * Reads continue from where the previous one stopped when they can, so
+ * paging forward never goes back to a checkpoint. Concatenated members
+ * (as written by pigz or `cat a.gz b.gz`) read as one stream.
+ */
+#include "common.h"
+#include "result.h"
+
+#define VIB_GZIP_SPAN           (4UL * 1024UL * 1024UL)     /* output bytes between checkpoints */
+#define VIB_GZIP_WINDOW         (32UL * 1024UL)             /* deflate dictionary */
+#define VIB_GZIP_CHUNK          (64UL * 1024UL)             /* compressed bytes read at a time */
+
+typedef struct vib_gzip_t vib_gzip_t;
+
+/** True if `fd` starts with the gzip magic. Does not move the file offset. */
+COPIED bool vib_gzip_detect(COPIED int fd);
+
+/**
+ * Index the gzip file `fd`, loading a saved index if one matches. The
+ * descriptor stays owned by the caller and must outlive the result.
+ * Returns RESULT_OK(vib_gzip_t *) or RESULT_ERR(errno); EINVAL if the data
+ * is not gzip at all. A truncated file is indexed up to where it breaks off.
+ */
+COPIED result_t vib_gzip_open(COPIED int fd);
+
+/** Decompressed size. */
+COPIED uint64_t vib_gzip_size(BORROWED vib_gzip_t * gz);
+
+/** Number of checkpoints in the index. */
+COPIED uint64_t vib_gzip_checkpoints(BORROWED vib_gzip_t * gz);
+
+/**
+ * A vib_pcache_fill_fn over the decompressed bytes; `ctx` is the vib_gzip_t.
+ * Safe to call from several threads; they take turns on one decoder.
+ */
+COPIED int64_t vib_gzip_fill(BORROWED void * ctx, BORROWED uint8_t * dst, COPIED uint64_t offset, COPIED uint64_t length);
+
+COPIED void * vib_gzip_dispose(OWNED void * arg);
@@ -0,0 +1,90 @@
+#pragma once
+
+/*
+ * vib_hex — Hex row formatting
+ *
+ * Turns bytes into the text of a hex row: the digits of `word` bytes (1, 2,
+ * 4 or 8) run together and are followed by a space, with one extra space
+ * between groups of VIB_HEX_GROUP bytes; and the ASCII gutter with '.' for
+ * anything unprintable. A frame at 4K terminal widths formats tens of
+ * thousands of bytes, so no printf() is involved:
+ *
+ *   - scalar: a 256-entry table of digit pairs, one 16-bit copy per byte;
+ *   - SSE2: nibbles of 16 bytes turned into digits with compare-and-add,
+ *     then laid out pair by pair;
+ *   - AVX2: 32 bytes per step (16 for a default row), digits from a nibble
+ *     shuffle and the `XX ` layout produced directly by byte shuffles.
+ *
+ * Full rows of 8, 16, 32 or 64 bytes go through kernels unrolled for their
+ * width and word, picked from a table; longer words copy runs of digits
+ * into place instead of laying out byte by byte.
+ *
+ * Bytes are also sorted into classes for coloring, from a 256-entry table
+ * or, 16 and 32 at a time, with vector compares.
+ *
+ * The fastest path the CPU supports is picked on first use; vib_hex_use()
+ * pins one, which the benchmark uses to compare them. All paths produce
+ * identical text and classes.
+ */
+#include "common.h"
+
+#define VIB_HEX_GROUP           (8UL)
+#define VIB_HEX_WORD_MAX        (8UL)
+#define VIB_HEX_ROW_MAX         (64UL)      /* widest row with a kernel of its own */
+
+/**
+ * Characters vib_hex_digits() produces for a row of `bytes` (> 0) bytes in
+ * words of `word`, trailing space included.
+ */
+#define VIB_HEX_WIDTH(bytes, word)  (2UL * (bytes) + (bytes) / (word) + ((bytes) - 1UL) / VIB_HEX_GROUP)
+
+/** Column of the first digit of byte `i` in such a row. */
+#define VIB_HEX_COLUMN(i, word)     (2UL * (i) + (i) / (word) + (i) / VIB_HEX_GROUP)
+
+typedef enum vib_hex_class_t
+{
+    VIB_HEX_NUL = 0,
+    VIB_HEX_PRINTABLE,      /* 0x21..0x7E */
+    VIB_HEX_WHITESPACE,     /* space, \t \n \v \f \r */
+    VIB_HEX_CONTROL,        /* the rest below 0x20, and 0x7F */
+    VIB_HEX_HIGH,           /* 0x80..0xFE */
+    VIB_HEX_FF,
+    VIB_HEX_CLASSES,
+} vib_hex_class_t;
+
+typedef enum vib_hex_path_t
+{
+    VIB_HEX_AUTO = 0,
+    VIB_HEX_SCALAR,
+    VIB_HEX_SSE2,
+    VIB_HEX_AVX2,
+} vib_hex_path_t;
+
+/**
+ * Select the formatting path. A path the CPU lacks falls back to the next
+ * best one; returns the path now in use.
+ */
+COPIED vib_hex_path_t vib_hex_use(COPIED vib_hex_path_t path);
+
+/** Human-readable name of `path`. */
+BORROWED const char * vib_hex_path_name(COPIED vib_hex_path_t path);
+
+/** `digits` upper-case hex digits of `offset`, zero padded. Returns `digits`. */
+COPIED uint64_t vib_hex_offset(BORROWED char * dst, COPIED uint64_t offset, COPIED uint64_t digits);
+
+/**
+ * Digits of `length` bytes of `src`, laid out for a row of `width` bytes in
+ * words of `word` (1, 2, 4 or 8, dividing `width`): missing bytes are blank.
+ * Writes VIB_HEX_WIDTH(width, word) characters plus one spare byte of
+ * scratch past them, and returns VIB_HEX_WIDTH(width, word).
+ */
+COPIED uint64_t vib_hex_digits(BORROWED char * dst, BORROWED const uint8_t * src, COPIED uint64_t length, COPIED uint64_t width, COPIED uint64_t word);
+
+/** ASCII gutter: printable bytes as themselves, the rest as '.'. Returns `length`. */
+COPIED uint64_t vib_hex_ascii(BORROWED char * dst, BORROWED const uint8_t * src, COPIED uint64_t length);
+
+/** Class of every byte value, VIB_HEX_* of vib_hex_class_t. */
+extern const uint8_t VIB_HEX_CLASS[256];
+
+/** vib_hex_class_t of each of `length` bytes of `src` into `dst`. Returns `length`. */
+COPIED uint64_t vib_hex_classify(BORROWED uint8_t * dst, BORROWED const uint8_t * src, COPIED uint64_t length);
@@ -0,0 +1,58 @@
+#pragma once
+
+/*
+ * vib_huge — Huge page backing for mappings and caches
+ *
+ * A full pass over a 64 GB mapping touches sixteen million 4 KiB pages and
+ * misses the TLB on most of them; with 2 MiB pages it is 32768. When the
+ * policy is on (vib --huge-pages):
+ *
+ *   - file mappings are placed at 2 MiB aligned addresses and advised with
+ *     MADV_HUGEPAGE, so the kernel can map large page cache folios with one
+ *     PMD entry where the filesystem and kernel support it;
+ *   - anonymous buffers (page caches, scan rings) come from 2 MiB aligned
+ *     regions, taken from the hugetlbfs pool (MAP_HUGETLB) when it has pages
+ *     and otherwise advised with MADV_HUGEPAGE for transparent huge pages.
+ *
+ * Everything degrades to ordinary pages when the kernel says no; the policy
+ * is a hint, never a requirement.
+ */
+#include "common.h"
+
+#define VIB_HUGE_PAGE_SIZE      (2UL * 1024UL * 1024UL)
+
+typedef struct vib_slab_t vib_slab_t;
+
+/** Process-wide policy, off by default. */
+void vib_huge_enable(COPIED bool on);
+COPIED bool vib_huge_enabled();
+
+/**
+ * Map `length` bytes of `fd` read-only and shared at a 2 MiB aligned address
+ * with MADV_HUGEPAGE. Unmap with munmap(map, length). Returns MAP_FAILED and
+ * sets errno on failure.
+ */
+OWNED void * vib_huge_map_file(COPIED int fd, COPIED uint64_t length);
+
+/**
+ * Anonymous, zeroed, 2 MiB aligned memory of `length` bytes rounded up to
+ * whole huge pages; NIL on failure. Reported to vib_governor as heap.
+ */
+OWNED void * vib_huge_alloc(COPIED uint64_t length);
+void vib_huge_free(OWNED void * ptr, COPIED uint64_t length);
+
+/**
+ * Fixed-size buffers carved out of huge page regions, for caches that come
+ * and go a buffer at a time. `size` must divide VIB_HUGE_PAGE_SIZE into at
+ * most 64 pieces. A region is returned to the kernel as soon as its last
+ * buffer is freed. Not thread safe; callers serialize.
+ */
+OWNED vib_slab_t * mk_vib_slab(COPIED uint64_t size);
+OWNED void * vib_slab_alloc(BORROWED vib_slab_t * slab);
+void vib_slab_free(BORROWED vib_slab_t * slab, OWNED void * ptr);
+
+/** Regions currently held, and how many came from the hugetlbfs pool. */
+COPIED uint64_t vib_slab_regions(BORROWED vib_slab_t * slab);
+COPIED uint64_t vib_slab_hugetlb(BORROWED vib_slab_t * slab);
+
+COPIED void * vib_slab_dispose(OWNED void * arg);
@@ -0,0 +1,16 @@
+#pragma once
+
+/*
+ * vib_paths — Files kept between runs
+ *
+ * Saved gzip indexes and probed terminal capabilities live in one per-user
+ * cache directory, $XDG_CACHE_HOME/vib or else ~/.cache/vib. Everything in
+ * it can be rebuilt, so losing it only costs the next start some work.
+ */
+#include "common.h"
+
+/**
+ * Path of `name` in the cache directory, creating the directory first if
+ * `create`. NIL when neither $XDG_CACHE_HOME nor $HOME is set.
+ */
+OWNED char * vib_paths_cache(BORROWED const char * name, COPIED bool create);
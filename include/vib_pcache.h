@@ -0,0 +1,90 @@
+#pragma once
+
+/*
+ * vib_pcache — Paged read cache
+ *
+ * Fixed-size pages filled on demand by a backend callback (pread by default)
+ * and bounded by a byte budget. Eviction is CLOCK (second chance): every hit
+ * sets the page's reference bit, the hand clears bits until it finds a page
+ * that was not touched since its last sweep.
+ *
+ * Pages are found through an open-addressing table keyed by page index, so a
+ * lookup is a multiply, a mask and usually one probe.
+ *
+ * Page buffers are aligned to VIB_PCACHE_PAGE_ALIGN and every fill asks for
+ * a whole page at a page-aligned offset, so O_DIRECT descriptors can fill
+ * them without a bounce buffer. With vib_huge enabled they are carved out of
+ * 2 MiB slabs instead of the heap, 32 pages to a TLB entry.
+ *
+ * A readahead thread may fill pages through vib_pcache_prefetch(). Those
+ * land in a small staging area and are only adopted by the owning thread
+ * when it misses on them, so spans it has borrowed are never evicted
+ * behind its back. Every other function belongs to the owning thread.
+ *
+ * Every cache is a consumer of vib_governor: it asks before growing and
+ * recycles its own pages when the answer is no, and when memory runs short
+ * elsewhere it hands back cold pages (CLOCK order, idle staging buffers
+ * first) down to VIB_PCACHE_MIN_PAGES.
+ */
+#include "common.h"
+#include "vib_buffer.h"
+#include "vib_governor.h"
+
+#define VIB_PCACHE_PAGE_SIZE        (64UL * 1024UL)
+#define VIB_PCACHE_DEFAULT_BUDGET   (64UL * 1024UL * 1024UL)
+#define VIB_PCACHE_MIN_PAGES        (4UL)
+#define VIB_PCACHE_PAGE_ALIGN       (4096UL)    /* enough for O_DIRECT on any common logical block size */
+#define VIB_PCACHE_STAGED_PAGES     (32UL)      /* pages prefetched but not yet used */
+
+/**
+ * Fill `length` bytes at `offset` into `dst`.
+ * Returns the number of bytes produced (short at end of input) or -1.
+ */
+typedef COPIED int64_t (vib_pcache_fill_fn) (BORROWED void * ctx, BORROWED uint8_t * dst, COPIED uint64_t offset, COPIED uint64_t length);
+
+typedef struct vib_pcache_t vib_pcache_t;
+typedef struct vib_pcache_stats_t vib_pcache_stats_t;
+
+struct vib_pcache_stats_t
+{
+    COPIED uint64_t hits;
+    COPIED uint64_t misses;
+    COPIED uint64_t evictions;
+    COPIED uint64_t prefetched;     /* misses served from the staging area */
+    COPIED uint64_t resident;       /* pages currently holding data */
+    COPIED uint64_t capacity;       /* pages the budget allows */
+};
+
+/**
+ * Create a cache of at most `budget` bytes of page data.
+ * The budget is rounded down to whole pages, but never below VIB_PCACHE_MIN_PAGES.
+ * `cost` tells the governor how dear a page is to fill again (VIB_GOVERNOR_COST_*).
+ */
+OWNED vib_pcache_t * mk_vib_pcache(COPIED uint64_t budget, COPIED uint64_t cost, BORROWED vib_pcache_fill_fn * fill, BORROWED void * ctx);
+
+/**
+ * Borrow up to `length` bytes at `offset`, never crossing a page boundary.
+ * The span stays valid until the next call into the cache.
+ * An empty span means end of input or a failed fill.
+ */
+COPIED vib_span_t vib_pcache_span(BORROWED vib_pcache_t * cache, COPIED uint64_t offset, COPIED uint64_t length);
+
+/**
+ * Read the pages covering [offset, offset + length) into the staging area,
+ * skipping pages already cached or staged. Blocks on I/O; meant to be called
+ * from a readahead thread. Stops early once the staging area is busy.
+ */
+void vib_pcache_prefetch(BORROWED vib_pcache_t * cache, COPIED uint64_t offset, COPIED uint64_t length);
+
+/** Drop every page at or after the one holding `offset`; the input changed there. */
+void vib_pcache_invalidate(BORROWED vib_pcache_t * cache, COPIED uint64_t offset);
+
+/** Offset at which a fill came back short, or UINT64_MAX if not seen yet. */
+COPIED uint64_t vib_pcache_eof(BORROWED vib_pcache_t * cache);
+
+COPIED vib_pcache_stats_t vib_pcache_stats(BORROWED vib_pcache_t * cache);
+
+/** pread() based fill; `ctx` is the file descriptor cast through intptr_t. */
+COPIED int64_t vib_pcache_fill_pread(BORROWED void * ctx, BORROWED uint8_t * dst, COPIED uint64_t offset, COPIED uint64_t length);
+
+COPIED void * vib_pcache_dispose(OWNED void * arg);
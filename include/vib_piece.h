@@ -0,0 +1,55 @@
+#pragma once
+
+/*
+ * vib_piece — Piece table
+ *
+ * Describes an edited file as a sequence of pieces, each a slice of either
+ * the untouched original or an append-only add buffer holding every byte
+ * ever typed. The original is never copied, so patching one byte of a 20 GB
+ * image costs one new piece and one byte of add buffer.
+ *
+ * Pieces live in a treap ordered by position, each node caching the byte
+ * length of its subtree. Locating an offset, inserting and deleting are all
+ * expected O(log pieces).
+ */
+#include "common.h"
+
+typedef struct vib_piece_table_t vib_piece_table_t;
+typedef struct vib_piece_loc_t vib_piece_loc_t;
+
+typedef enum vib_piece_source_t
+{
+    VIB_PIECE_ORIGINAL = 0,
+    VIB_PIECE_ADD,
+} vib_piece_source_t;
+
+/** Where the byte at some logical offset lives. */
+struct vib_piece_loc_t
+{
+    COPIED vib_piece_source_t source;
+    COPIED uint64_t           start;    /* offset inside `source` */
+    COPIED uint64_t           length;   /* bytes left in this piece from `start`, 0 past the end */
+    COPIED uint64_t           into;     /* bytes of this piece before `start` */
+};
+
+/** A table whose only piece is the whole original of `original_length` bytes. */
+OWNED vib_piece_table_t * mk_vib_piece_table(COPIED uint64_t original_length);
+
+COPIED vib_piece_loc_t vib_piece_locate(BORROWED vib_piece_table_t * pt, COPIED uint64_t offset);
+
+/** Insert `length` bytes before `offset`; `offset` may equal the total length. */
+void vib_piece_insert(BORROWED vib_piece_table_t * pt, COPIED uint64_t offset, BORROWED const uint8_t * data, COPIED uint64_t length);
+
+/** Remove `length` bytes starting at `offset`, clamped to the end. */
+void vib_piece_delete(BORROWED vib_piece_table_t * pt, COPIED uint64_t offset, COPIED uint64_t length);
+
+/** Append original bytes [start, start + length) after the last piece; the file grew. */
+void vib_piece_append_original(BORROWED vib_piece_table_t * pt, COPIED uint64_t start, COPIED uint64_t length);
+
+/** Bytes of the add buffer starting at `start`; valid until the next insert. */
+BORROWED const uint8_t * vib_piece_add_data(BORROWED vib_piece_table_t * pt, COPIED uint64_t start);
+
+COPIED uint64_t vib_piece_length(BORROWED vib_piece_table_t * pt);
+COPIED uint64_t vib_piece_count(BORROWED vib_piece_table_t * pt);
+
+COPIED void * vib_piece_table_dispose(OWNED void * arg);
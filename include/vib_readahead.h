@@ -0,0 +1,40 @@
+#pragma once
+
+/*
+ * vib_readahead — Direction-predicting prefetch worker
+ *
+ * Watches where the view scrolls and how fast, and keeps a background thread
+ * reading the screens the user is about to reach. The render thread only
+ * drops the prediction into a one-slot mailbox and never waits; a newer
+ * prediction replaces one the worker has not picked up yet, and the worker
+ * abandons a stale range between chunks.
+ *
+ * What reading means is up to the owner's callback: hinting the kernel for
+ * mapped files, filling the page cache's staging area for everything else.
+ */
+#include "common.h"
+
+#define VIB_READAHEAD_MIN_BYTES     (256UL * 1024UL)
+#define VIB_READAHEAD_MAX_BYTES     (32UL * 1024UL * 1024UL)
+#define VIB_READAHEAD_MIN_SCREENS   (4UL)
+#define VIB_READAHEAD_HORIZON_MS    (500UL)     /* read what the current speed reaches in this long */
+#define VIB_READAHEAD_JUMP_SCREENS  (64UL)      /* a longer move is a seek, not scrolling */
+#define VIB_READAHEAD_CHUNK         (1UL * 1024UL * 1024UL)
+
+/** Read [offset, offset + length) ahead of use. Runs on the worker thread. */
+typedef void (vib_readahead_fn) (BORROWED void * ctx, COPIED uint64_t offset, COPIED uint64_t length);
+
+typedef struct vib_readahead_t vib_readahead_t;
+
+/** Starts the worker thread; `fn` must be safe to call from it. */
+OWNED vib_readahead_t * mk_vib_readahead(BORROWED vib_readahead_fn * fn, BORROWED void * ctx);
+
+/**
+ * The view now shows [offset, offset + length) of an input `end` bytes long.
+ * Updates the direction and speed estimate and, if the predicted range is
+ * not covered by what was already requested, hands it to the worker.
+ */
+void vib_readahead_observe(BORROWED vib_readahead_t * ra, COPIED uint64_t offset, COPIED uint64_t length, COPIED uint64_t end);
+
+/** Stops and joins the worker; a range being read is finished first. */
+COPIED void * vib_readahead_dispose(OWNED void * arg);
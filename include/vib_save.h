@@ -0,0 +1,65 @@
+#pragma once
+
+/*
+ * vib_save — Writing an edited buffer back to its file
+ *
+ * The new contents are assembled in a temporary file next to the original
+ * and renamed over it, so a crash leaves either the old or the new file,
+ * never a mix. The piece table already says which ranges are untouched:
+ * those are reflinked with FICLONERANGE where the filesystem can share
+ * extents, and otherwise moved with copy_file_range(), which stays in the
+ * kernel. Holes of a sparse file are skipped and stay holes. Only bytes
+ * from the add buffer are written by vib, so on a reflink filesystem saving
+ * costs as much as the edit, not the file.
+ *
+ * When every edit is a same-length patch, the file can instead be patched
+ * in place: only the dirty ranges are written, with no copy and no second
+ * file's worth of disk. Their old contents go to an undo journal,
+ * `<file>.vib-journal`, which is fsynced before the first patch and removed
+ * after the last one. vib_save_recover() puts the old bytes back when a
+ * crash left the journal behind.
+ */
+#include "common.h"
+#include "result.h"
+#include "vib_buffer.h"
+
+#define VIB_SAVE_JOURNAL_SUFFIX ".vib-journal"
+
+typedef struct vib_save_stats_t vib_save_stats_t;
+
+typedef enum vib_save_mode_t
+{
+    VIB_SAVE_AUTO = 0,      /* in place when the edits allow it, else rewrite */
+    VIB_SAVE_REWRITE,       /* always a new file renamed over the old one */
+    VIB_SAVE_IN_PLACE,      /* patch the file itself; EINVAL if lengths changed */
+} vib_save_mode_t;
+
+struct vib_save_stats_t
+{
+    COPIED uint64_t written;        /* edited bytes written from memory */
+    COPIED uint64_t cloned;         /* original bytes shared by reflink */
+    COPIED uint64_t moved;          /* original bytes copied (in kernel, or read back as a last resort) */
+    COPIED bool     in_place;       /* patched in place; `written` bytes were dirty */
+};
+
+/**
+ * Write the edited contents of `buf` back to its file and reload `buf` from
+ * the result. A rewrite atomically replaces the file and fsyncs it and its
+ * directory; an in-place save journals, patches and fsyncs. A buffer
+ * without edits is left alone. `stats` may be NIL.
+ * Returns RESULT_OK(0), RESULT_ERR(ENOTSUP) for inputs that are not regular
+ * files, or RESULT_ERR(errno). A failed rewrite leaves the original
+ * untouched; a failed in-place save is rolled back from its journal.
+ */
+COPIED result_t vib_save(BORROWED vib_buffer_t * buf, COPIED vib_save_mode_t mode, BORROWED vib_save_stats_t * stats);
+
+/**
+ * Roll back an in-place save of `path` that did not finish, if its journal
+ * is complete, and remove the journal either way. A torn journal means the
+ * crash came before the first patch, so the file is already intact; one
+ * recorded for another inode or size is about a file replaced since, which
+ * is left alone.
+ * Returns RESULT_OK(true) if bytes were restored, RESULT_OK(false) if there
+ * was nothing to do, or RESULT_ERR(errno) with the journal kept.
+ */
+COPIED result_t vib_save_recover(BORROWED const char * path);
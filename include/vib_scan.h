@@ -0,0 +1,59 @@
+#pragma once
+
+/*
+ * vib_scan — In-order bulk reader for full-file passes
+ *
+ * Search, hashing and entropy passes want every block of the input once,
+ * front to back. Instead of one blocking pread() per block, a scan keeps
+ * VIB_SCAN_DEPTH block reads in flight and hands completed blocks to the
+ * consumer strictly in file order.
+ *
+ * Two backends:
+ *   - io_uring, driven through the raw syscalls, reading into registered
+ *     (fixed) buffers and submitting in batches;
+ *   - a small pool of pread() threads, used where io_uring is unavailable
+ *     (old kernels, seccomp, io_uring_disabled).
+ *
+ * Buffers are aligned to VIB_SCAN_ALIGN and blocks sit at multiples of the
+ * block size, so O_DIRECT descriptors work with either backend. With vib_huge
+ * enabled the whole ring is one huge page backed region.
+ */
+#include "common.h"
+#include "vib_buffer.h"
+
+#define VIB_SCAN_BLOCK_SIZE     (256UL * 1024UL)
+#define VIB_SCAN_DEPTH          (32UL)      /* blocks in flight */
+#define VIB_SCAN_BATCH          (8UL)       /* io_uring: submit once this many reads are queued */
+#define VIB_SCAN_THREADS        (4UL)       /* pread pool size */
+#define VIB_SCAN_ALIGN          (4096UL)
+
+typedef struct vib_scan_t vib_scan_t;
+
+typedef enum vib_scan_backend_t
+{
+    VIB_SCAN_AUTO = 0,      /* io_uring if the kernel allows it, else the pool */
+    VIB_SCAN_URING,
+    VIB_SCAN_PREAD,
+} vib_scan_backend_t;
+
+/**
+ * Start reading [offset, offset + length) of `fd`; the scan does not own it.
+ * `length` may be UINT64_MAX to read until end of input. Asking for
+ * VIB_SCAN_URING where it is unavailable also falls back to the pool.
+ */
+OWNED vib_scan_t * mk_vib_scan(COPIED int fd, COPIED uint64_t offset, COPIED uint64_t length, COPIED vib_scan_backend_t backend);
+
+/**
+ * The next block, in order. The span stays valid until the next call.
+ * An empty span means the end of the range, or a failure (see vib_scan_error()).
+ */
+COPIED vib_span_t vib_scan_next(BORROWED vib_scan_t * scan);
+
+/** The backend actually in use. */
+COPIED vib_scan_backend_t vib_scan_backend(BORROWED vib_scan_t * scan);
+
+/** errno of the read that stopped the scan, 0 if none did. */
+COPIED int vib_scan_error(BORROWED vib_scan_t * scan);
+
+/** Waits for reads still in flight, then releases everything. */
+COPIED void * vib_scan_dispose(OWNED void * arg);
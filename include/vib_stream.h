@@ -0,0 +1,37 @@
+#pragma once
+
+/*
+ * vib_stream — Append-only segmented store for unseekable input
+ *
+ * Bytes read from a pipe or socket land in fixed-size segments that are
+ * never moved or resized, so a span handed to the renderer stays valid
+ * while more data keeps arriving. Only the small table of segment pointers
+ * ever grows.
+ */
+#include "common.h"
+#include "vib_buffer.h"
+
+#define VIB_STREAM_SEGMENT_SIZE     (1UL * 1024UL * 1024UL)
+#define VIB_STREAM_PUMP_BUDGET      (8UL * 1024UL * 1024UL)
+
+typedef struct vib_stream_t vib_stream_t;
+
+/** Switches `fd` to non-blocking mode; the stream does not own it. */
+OWNED vib_stream_t * mk_vib_stream(COPIED int fd);
+
+/**
+ * Read whatever is available without blocking, at most
+ * VIB_STREAM_PUMP_BUDGET bytes so the UI gets a turn in between.
+ * Returns the number of bytes appended.
+ */
+COPIED uint64_t vib_stream_pump(BORROWED vib_stream_t * stream);
+
+/** Borrow up to `length` bytes at `offset`, never crossing a segment. */
+COPIED vib_span_t vib_stream_span(BORROWED vib_stream_t * stream, COPIED uint64_t offset, COPIED uint64_t length);
+
+COPIED uint64_t vib_stream_length(BORROWED vib_stream_t * stream);
+
+/** True once the writer closed its end or a read failed. */
+COPIED bool vib_stream_eof(BORROWED vib_stream_t * stream);
+
+COPIED void * vib_stream_dispose(OWNED void * arg);
@@ -5,19 +5,29 @@
  *
  * Handles raw mode, screen operations, terminal size,
  * and ensures clean restoration on exit.
+ *
+ * Frames are composed in a screen model: a back grid of cells (glyph plus
+ * attributes) that callers draw into, and a front grid holding what the
+ * terminal currently shows. vib_screen_present() compares the two and emits
+ * only the runs of cells that changed, as a single frame.
  */
 #include <unistd.h>
 #include <stdarg.h>
 
 #include "common.h"
+#include "crayon.h"
 #include "result.h"
 
 /**
  * Initialize terminal for TUI operation.
+ * - Reads keys from /dev/tty when stdin is not a terminal (e.g. `cmd | vib -`)
  * - Enters raw mode (no echo, no canonical, no signals)
  * - Registers atexit and signal handlers
  * - Queries initial terminal size
- *
+ * - Probes the terminal for synchronized output (DECRQM mode 2026, then DA1
+ *   under a short timeout); the answer is cached per $TERM under
+ *   $XDG_CACHE_HOME/vib (else ~/.cache/vib), so later starts skip the round
+ *   trip. Delete the `term-*` file there to probe again.
  */
 COPIED result_t vib_terminal_init();
 
@@ -31,25 +41,79 @@ void vib_terminal_quit();
  * Terminal Info
  * ───────────────────────────────────────────────────────────────────────────── */
 
+/** Descriptor keys are read from; poll it for input. */
+COPIED int vib_terminal_input_fd();
+
 COPIED uint64_t vib_terminal_get_rows();
 COPIED uint64_t vib_terminal_get_columns();
+
+/*
+ * SIGWINCH only writes a byte to a pipe, so a loop waiting in poll() on
+ * vib_terminal_resize_fd() wakes for a resize as it does for a key.
+ * Resizes are coalesced: at most one per frame interval is reported, with
+ * the size current at that moment.
+ */
+
+/** Readable when the window may have changed size; drained by vib_terminal_was_resized(). */
+COPIED int vib_terminal_resize_fd();
+
+/** True once per coalesced resize, after re-reading the terminal size. */
 COPIED bool vib_terminal_was_resized(void);
+
+/** poll() timeout until a held-back resize is due, or -1 when none is pending. */
+COPIED int vib_terminal_resize_timeout();
+
+/*
+ * Frames are paced: a loop with changes to show presents them only once
+ * vib_terminal_frame_timeout() reaches 0, taking in more input meanwhile,
+ * so a burst of keys costs one frame per interval instead of one each.
+ */
+
+#define VIB_TERMINAL_DEFAULT_FPS    (60UL)
+
+/** Present at most `fps` frames a second; 0 lifts the limit. */
+void vib_terminal_set_fps(COPIED uint64_t fps);
+
+/** poll() timeout until the next frame may be presented, 0 if now. */
+COPIED int vib_terminal_frame_timeout();
+
 void vib_terminal_size_update();
 
+/** True when frames are wrapped in synchronized output, so the terminal paints each one whole. */
+COPIED bool vib_terminal_synchronized();
+
+/** Keys typed during the probe are still waiting; poll() on the input will not report them. */
+COPIED bool vib_terminal_input_pending();
+
 
 /* ─────────────────────────────────────────────────────────────────────────────
  * Terminal Screen (TUI) Operations
  * ───────────────────────────────────────────────────────────────────────────── */
 
-#define vib_terminal_write(sequence, len)       \
-        write(STDOUT_FILENO, sequence, len)
+/*
+ * Output is appended to a buffer of fixed-size chunks, which never move once
+ * written, and leaves in one writev() at the end of the outermost frame.
+ * Outside a frame every call is flushed on its own. On terminals with
+ * synchronized output the outermost frame is sent between mode 2026 begin
+ * and end, so it is never seen half drawn.
+ */
+
+/** Open a frame; frames nest and only the outermost one flushes. */
+void vib_terminal_begin_frame();
+
+/** Close a frame; the outermost close sends everything appended, retrying partial writes. */
+void vib_terminal_end_frame();
 
+void vib_terminal_write(BORROWED const char * sequence, COPIED uint64_t len);
 void vib_terminal_writef(BORROWED const char * fmt, ...);
 void vib_terminal_writef_owned(OWNED char * fmt, ...);
 
 /** Clear entire screen. */
 void vib_terminal_clear();
 
+/** Clear from the cursor to the end of the line. */
+void vib_terminal_erase_line();
+
 /** Move cursor to top-left (1,1). */
 void vib_terminal_cursor_home();
 
@@ -65,6 +129,67 @@ void vib_terminal_cursor_show();
 void vib_tui_use_normal_buffer();
 void vib_tui_use_alternate_buffer();
 void vib_tui_toggle_buffer();
+
+/** Send whatever is buffered now, even inside a frame. */
 void vib_terminal_flush();
 
 COPIED int32_t vib_terminal_read_raw_byte();
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Screen Model
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+#define VIB_ATTR_BOLD           CRAYON_ATTR_BOLD
+#define VIB_ATTR_DIM            CRAYON_ATTR_DIM
+#define VIB_ATTR_ITALIC         CRAYON_ATTR_ITALIC
+#define VIB_ATTR_UNDERLINE      CRAYON_ATTR_UNDERLINE
+#define VIB_ATTR_BLINK          CRAYON_ATTR_BLINK
+#define VIB_ATTR_REVERSED       CRAYON_ATTR_REVERSED
+#define VIB_ATTR_STRIKETHRU     CRAYON_ATTR_STRIKETHRU
+
+/* Cell colors: the terminal default, an entry of the 256-color palette, or 24-bit RGB */
+#define VIB_COLOR_DEFAULT       CRAYON_COLOR_DEFAULT
+#define VIB_COLOR_INDEX(n)      CRAYON_COLOR_INDEX(n)
+#define VIB_COLOR_RGB(r, g, b)  CRAYON_COLOR_RGB(r, g, b)
+
+typedef struct vib_cell_t vib_cell_t;
+
+/* No padding, so grids compare with memcmp(). */
+struct vib_cell_t
+{
+    COPIED uint32_t glyph;      /* Unicode code point, one column wide */
+    COPIED uint32_t fg;         /* VIB_COLOR_* */
+    COPIED uint32_t bg;
+    COPIED uint32_t attrs;      /* VIB_ATTR_* */
+};
+
+/*
+ * Rows and columns count from 0. Drawing outside the grid is clipped. The
+ * grid follows the terminal size; a resize blanks it and forces the next
+ * frame to repaint everything.
+ */
+
+/** Blank the whole back grid. */
+void vib_screen_clear();
+
+/**
+ * Write UTF-8 `text` from (row, column) with `attrs` and default colors.
+ * Returns the column after the last cell written.
+ */
+COPIED uint64_t vib_screen_put(COPIED uint64_t row, COPIED uint64_t column, COPIED uint32_t attrs, BORROWED const char * text);
+COPIED uint64_t vib_screen_printf(COPIED uint64_t row, COPIED uint64_t column, COPIED uint32_t attrs, BORROWED const char * fmt, ...);
+
+/** Blank from (row, column) to the end of the row. */
+void vib_screen_erase(COPIED uint64_t row, COPIED uint64_t column);
+
+/** Replace the attributes of `length` cells from (row, column). */
+void vib_screen_paint(COPIED uint64_t row, COPIED uint64_t column, COPIED uint64_t length, COPIED uint32_t attrs);
+
+/** Cells of back grid row `row`, vib_terminal_get_columns() of them; NIL outside the grid. */
+BORROWED vib_cell_t * vib_screen_row(COPIED uint64_t row);
+
+/** The terminal was written to behind the screen's back: repaint everything next frame. */
+void vib_screen_invalidate();
+
+/** Bring the terminal up to date with the back grid. */
+void vib_screen_present();
@@ -0,0 +1,83 @@
+#pragma once
+
+/*
+ * vib_view — Hex view module
+ *
+ * Owns the scroll position and cursor over a buffer, translates keys into
+ * motions and byte edits, and renders the visible window as hex + ASCII rows,
+ * each byte colored by its vib_hex class.
+ */
+#include "common.h"
+#include "vib_buffer.h"
+#include "vib_keys.h"
+
+#define VIB_VIEW_BYTES_PER_ROW  (16UL)
+#define VIB_VIEW_MESSAGE_SIZE   (128UL)
+
+typedef struct vib_view_t vib_view_t;
+typedef struct vib_view_line_t vib_view_line_t;
+typedef struct vib_view_drawn_t vib_view_drawn_t;
+
+struct vib_view_t
+{
+    BORROWED vib_buffer_t * buffer;
+    COPIED   uint64_t       top;            /* offset of the first visible row */
+    COPIED   uint64_t       cursor;         /* offset of the byte under the cursor */
+    COPIED   uint64_t       bytes_per_row;  /* 8, 16, 32 or 64, fitted to the width */
+    COPIED   uint64_t       word;           /* bytes whose digits run together: 1, 2, 4 or 8 */
+    COPIED   uint64_t       rows;           /* screen rows for data, status line excluded */
+    COPIED   uint64_t       columns;
+
+    /* `r` waits for two hex digits before replacing the byte under the cursor */
+    COPIED   vib_key_t      pending;
+    COPIED   uint8_t        digits;
+    COPIED   uint8_t        value;
+
+    /* one-shot note on the status line, cleared by the next key */
+    COPIED   char           message[VIB_VIEW_MESSAGE_SIZE];
+
+    /* formatted rows by offset, valid for one layout and buffer generation */
+    OWNED    vib_view_line_t  * lines;
+    OWNED    char             * line_text;
+    OWNED    uint8_t          * line_classes;   /* bytes_per_row vib_hex classes per slot */
+    COPIED   uint64_t           line_slots;     /* power of two */
+    COPIED   uint64_t           line_stride;
+    COPIED   uint64_t           layout;
+    COPIED   uint64_t           generation;
+
+    /* per screen row, what the screen's back grid holds */
+    OWNED    vib_view_drawn_t * drawn;
+    COPIED   uint64_t           drawn_rows;
+};
+
+/** Color bytes by class (the default); off draws every row in the default colors. */
+void vib_view_colors_enable(COPIED bool enabled);
+COPIED bool vib_view_colors_enabled();
+
+OWNED vib_view_t * vib_view_init(OWNED vib_view_t * view, BORROWED vib_buffer_t * buffer);
+
+/**
+ * Adopt a new terminal size: fit bytes per row and word size to the width,
+ * and keep the cursor on screen.
+ */
+void vib_view_resize(BORROWED vib_view_t * view, COPIED uint64_t rows, COPIED uint64_t columns);
+
+/**
+ * Apply a motion or edit key.
+ * Returns true if the key was consumed and the view needs a redraw.
+ */
+COPIED bool vib_view_handle_key(BORROWED vib_view_t * view, COPIED vib_key_t key);
+
+/**
+ * Compose the data rows and the status line into the screen model and
+ * present it; only cells that differ from the last frame reach the terminal.
+ * Rows are formatted once per layout and edit and kept by offset, and rows
+ * the screen already holds are not composed again, so moving the cursor
+ * touches only the rows it leaves and enters.
+ */
+void vib_view_draw(BORROWED vib_view_t * view);
+
+/** The buffer changed size from `old_size`: follow a cursor parked on the end. The caller redraws. */
+void vib_view_grown(BORROWED vib_view_t * view, COPIED uint64_t old_size);
+
+COPIED void * vib_view_dispose(OWNED void * arg);
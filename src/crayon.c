@@ -1,5 +1,7 @@
 #include "crayon.h"
 
+#include <string.h>
+
 void crayon_bold(borrowed FILE * stream) {
     if (!stream) {
         return;
@@ -182,4 +184,105 @@ void crayon_end(borrowed FILE * stream) {
     fputs(ENDCRAYON, stream);
 }
 
+/* SGR code of each CRAYON_ATTR_* bit, and the code switching it off again. */
+static const uint32_t CRAYON_ATTR_ON[]  = { 1, 2, 3, 4, 5, 7, 9 };
+static const uint32_t CRAYON_ATTR_OFF[] = { 22, 22, 23, 24, 25, 27, 29 };
+
+#define CRAYON_ATTRS    (sizeof(CRAYON_ATTR_ON) / sizeof(CRAYON_ATTR_ON[0]))
+
+/* Append `value` as the next parameter; the first one follows the CSI directly. */
+static void crayon_param_(borrowed char * dst, borrowed uint64_t * n, copied uint32_t value) {
+    char digits[10];
+    int  count = 0;
+
+    if (*n > 2) {
+        dst[(*n)++] = ';';
+    }
+    do {
+        digits[count++] = (char) ('0' + value % 10);
+        value /= 10;
+    } while (value);
+    while (count) {
+        dst[(*n)++] = digits[--count];
+    }
+}
+
+/* `base` 30 selects the foreground, 40 the background. */
+static void crayon_color_(borrowed char * dst, borrowed uint64_t * n, copied uint32_t color, copied uint32_t base) {
+    copied uint32_t kind  = color >> 24;
+    copied uint32_t value = color & 0xFFFFFFU;
+
+    if (kind == 0) {
+        crayon_param_(dst, n, base + 9);
+    } else if (kind == 1 && value < 8) {
+        crayon_param_(dst, n, base + value);
+    } else if (kind == 1 && value < 16) {
+        crayon_param_(dst, n, base + 60 + value - 8);
+    } else if (kind == 1) {
+        crayon_param_(dst, n, base + 8);
+        crayon_param_(dst, n, 5);
+        crayon_param_(dst, n, value);
+    } else {
+        crayon_param_(dst, n, base + 8);
+        crayon_param_(dst, n, 2);
+        crayon_param_(dst, n, value >> 16);
+        crayon_param_(dst, n, (value >> 8) & 0xFFU);
+        crayon_param_(dst, n, value & 0xFFU);
+    }
+}
+
+copied uint64_t crayon_sgr(borrowed char * dst, borrowed const crayon_pen_t * from, borrowed const crayon_pen_t * to) {
+    if (from->attrs == to->attrs && from->fg == to->fg && from->bg == to->bg) {
+        return 0;
+    }
+
+    /* delta: switch off what goes away, then switch on what is new */
+    char            delta[CRAYON_SGR_MAX] = "\033[";
+    copied uint64_t d   = 2;
+    copied uint32_t off = from->attrs & ~to->attrs;
+    copied uint32_t on  = to->attrs & ~from->attrs;
+
+    /* 22 ends bold and dim together, so one that stays must be set again */
+    if (off & (CRAYON_ATTR_BOLD | CRAYON_ATTR_DIM)) {
+        crayon_param_(delta, &d, 22);
+        on |= to->attrs & (CRAYON_ATTR_BOLD | CRAYON_ATTR_DIM);
+    }
+    for (uint64_t i = 2; i < CRAYON_ATTRS; i++) {
+        if (off & (1U << i)) {
+            crayon_param_(delta, &d, CRAYON_ATTR_OFF[i]);
+        }
+    }
+    for (uint64_t i = 0; i < CRAYON_ATTRS; i++) {
+        if (on & (1U << i)) {
+            crayon_param_(delta, &d, CRAYON_ATTR_ON[i]);
+        }
+    }
+    if (from->fg != to->fg) {
+        crayon_color_(delta, &d, to->fg, 30);
+    }
+    if (from->bg != to->bg) {
+        crayon_color_(delta, &d, to->bg, 40);
+    }
 
+    /* reset: start over from the default pen and state only what `to` has */
+    copied uint64_t r = 3;
+    memcpy(dst, "\033[0", 3);
+    for (uint64_t i = 0; i < CRAYON_ATTRS; i++) {
+        if (to->attrs & (1U << i)) {
+            crayon_param_(dst, &r, CRAYON_ATTR_ON[i]);
+        }
+    }
+    if (to->fg != CRAYON_COLOR_DEFAULT) {
+        crayon_color_(dst, &r, to->fg, 30);
+    }
+    if (to->bg != CRAYON_COLOR_DEFAULT) {
+        crayon_color_(dst, &r, to->bg, 40);
+    }
+
+    if (d < r) {
+        memcpy(dst, delta, d);
+        r = d;
+    }
+    dst[r++] = 'm';
+    return r;
+}
@@ -104,11 +104,10 @@ OWNED char * strdup_smart(BORROWED const char * s)
     {
         s = "";
     }
-    OWNED char * theString = strdup(s);
-    if (!theString)
-    {
-        PANIC("@%s(): failed to duplicate string \"%s\"", __func__, s);
-    }
+    /* through new() so the copy is accounted like every other block */
+    COPIED uint64_t length    = strlen(s) + 1;
+    OWNED  char   * theString = new(length);
+    memcpy(theString, s, length);
     return theString;
 }
 
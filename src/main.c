@@ -1,9 +1,19 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
 
 #include "vib.h"
 #include "vib_term.h"
 #include "vib_keys.h"
+#include "vib_buffer.h"
+#include "vib_governor.h"
+#include "vib_huge.h"
+#include "vib_pcache.h"
+#include "vib_view.h"
+#include "vib_save.h"
 #include "common.h"
 #include "cstr.h"
 
@@ -18,11 +28,51 @@ static void vib_print_version()
 
 static void vib_print_usage(BORROWED const char * prog)
 {
-    printf("Usage: %s [OPTIONS] [FILE]\n", prog);
+    printf("Usage: %s [OPTIONS] [FILE | -]\n", prog);
     printf("\n");
     printf("Options:\n");
-    printf("  --version    Show version and exit\n");
-    printf("  --help       Show this help and exit\n");
+    printf("  --version          Show version and exit\n");
+    printf("  --help             Show this help and exit\n");
+    printf("  -f, --follow       Keep reading as FILE grows, like tail -f\n");
+    printf("  --raw              Show gzip files compressed, as stored\n");
+    printf("  --huge-pages       Back the file mapping and caches with 2 MiB pages\n");
+    printf("  --fps=N            Redraw at most N times a second (default %lu, 0 = no limit)\n",
+           VIB_TERMINAL_DEFAULT_FPS);
+    printf("  --no-color         Do not color bytes by class (also when NO_COLOR is set)\n");
+    printf("  --cache-size=MIB   Memory budget for inputs that cannot be mapped (default %lu)\n",
+           VIB_PCACHE_DEFAULT_BUDGET >> 20);
+    printf("  --memory=MIB       Memory budget shared by all caches (default 1/%lu of RAM, 0 = none)\n",
+           VIB_GOVERNOR_DEFAULT_SHARE);
+    printf("\n");
+    printf("With -, vib reads standard input and shows it while it arrives.\n");
+    printf("Without FILE, vib starts in key test mode.\n");
+}
+
+static int vib_print_bad_option(BORROWED const char * prog, BORROWED const char * arg)
+{
+    fprintf(stderr, "error: invalid option '%s'\n", arg);
+    fprintf(stderr, "Try '%s --help' for more information.\n", prog);
+    return 1;
+}
+
+/* All of `text` as a decimal number, times 2^shift; false if it is not one or does not fit. */
+static bool parse_number(BORROWED const char * text, COPIED uint32_t shift, BORROWED uint64_t * value)
+{
+    /* strtoull() would also take blanks, a sign, or nothing at all */
+    if (!('0' <= text[0] && text[0] <= '9'))
+    {
+        return false;
+    }
+
+    char * end = NIL;
+    errno = 0;
+    COPIED uint64_t n = strtoull(text, &end, 10);
+    if (errno || *end || n > (UINT64_MAX >> shift))
+    {
+        return false;
+    }
+    *value = n << shift;
+    return true;
 }
 
 
@@ -32,24 +82,25 @@ static void vib_print_usage(BORROWED const char * prog)
 
 static void draw_tui()
 {
-    vib_terminal_clear();
-    vib_terminal_cursor_home();
-    vib_terminal_writef("vib %s | %lux%lu | Key Test Mode\r\n",
-                        VIB_VERSION_STRING,
-                        vib_terminal_get_columns(),
-                        vib_terminal_get_rows());
-    vib_terminal_writef("Press keys to see their codes. Press Ctrl+Q to quit.\r\n");
-    vib_terminal_writef("─────────────────────────────────────────────────────\r\n");
-
+    vib_screen_clear();
+    vib_screen_printf(0, 0, 0, "vib %s | %lux%lu | Key Test Mode",
+                      VIB_VERSION_STRING,
+                      vib_terminal_get_columns(),
+                      vib_terminal_get_rows());
+    vib_screen_printf(1, 0, 0, "Press keys to see their codes. Press Ctrl+Q to quit.");
+    vib_screen_printf(2, 0, 0, "─────────────────────────────────────────────────────");
 }
 
-static void loop()
+static void keytest_loop()
 {
+    vib_terminal_begin_frame();
     vib_terminal_cursor_hide();
     draw_tui();
+    vib_screen_present();
+    vib_terminal_end_frame();
 
-    uint64_t line = 4;
-    uint64_t max_lines = vib_terminal_get_rows() - 2;
+    uint64_t line = 3;
+    uint64_t max_lines = vib_terminal_get_rows() - 3;
 
     for (;;)
     {
@@ -57,8 +108,25 @@ static void loop()
         if (vib_terminal_was_resized())
         {
             draw_tui();
-            line = 4;
-            max_lines = vib_terminal_get_rows() - 2;
+            vib_screen_present();
+            line = 3;
+            max_lines = vib_terminal_get_rows() - 3;
+        }
+
+        struct pollfd fds[2] = {
+            { .fd = vib_terminal_input_fd(),  .events = POLLIN },
+            { .fd = vib_terminal_resize_fd(), .events = POLLIN },
+        };
+        if (!vib_terminal_input_pending())
+        {
+            if (-1 == poll(fds, 2, vib_terminal_resize_timeout()) && NEQ(errno, EINTR))
+            {
+                break;
+            }
+            if (!(fds[0].revents & POLLIN))
+            {
+                continue;
+            }
         }
 
         vib_key_t key = vib_keys_read();
@@ -75,24 +143,122 @@ static void loop()
         {
             /* Clear screen if full */
             draw_tui();
-            line = 4;
+            line = 3;
         }
 
         /* Display key info */
-        vib_terminal_cursor_move(line++, 1);
-
         vib_key_t base = vib_key_base(key);
         const char * name = vib_key_name_get(key);
 
         if (base >= 0 && base < 256)
         {
-            vib_terminal_writef("Key: %-15s | base: %3d (0x%02X) | raw: 0x%04X\r\n",
-                                name, base, base, key);
+            vib_screen_printf(line++, 0, 0, "Key: %-15s | base: %3d (0x%02X) | raw: 0x%04X",
+                              name, base, base, key);
         }
         else
         {
-            vib_terminal_writef("Key: %-15s | base: %3d        | raw: 0x%04X\r\n",
-                                name, base, key);
+            vib_screen_printf(line++, 0, 0, "Key: %-15s | base: %3d        | raw: 0x%04X",
+                              name, base, key);
+        }
+        vib_screen_present();
+    }
+}
+
+/* True when a key is waiting, without blocking. */
+static bool input_waiting()
+{
+    struct pollfd fd = { .fd = vib_terminal_input_fd(), .events = POLLIN };
+    return vib_terminal_input_pending() || (1 == poll(&fd, 1, 0) && (fd.revents & POLLIN));
+}
+
+/**
+ * Wait on the keyboard, on resizes and, while the buffer can still grow, on
+ * its input (a pipe, or inotify for a followed file).
+ * Every key already typed is applied before anything is drawn, and changes
+ * are drawn at most once per frame interval: right away when the last frame
+ * is old enough, otherwise when poll() times out at the next one. Key
+ * repeat or a slow link then costs one frame per interval, not one per key.
+ * New data is taken in as soon as it lands so the scroll limit follows the
+ * writer.
+ */
+static void view_loop(BORROWED vib_view_t * view)
+{
+    BORROWED vib_buffer_t * buffer = view->buffer;
+    COPIED   bool           dirty  = false;
+
+    vib_terminal_begin_frame();
+    vib_terminal_cursor_hide();
+    vib_view_resize(view, vib_terminal_get_rows(), vib_terminal_get_columns());
+    vib_view_draw(view);
+    vib_terminal_end_frame();
+
+    for (;;)
+    {
+        /* Handle resize */
+        if (vib_terminal_was_resized())
+        {
+            vib_view_resize(view, vib_terminal_get_rows(), vib_terminal_get_columns());
+            dirty = true;
+        }
+
+        if (dirty && EQ(vib_terminal_frame_timeout(), 0))
+        {
+            vib_view_draw(view);
+            dirty = false;
+        }
+
+        struct pollfd fds[3] = {
+            { .fd = vib_terminal_input_fd(),    .events = POLLIN },
+            { .fd = vib_terminal_resize_fd(),   .events = POLLIN },
+            { .fd = vib_buffer_poll_fd(buffer), .events = POLLIN },
+        };
+        nfds_t nfds = (fds[2].fd >= 0) ? 3 : 2;
+
+        /* a resize wakes poll() through its pipe and is handled at the top of the loop */
+        COPIED int timeout = vib_terminal_resize_timeout();
+        if (dirty && (timeout < 0 || vib_terminal_frame_timeout() < timeout))
+        {
+            timeout = vib_terminal_frame_timeout();
+        }
+        if (-1 == poll(fds, nfds, vib_terminal_input_pending() ? 0 : timeout))
+        {
+            if (EQ(errno, EINTR))
+            {
+                continue;
+            }
+            break;
+        }
+
+        if (EQ(nfds, 3) && fds[2].revents)
+        {
+            COPIED uint64_t before = vib_buffer_size(buffer);
+            COPIED bool     known  = buffer->size_known;
+            vib_buffer_pump(buffer);
+            if (NEQ(vib_buffer_size(buffer), before) || NEQ(buffer->size_known, known))
+            {
+                vib_view_grown(view, before);
+                dirty = true;
+            }
+        }
+
+        /* drain: every key typed so far, then one frame for all of them */
+        COPIED bool quit = false;
+        while (!quit && ((fds[0].revents & POLLIN) || vib_terminal_input_pending()))
+        {
+            vib_key_t key = vib_keys_read();
+            if (key == (VIB_CTRL | 'q') || (key == 'q' && EQ(view->pending, VIB_KEY_NONE)))
+            {
+                quit = true;
+            }
+            else if (key != VIB_KEY_NONE && vib_view_handle_key(view, key))
+            {
+                dirty = true;
+            }
+            fds[0].revents = input_waiting() ? POLLIN : 0;
+        }
+        if (quit)
+        {
+            break;
         }
     }
 }
@@ -104,6 +270,11 @@ static void loop()
 int main(int argc, const char * const argv[])
 {
     BORROWED const char * progname = argv[0];
+    BORROWED const char * filename = NIL;
+    COPIED vib_buffer_options_t options = { .cache_budget = VIB_PCACHE_DEFAULT_BUDGET };
+
+    vib_governor_set_budget(vib_governor_default_budget());
+    vib_view_colors_enable(!getenv("NO_COLOR") || EQ(getenv("NO_COLOR")[0], '\0'));
 
     for (int i = 1; i < argc; i++)
     {
@@ -118,6 +289,92 @@ int main(int argc, const char * const argv[])
             vib_print_usage(progname);
             return 0;
         }
+        if (strcmp_smart(arg, "-f") || strcmp_smart(arg, "--follow"))
+        {
+            options.follow = true;
+            continue;
+        }
+        if (strcmp_smart(arg, "--raw"))
+        {
+            options.raw = true;
+            continue;
+        }
+        if (strcmp_smart(arg, "--huge-pages"))
+        {
+            vib_huge_enable(true);
+            continue;
+        }
+        if (strcmp_smart(arg, "--no-color"))
+        {
+            vib_view_colors_enable(false);
+            continue;
+        }
+
+        COPIED uint64_t number = 0;
+        if (cstr_starts_with(arg, "--memory="))
+        {
+            if (!parse_number(arg + strlen("--memory="), 20, &number))
+            {
+                return vib_print_bad_option(progname, arg);
+            }
+            vib_governor_set_budget(number);
+            continue;
+        }
+        if (cstr_starts_with(arg, "--fps="))
+        {
+            if (!parse_number(arg + strlen("--fps="), 0, &number))
+            {
+                return vib_print_bad_option(progname, arg);
+            }
+            vib_terminal_set_fps(number);
+            continue;
+        }
+        if (cstr_starts_with(arg, "--cache-size="))
+        {
+            if (!parse_number(arg + strlen("--cache-size="), 20, &number))
+            {
+                return vib_print_bad_option(progname, arg);
+            }
+            options.cache_budget = number;
+            continue;
+        }
+
+        /* a typo of an option must not be opened as a file; `./-name` still can be */
+        if (EQ(arg[0], '-') && !strcmp_smart(arg, VIB_BUFFER_STDIN))
+        {
+            return vib_print_bad_option(progname, arg);
+        }
+        filename = arg;
+    }
+
+    if (strcmp_smart(filename, VIB_BUFFER_STDIN) && isatty(STDIN_FILENO))
+    {
+        fprintf(stderr, "error: '-' reads data from standard input, but it is a terminal\n");
+        return 1;
+    }
+
+    OWNED vib_buffer_t * buffer = NIL;
+    if (filename)
+    {
+        /* an in-place save that was cut short is undone before anyone reads the file */
+        COPIED result_t recovered = strcmp_smart(filename, VIB_BUFFER_STDIN) ? RESULT_OK(false) : vib_save_recover(filename);
+        if (RESULT_IS_ERR(recovered))
+        {
+            fprintf(stderr, "error: cannot roll back the interrupted save of '%s': %s\n", filename, strerror((int) recovered.err));
+            return 1;
+        }
+        if (RESULT_UNWRAP(recovered))
+        {
+            fprintf(stderr, "vib: rolled back an interrupted save of '%s'\n", filename);
+        }
+
+        COPIED result_t opened = vib_buffer_open(filename, &options);
+        if (RESULT_IS_ERR(opened))
+        {
+            fprintf(stderr, "error: cannot open '%s': %s\n", filename, strerror((int) opened.err));
+            return 1;
+        }
+        buffer = CAST(RESULT_UNWRAP(opened), vib_buffer_t *);
     }
 
     COPIED result_t init = vib_terminal_init();
@@ -127,7 +384,18 @@ int main(int argc, const char * const argv[])
         return 1;
     }
 
-    loop();
+    if (buffer)
+    {
+        OWNED vib_view_t * view = vib_view_init(NIL, buffer);
+        view_loop(view);
+        vib_terminal_quit();
+        vib_view_dispose(view);
+        vib_buffer_dispose(buffer);
+    }
+    else
+    {
+        keytest_loop();
+    }
 
     return 0;
 }
@@ -1,9 +1,20 @@
 #include "memory.h"
 
+#include <malloc.h>
+
+#include "vib_governor.h"
+
+/* Usable size rather than the request: it is what free() gives back. */
+static void memory_report_(BORROWED void * ptr, COPIED int64_t sign)
+{
+    vib_governor_heap(sign * (int64_t) malloc_usable_size(ptr));
+}
+
 OWNED void * new_(COPIED uint64_t bytes)
 {
     OWNED void * ptr = malloc( bytes );
     SCP(ptr);
+    memory_report_(ptr, 1);
     return ptr;
 }
 
@@ -11,16 +22,37 @@ OWNED void * zeros_(COPIED uint64_t bytes)
 {
     OWNED void * ptr = calloc(bytes, sizeof(char));
     SCP(ptr);
+    memory_report_(ptr, 1);
+    return ptr;
+}
+
+OWNED void * new_aligned_(COPIED uint64_t alignment, COPIED uint64_t bytes)
+{
+    OWNED void * ptr = NIL;
+    if (posix_memalign(&ptr, alignment, bytes))
+    {
+        ptr = NIL;
+    }
+    SCP(ptr);
+    memory_report_(ptr, 1);
     return ptr;
 }
 
 OWNED void * realloc_smart(OWNED void * arg, COPIED uint64_t new_bytes)
 {
-    OWNED void * ptr = realloc(arg, new_bytes);
+    COPIED int64_t old = arg ? (int64_t) malloc_usable_size(arg) : 0;
+    OWNED  void  * ptr = realloc(arg, new_bytes);
     SCP(ptr);
+    vib_governor_heap((int64_t) malloc_usable_size(ptr) - old);
     return ptr;
 }
 
+void free_(OWNED void * ptr)
+{
+    memory_report_(ptr, -1);
+    free(ptr);
+}
+
 COPIED void * dispose(OWNED void * arg)
 {
     free_smart(arg);
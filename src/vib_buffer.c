@@ -0,0 +1,976 @@
+#define _GNU_SOURCE
+
+#include "vib_buffer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+
+#include "memory.h"
+#include "cstr.h"
+#include "vib_governor.h"
+#include "vib_gzip.h"
+#include "vib_huge.h"
+#include "vib_pcache.h"
+#include "vib_piece.h"
+#include "vib_readahead.h"
+#include "vib_scan.h"
+#include "vib_stream.h"
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Forward Declarations
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+static COPIED int buffer_map_(BORROWED vib_buffer_t * buf);
+static COPIED int buffer_page_(BORROWED vib_buffer_t * buf, COPIED uint64_t budget);
+static COPIED int buffer_block_(BORROWED vib_buffer_t * buf, COPIED uint64_t budget);
+static COPIED int buffer_gzip_(BORROWED vib_buffer_t * buf, COPIED uint64_t budget);
+static COPIED int64_t buffer_fill_direct_(BORROWED void * ctx, BORROWED uint8_t * dst, COPIED uint64_t offset, COPIED uint64_t length);
+static void buffer_learn_size_(BORROWED vib_buffer_t * buf, COPIED uint64_t end);
+static void buffer_map_holes_(BORROWED vib_buffer_t * buf);
+static void buffer_madvise_(BORROWED vib_buffer_t * buf, COPIED uint64_t offset, COPIED uint64_t length, COPIED int advice);
+static COPIED vib_span_t buffer_backend_span_(BORROWED vib_buffer_t * buf, COPIED uint64_t offset, COPIED uint64_t length);
+static void buffer_prefetch_(BORROWED void * ctx, COPIED uint64_t offset, COPIED uint64_t length);
+static void buffer_watch_(BORROWED vib_buffer_t * buf);
+static COPIED uint64_t buffer_follow_(BORROWED vib_buffer_t * buf);
+static COPIED uint64_t buffer_follow_map_(BORROWED vib_buffer_t * buf, COPIED uint64_t after);
+static COPIED result_t buffer_begin_edit_(BORROWED vib_buffer_t * buf, COPIED uint64_t offset);
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Lifecycle
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+COPIED result_t vib_buffer_open(BORROWED const char * path, BORROWED const vib_buffer_options_t * options)
+{
+    if (!path)
+    {
+        return RESULT_ERR(EINVAL);
+    }
+
+    /* "-" is standard input; dup() it so dispose can close our copy */
+    int fd = strcmp_smart(path, VIB_BUFFER_STDIN)
+           ? fcntl(STDIN_FILENO, F_DUPFD_CLOEXEC, 0)
+           : open(path, O_RDONLY | O_CLOEXEC);
+    if (-1 == fd)
+    {
+        return RESULT_ERR(errno);
+    }
+
+    struct stat st;
+    if (-1 == fstat(fd, &st))
+    {
+        int err = errno;
+        close(fd);
+        return RESULT_ERR(err);
+    }
+
+    if (S_ISDIR(st.st_mode))
+    {
+        close(fd);
+        return RESULT_ERR(EISDIR);
+    }
+
+    COPIED uint64_t budget = (options && options->cache_budget) ? options->cache_budget : VIB_PCACHE_DEFAULT_BUDGET;
+
+    OWNED vib_buffer_t * buf = zeros(sizeof(vib_buffer_t));
+    buf->kind       = VIB_BUFFER_MMAP;
+    buf->path       = strdup_smart(path);
+    buf->fd         = fd;
+    buf->size       = (uint64_t) st.st_size;
+    buf->size_known = true;
+    buf->access     = VIB_ACCESS_SCROLL;
+    buf->watch_fd   = -1;
+
+    /* pipes and sockets cannot be read twice: keep everything they send */
+    if (S_ISFIFO(st.st_mode) || S_ISSOCK(st.st_mode))
+    {
+        buf->kind       = VIB_BUFFER_STREAM;
+        buf->size       = 0;
+        buf->size_known = false;
+        buf->stream     = mk_vib_stream(fd);
+        return RESULT_OK(buf);
+    }
+
+    if (S_ISBLK(st.st_mode))
+    {
+        int err = buffer_block_(buf, budget);
+        if (err)
+        {
+            vib_buffer_dispose(buf);
+            return RESULT_ERR(err);
+        }
+        return RESULT_OK(buf);
+    }
+
+    /*
+     * Only regular files with a size are worth mapping. /proc files claim
+     * st_size == 0 but have content, and character devices have no size at
+     * all, so both are paged with the size discovered while reading.
+     */
+    int err = ENODEV;
+    if (S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+        /* compressed files are shown inflated; if that fails, as stored */
+        if (!(options && options->raw) && vib_gzip_detect(fd))
+        {
+            err = buffer_gzip_(buf, budget);
+        }
+        if (err)
+        {
+            err = buffer_map_(buf);
+        }
+    }
+    else
+    {
+        buf->size       = 0;
+        buf->size_known = false;
+    }
+
+    if (err)
+    {
+        err = buffer_page_(buf, budget);
+    }
+    if (err)
+    {
+        vib_buffer_dispose(buf);
+        return RESULT_ERR(err);
+    }
+
+    /* holes and growth are in compressed offsets: neither means anything inflated */
+    if (S_ISREG(st.st_mode) && buf->size_known && NEQ(buf->kind, VIB_BUFFER_GZIP))
+    {
+        buffer_map_holes_(buf);
+    }
+
+    if (options && options->follow && S_ISREG(st.st_mode) && NEQ(buf->kind, VIB_BUFFER_GZIP))
+    {
+        buffer_watch_(buf);
+    }
+
+    return RESULT_OK(buf);
+}
+
+COPIED void * vib_buffer_dispose(OWNED void * arg)
+{
+    if (!arg)
+    {
+        return NIL;
+    }
+
+    OWNED vib_buffer_t * buf = CAST(arg, vib_buffer_t *);
+
+    /* the worker reads through `fd` and `cache`: stop it before they go */
+    vib_readahead_dispose(buf->readahead);
+    if (buf->map)
+    {
+        munmap(buf->map, buf->map_length);
+    }
+    vib_pcache_dispose(buf->cache);
+    vib_gzip_dispose(buf->gzip);
+    vib_piece_table_dispose(buf->pieces);
+    vib_stream_dispose(buf->stream);
+    free_smart(buf->holes);
+    if (buf->watch_fd >= 0)
+    {
+        close(buf->watch_fd);
+    }
+    if (buf->fd >= 0)
+    {
+        close(buf->fd);
+    }
+    free_smart(buf->path);
+    return dispose(buf);
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Memory Mapping
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+static COPIED int buffer_map_(BORROWED vib_buffer_t * buf)
+{
+    /* mmap() rejects zero-length mappings; an empty file simply has no bytes */
+    if (EQ(buf->size, 0))
+    {
+        return 0;
+    }
+
+    void * map = vib_huge_enabled()
+        ? vib_huge_map_file(buf->fd, buf->size)
+        : mmap(NIL, buf->size, PROT_READ, MAP_SHARED, buf->fd, 0);
+    if (MAP_FAILED == map)
+    {
+        return errno;
+    }
+
+    buf->map        = map;
+    buf->map_length = buf->size;
+    return 0;
+}
+
+static void buffer_madvise_(BORROWED vib_buffer_t * buf, COPIED uint64_t offset, COPIED uint64_t length, COPIED int advice)
+{
+    if (!buf->map || offset >= buf->map_length)
+    {
+        return;
+    }
+
+    /* madvise() wants a page aligned start address */
+    COPIED uint64_t page  = (uint64_t) sysconf(_SC_PAGESIZE);
+    COPIED uint64_t start = FLOOR_DIV(offset, page);
+    COPIED uint64_t end   = offset + length;
+    if (end > buf->map_length || end < offset)
+    {
+        end = buf->map_length;
+    }
+
+    madvise(buf->map + start, end - start, advice);
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Sparse Files
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+/*
+ * Walk the data/hole boundaries of the whole file once; it costs one pair of
+ * lseek() calls per data extent and reads nothing. Filesystems without hole
+ * support report the file as one data extent, which leaves `holes` empty.
+ */
+static void buffer_map_holes_(BORROWED vib_buffer_t * buf)
+{
+    COPIED uint64_t capacity = 0;
+    COPIED uint64_t offset   = 0;
+
+    free_smart(buf->holes);
+    buf->hole_count = 0;
+
+    while (offset < buf->size)
+    {
+        COPIED uint64_t data = buf->size;
+        off_t found = lseek(buf->fd, (off_t) offset, SEEK_DATA);
+        if (found >= 0)
+        {
+            data = (uint64_t) found;
+        }
+        else if (NEQ(errno, ENXIO))
+        {
+            break;
+        }
+
+        if (data > offset)
+        {
+            if (EQ(buf->hole_count, capacity))
+            {
+                capacity   = capacity ? capacity * 2 : 16;
+                buf->holes = realloc_smart(buf->holes, capacity * sizeof(vib_extent_t));
+            }
+            buf->holes[buf->hole_count++] = (vib_extent_t) { .offset = offset, .length = data - offset };
+        }
+        if (data >= buf->size)
+        {
+            break;
+        }
+
+        found = lseek(buf->fd, (off_t) data, SEEK_HOLE);
+        if (found < 0)
+        {
+            break;
+        }
+        offset = (uint64_t) found;
+    }
+}
+
+COPIED vib_extent_t vib_buffer_hole(BORROWED vib_buffer_t * buf, COPIED uint64_t offset)
+{
+    COPIED vib_extent_t none = { .offset = offset, .length = 0 };
+    if (!buf || EQ(buf->hole_count, 0))
+    {
+        return none;
+    }
+
+    /* in an edited file only original pieces can hold holes, clipped to the piece */
+    COPIED uint64_t original = offset;
+    COPIED uint64_t before   = UINT64_MAX;
+    COPIED uint64_t after    = UINT64_MAX;
+    if (buf->pieces)
+    {
+        COPIED vib_piece_loc_t loc = vib_piece_locate(buf->pieces, offset);
+        if (EQ(loc.length, 0) || EQ(loc.source, VIB_PIECE_ADD))
+        {
+            return none;
+        }
+        original = loc.start;
+        before   = loc.into;
+        after    = loc.length;
+    }
+    if (original >= buf->size)
+    {
+        return none;
+    }
+
+    /* the last hole starting at or before `original` */
+    COPIED uint64_t lo = 0;
+    COPIED uint64_t hi = buf->hole_count;
+    while (lo < hi)
+    {
+        COPIED uint64_t mid = lo + (hi - lo) / 2;
+        if (buf->holes[mid].offset <= original)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    if (EQ(lo, 0))
+    {
+        return none;
+    }
+
+    BORROWED vib_extent_t * hole = &buf->holes[lo - 1];
+    COPIED   uint64_t       end  = hole->offset + hole->length;
+    if (original >= end)
+    {
+        return none;
+    }
+
+    /* a followed file may have shrunk since the holes were mapped */
+    if (end > buf->size)
+    {
+        end = buf->size;
+    }
+
+    COPIED uint64_t head = original - hole->offset;
+    COPIED uint64_t tail = end - original;
+    head = (head < before) ? head : before;
+    tail = (tail < after)  ? tail : after;
+
+    return (vib_extent_t) { .offset = offset - head, .length = head + tail };
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Paged Fallback
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+static COPIED int buffer_page_(BORROWED vib_buffer_t * buf, COPIED uint64_t budget)
+{
+    buf->kind  = VIB_BUFFER_PAGED;
+    buf->cache = mk_vib_pcache(budget, VIB_GOVERNOR_COST_READ, vib_pcache_fill_pread, CAST((intptr_t) buf->fd, void *));
+
+    if (buf->size_known)
+    {
+        return 0;
+    }
+
+    /* read the first page now, both to learn something about the size and
+     * to reject inputs pread() cannot serve at all, e.g. pipes (ESPIPE) */
+    errno = 0;
+    COPIED vib_span_t first = vib_pcache_span(buf->cache, 0, 1);
+    if (EQ(first.length, 0) && EQ(vib_pcache_eof(buf->cache), UINT64_MAX))
+    {
+        return errno ? errno : EIO;
+    }
+    buffer_learn_size_(buf, first.length);
+    return 0;
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Block Devices
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+/*
+ * st_size is 0 for block devices; the kernel reports the real size and the
+ * logical block size through ioctls. Pages are 64 KiB at 64 KiB offsets, so
+ * every read is block aligned as long as a page holds whole blocks.
+ */
+static COPIED int buffer_block_(BORROWED vib_buffer_t * buf, COPIED uint64_t budget)
+{
+    uint64_t bytes = 0;
+    if (-1 == ioctl(buf->fd, BLKGETSIZE64, &bytes))
+    {
+        return errno;
+    }
+
+    int logical = 0;
+    if (-1 == ioctl(buf->fd, BLKSSZGET, &logical) || logical <= 0)
+    {
+        logical = 512;
+    }
+
+    buf->kind       = VIB_BUFFER_BLOCK;
+    buf->size       = bytes;
+    buf->size_known = true;
+    buf->block_size = (uint64_t) logical;
+    buf->cache      = mk_vib_pcache(budget, VIB_GOVERNOR_COST_DIRECT, buffer_fill_direct_, CAST((intptr_t) buf->fd, void *));
+
+    /* without O_DIRECT we still work, through the kernel page cache */
+    COPIED bool aligned = buf->block_size <= VIB_PCACHE_PAGE_ALIGN
+                       && EQ(VIB_PCACHE_PAGE_SIZE % buf->block_size, 0);
+    COPIED int  flags   = fcntl(buf->fd, F_GETFL);
+    if (aligned && flags >= 0)
+    {
+        fcntl(buf->fd, F_SETFL, flags | O_DIRECT);
+    }
+    return 0;
+}
+
+/* pread() fill that drops O_DIRECT for good if the device turns it down. */
+static COPIED int64_t buffer_fill_direct_(BORROWED void * ctx, BORROWED uint8_t * dst, COPIED uint64_t offset, COPIED uint64_t length)
+{
+    COPIED int64_t n = vib_pcache_fill_pread(ctx, dst, offset, length);
+    if (n >= 0 || NEQ(errno, EINVAL))
+    {
+        return n;
+    }
+
+    COPIED int fd    = (int) (intptr_t) ctx;
+    COPIED int flags = fcntl(fd, F_GETFL);
+    if (flags < 0 || !(flags & O_DIRECT) || -1 == fcntl(fd, F_SETFL, flags & ~O_DIRECT))
+    {
+        return n;
+    }
+    return vib_pcache_fill_pread(ctx, dst, offset, length);
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Compressed Files
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+/* The first open of a large file inflates all of it once to build the index. */
+static COPIED int buffer_gzip_(BORROWED vib_buffer_t * buf, COPIED uint64_t budget)
+{
+    COPIED result_t opened = vib_gzip_open(buf->fd);
+    if (RESULT_IS_ERR(opened))
+    {
+        return (int) opened.err;
+    }
+
+    buf->kind       = VIB_BUFFER_GZIP;
+    buf->gzip       = CAST(RESULT_UNWRAP(opened), struct vib_gzip_t *);
+    buf->size       = vib_gzip_size(buf->gzip);
+    buf->size_known = true;
+    buf->cache      = mk_vib_pcache(budget, VIB_GOVERNOR_COST_INFLATE, vib_gzip_fill, buf->gzip);
+    return 0;
+}
+
+/* Grow the known size after a read reached `end`; settle it once EOF is seen. */
+static void buffer_learn_size_(BORROWED vib_buffer_t * buf, COPIED uint64_t end)
+{
+    if (buf->size_known)
+    {
+        return;
+    }
+
+    if (end > buf->size)
+    {
+        buf->size = end;
+    }
+
+    COPIED uint64_t eof = vib_pcache_eof(buf->cache);
+    if (NEQ(eof, UINT64_MAX))
+    {
+        buf->size       = eof;
+        buf->size_known = true;
+    }
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Access
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+/* Bytes of the file as it is on disk, ignoring edits. */
+static COPIED vib_span_t buffer_backend_span_(BORROWED vib_buffer_t * buf, COPIED uint64_t offset, COPIED uint64_t length)
+{
+    COPIED vib_span_t span = { .data = NIL, .length = 0 };
+    if (buf->size_known && offset >= buf->size)
+    {
+        return span;
+    }
+
+    switch (buf->kind)
+    {
+        case VIB_BUFFER_MMAP:
+        {
+            COPIED uint64_t avail = buf->size - offset;
+            span.data   = buf->map + offset;
+            span.length = (length < avail) ? length : avail;
+        } break;
+
+        case VIB_BUFFER_PAGED:
+        case VIB_BUFFER_BLOCK:
+        case VIB_BUFFER_GZIP:
+        {
+            if (buf->size_known && length > buf->size - offset)
+            {
+                length = buf->size - offset;
+            }
+            /* ask for the rest of the page so a fill teaches us its full length */
+            span = vib_pcache_span(buf->cache, offset, UINT64_MAX);
+            buffer_learn_size_(buf, offset + span.length);
+            span.length = (length < span.length) ? length : span.length;
+        } break;
+
+        case VIB_BUFFER_STREAM:
+        {
+            span = vib_stream_span(buf->stream, offset, length);
+        } break;
+
+        default:
+        {
+            PANIC("%s(): unknown buffer kind %d", __func__, buf->kind);
+        } break;
+    }
+
+    return span;
+}
+
+COPIED vib_span_t vib_buffer_span(BORROWED vib_buffer_t * buf, COPIED uint64_t offset, COPIED uint64_t length)
+{
+    COPIED vib_span_t span = { .data = NIL, .length = 0 };
+    if (!buf)
+    {
+        return span;
+    }
+    if (!buf->pieces)
+    {
+        return buffer_backend_span_(buf, offset, length);
+    }
+
+    /* edited: resolve the piece, then read from the original or the add buffer */
+    COPIED vib_piece_loc_t loc = vib_piece_locate(buf->pieces, offset);
+    if (EQ(loc.length, 0))
+    {
+        return span;
+    }
+    if (length > loc.length)
+    {
+        length = loc.length;
+    }
+
+    if (EQ(loc.source, VIB_PIECE_ADD))
+    {
+        span.data   = vib_piece_add_data(buf->pieces, loc.start);
+        span.length = length;
+        return span;
+    }
+    return buffer_backend_span_(buf, loc.start, length);
+}
+
+COPIED uint64_t vib_buffer_size(BORROWED vib_buffer_t * buf)
+{
+    if (!buf)
+    {
+        return 0;
+    }
+    return buf->pieces ? vib_piece_length(buf->pieces) : buf->size;
+}
+
+COPIED bool vib_buffer_reaches(BORROWED vib_buffer_t * buf, COPIED uint64_t offset)
+{
+    if (!buf)
+    {
+        return false;
+    }
+    if (offset < vib_buffer_size(buf))
+    {
+        return true;
+    }
+    if (buf->size_known || buf->pieces || EQ(buf->kind, VIB_BUFFER_STREAM))
+    {
+        return false;
+    }
+    return vib_buffer_span(buf, offset, 1).length > 0;
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Growth
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+COPIED int vib_buffer_poll_fd(BORROWED vib_buffer_t * buf)
+{
+    if (!buf)
+    {
+        return -1;
+    }
+    if (EQ(buf->kind, VIB_BUFFER_STREAM) && !vib_stream_eof(buf->stream))
+    {
+        return buf->fd;
+    }
+    return buf->watch_fd;
+}
+
+COPIED uint64_t vib_buffer_pump(BORROWED vib_buffer_t * buf)
+{
+    if (!buf)
+    {
+        return 0;
+    }
+
+    if (buf->watch_fd >= 0)
+    {
+        return buffer_follow_(buf);
+    }
+
+    if (NEQ(buf->kind, VIB_BUFFER_STREAM))
+    {
+        return 0;
+    }
+
+    COPIED uint64_t appended = vib_stream_pump(buf->stream);
+    buf->size       = vib_stream_length(buf->stream);
+    buf->size_known = vib_stream_eof(buf->stream);
+    return appended;
+}
+
+/*
+ * Follow mode: inotify wakes us on every write, so nothing runs while the
+ * file is idle. A burst of writes is drained in one read() and answered with
+ * a single fstat(); only the size is looked at.
+ */
+static void buffer_watch_(BORROWED vib_buffer_t * buf)
+{
+    buf->watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (buf->watch_fd < 0)
+    {
+        return;
+    }
+
+    if (-1 == inotify_add_watch(buf->watch_fd, buf->path, IN_MODIFY))
+    {
+        close(buf->watch_fd);
+        buf->watch_fd = -1;
+    }
+}
+
+static COPIED uint64_t buffer_follow_(BORROWED vib_buffer_t * buf)
+{
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    while (read(buf->watch_fd, events, sizeof(events)) > 0)
+    {
+        /* drain */
+    }
+
+    struct stat st;
+    if (-1 == fstat(buf->fd, &st))
+    {
+        return 0;
+    }
+
+    COPIED uint64_t before = buf->size;
+    COPIED uint64_t after  = (uint64_t) st.st_size;
+    if (EQ(after, before))
+    {
+        return 0;
+    }
+
+    switch (buf->kind)
+    {
+        case VIB_BUFFER_MMAP:
+        {
+            /* shrink too: touching pages past the new EOF would raise SIGBUS */
+            after = buffer_follow_map_(buf, after);
+        } break;
+
+        case VIB_BUFFER_PAGED:
+        {
+            /* the page that held the old EOF is short; read it again */
+            vib_pcache_invalidate(buf->cache, (after < before) ? after : before);
+        } break;
+
+        default:
+        {
+        } break;
+    }
+
+    /* rows formatted from the old tail (or the page that held it) are stale */
+    if (after < before || EQ(buf->kind, VIB_BUFFER_PAGED))
+    {
+        buf->generation++;
+    }
+    buf->size = after;
+    buffer_map_holes_(buf);
+
+    /*
+     * Once edited, the original piece has a fixed length: growth past it is
+     * appended, while original bytes past a shrunk end read as nothing.
+     */
+    if (buf->pieces)
+    {
+        if (after <= buf->original)
+        {
+            return 0;
+        }
+        before = buf->original;
+        vib_piece_append_original(buf->pieces, before, after - before);
+        buf->original = after;
+    }
+    return (after > before) ? after - before : 0;
+}
+
+/*
+ * Resize the mapping to `after` bytes and return the bytes it now covers.
+ * A failed shrink drops the mapping rather than keep pages past EOF; a
+ * failed growth keeps the old one and tries again on the next write.
+ */
+static COPIED uint64_t buffer_follow_map_(BORROWED vib_buffer_t * buf, COPIED uint64_t after)
+{
+    if (buf->map && (EQ(after, 0) || after < buf->map_length))
+    {
+        void * map = EQ(after, 0) ? MAP_FAILED : mremap(buf->map, buf->map_length, after, 0);
+        if (MAP_FAILED == map)
+        {
+            munmap(buf->map, buf->map_length);
+            buf->map        = NIL;
+            buf->map_length = 0;
+            return 0;
+        }
+        buf->map_length = after;
+        return after;
+    }
+
+    void * map = buf->map
+               ? mremap(buf->map, buf->map_length, after, MREMAP_MAYMOVE)
+               : mmap(NIL, after, PROT_READ, MAP_SHARED, buf->fd, 0);
+    if (MAP_FAILED == map)
+    {
+        return buf->map_length;
+    }
+    buf->map        = map;
+    buf->map_length = after;
+    return after;
+}
+
+/*
+ * Runs on the readahead thread, so it only touches what never changes after
+ * open: the kind, the descriptor and the cache (whose prefetch is thread
+ * safe). Offsets are the edited file's, close enough to the original's for
+ * a hint.
+ */
+static void buffer_prefetch_(BORROWED void * ctx, COPIED uint64_t offset, COPIED uint64_t length)
+{
+    BORROWED vib_buffer_t * buf = CAST(ctx, vib_buffer_t *);
+
+    switch (buf->kind)
+    {
+        case VIB_BUFFER_MMAP:
+        {
+            /* page cache only: faults on the mapping then find the pages resident */
+            posix_fadvise(buf->fd, (off_t) offset, (off_t) length, POSIX_FADV_WILLNEED);
+        } break;
+
+        case VIB_BUFFER_PAGED:
+        case VIB_BUFFER_BLOCK:
+        case VIB_BUFFER_GZIP:
+        {
+            /* block devices stay O_DIRECT: fill our own cache, not the kernel's;
+             * for gzip the worker inflates ahead, taking turns with the viewer */
+            vib_pcache_prefetch(buf->cache, offset, length);
+        } break;
+
+        default:
+        {
+        } break;
+    }
+}
+
+void vib_buffer_advise(BORROWED vib_buffer_t * buf, COPIED vib_access_t access, COPIED uint64_t offset, COPIED uint64_t length)
+{
+    if (!buf)
+    {
+        return;
+    }
+
+    switch (access)
+    {
+        case VIB_ACCESS_SCROLL:
+        {
+            /* back to the default readaround, then pull in the window itself */
+            if (NEQ(buf->access, VIB_ACCESS_SCROLL))
+            {
+                buffer_madvise_(buf, 0, buf->map_length, MADV_NORMAL);
+                posix_fadvise(buf->fd, 0, 0, POSIX_FADV_NORMAL);
+            }
+            buffer_madvise_(buf, offset, length, MADV_WILLNEED);
+
+            if (!buf->readahead && NEQ(buf->kind, VIB_BUFFER_STREAM))
+            {
+                buf->readahead = mk_vib_readahead(buffer_prefetch_, buf);
+            }
+            vib_readahead_observe(buf->readahead, offset, length, buf->size_known ? buf->size : UINT64_MAX);
+        } break;
+
+        case VIB_ACCESS_SCAN:
+        {
+            /* aggressive readahead, and pages may be dropped right after use */
+            if (NEQ(buf->access, VIB_ACCESS_SCAN))
+            {
+                buffer_madvise_(buf, 0, buf->map_length, MADV_SEQUENTIAL);
+                posix_fadvise(buf->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+            }
+        } break;
+
+        default:
+        {
+            PANIC("%s(): unknown access pattern %d", __func__, access);
+        } break;
+    }
+
+    buf->access = access;
+}
+
+OWNED vib_scan_t * vib_buffer_scan(BORROWED vib_buffer_t * buf, COPIED uint64_t offset, COPIED uint64_t length)
+{
+    if (!buf || buf->pieces || EQ(buf->kind, VIB_BUFFER_STREAM) || EQ(buf->kind, VIB_BUFFER_GZIP))
+    {
+        return NIL;
+    }
+
+    vib_buffer_advise(buf, VIB_ACCESS_SCAN, offset, length);
+    return mk_vib_scan(buf->fd, offset, length, VIB_SCAN_AUTO);
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Edits
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+/* The piece table is only created on the first edit; viewing never pays for it. */
+static COPIED result_t buffer_begin_edit_(BORROWED vib_buffer_t * buf, COPIED uint64_t offset)
+{
+    if (!buf)
+    {
+        return RESULT_ERR(EINVAL);
+    }
+
+    /* the original piece must have a fixed length before anything refers to it */
+    if (!buf->size_known)
+    {
+        return RESULT_ERR(ENOTSUP);
+    }
+
+    if (!buf->pieces)
+    {
+        buf->pieces   = mk_vib_piece_table(buf->size);
+        buf->original = buf->size;
+    }
+
+    if (offset > vib_piece_length(buf->pieces))
+    {
+        return RESULT_ERR(EINVAL);
+    }
+
+    buf->generation++;
+    return RESULT_OK(0);
+}
+
+COPIED result_t vib_buffer_insert(BORROWED vib_buffer_t * buf, COPIED uint64_t offset, BORROWED const uint8_t * data, COPIED uint64_t length)
+{
+    COPIED result_t ok = buffer_begin_edit_(buf, offset);
+    if (RESULT_IS_OK(ok))
+    {
+        vib_piece_insert(buf->pieces, offset, data, length);
+    }
+    return ok;
+}
+
+COPIED result_t vib_buffer_delete(BORROWED vib_buffer_t * buf, COPIED uint64_t offset, COPIED uint64_t length)
+{
+    COPIED result_t ok = buffer_begin_edit_(buf, offset);
+    if (RESULT_IS_OK(ok))
+    {
+        vib_piece_delete(buf->pieces, offset, length);
+    }
+    return ok;
+}
+
+COPIED result_t vib_buffer_replace(BORROWED vib_buffer_t * buf, COPIED uint64_t offset, BORROWED const uint8_t * data, COPIED uint64_t length)
+{
+    COPIED result_t ok = buffer_begin_edit_(buf, offset);
+    if (RESULT_IS_OK(ok))
+    {
+        vib_piece_delete(buf->pieces, offset, length);
+        vib_piece_insert(buf->pieces, offset, data, length);
+    }
+    return ok;
+}
+
+COPIED bool vib_buffer_is_modified(BORROWED vib_buffer_t * buf)
+{
+    return buf && buf->pieces;
+}
+
+COPIED result_t vib_buffer_reload(BORROWED vib_buffer_t * buf)
+{
+    if (!buf || (NEQ(buf->kind, VIB_BUFFER_MMAP) && NEQ(buf->kind, VIB_BUFFER_PAGED)))
+    {
+        return RESULT_ERR(ENOTSUP);
+    }
+
+    int fd = open(buf->path, O_RDONLY | O_CLOEXEC);
+    if (-1 == fd)
+    {
+        return RESULT_ERR(errno);
+    }
+
+    struct stat st;
+    if (-1 == fstat(fd, &st))
+    {
+        int err = errno;
+        close(fd);
+        return RESULT_ERR(err);
+    }
+    if (!S_ISREG(st.st_mode))
+    {
+        close(fd);
+        return RESULT_ERR(ENOTSUP);
+    }
+
+    /* the worker reads through the old descriptor and cache */
+    buf->readahead = vib_readahead_dispose(buf->readahead);
+
+    COPIED uint64_t budget = buf->cache
+                           ? vib_pcache_stats(buf->cache).capacity * VIB_PCACHE_PAGE_SIZE
+                           : VIB_PCACHE_DEFAULT_BUDGET;
+    if (buf->map)
+    {
+        munmap(buf->map, buf->map_length);
+    }
+    buf->map        = NIL;
+    buf->map_length = 0;
+    buf->cache      = vib_pcache_dispose(buf->cache);
+    buf->pieces     = vib_piece_table_dispose(buf->pieces);
+    close(buf->fd);
+
+    buf->kind       = VIB_BUFFER_MMAP;
+    buf->fd         = fd;
+    buf->size       = (uint64_t) st.st_size;
+    buf->size_known = true;
+    buf->generation++;
+
+    int err = buffer_map_(buf);
+    if (err)
+    {
+        err = buffer_page_(buf, budget);
+    }
+    if (err)
+    {
+        /* nothing can read the new file: show it empty rather than fault */
+        buf->cache = vib_pcache_dispose(buf->cache);
+        buf->kind  = VIB_BUFFER_MMAP;
+        buf->size  = 0;
+        return RESULT_ERR(err);
+    }
+    buffer_map_holes_(buf);
+
+    /* the watch followed the old inode */
+    if (buf->watch_fd >= 0)
+    {
+        close(buf->watch_fd);
+        buffer_watch_(buf);
+    }
+    return RESULT_OK(0);
+}
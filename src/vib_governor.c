@@ -0,0 +1,290 @@
+#include "vib_governor.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+#include "memory.h"
+
+typedef struct vib_governor_t vib_governor_t;
+
+struct vib_consumer_t
+{
+    COPIED   vib_memory_kind_t        kind;
+    COPIED   uint64_t                 cost;
+    BORROWED vib_governor_shrink_fn * shrink;
+    BORROWED void                   * ctx;
+    COPIED   uint64_t                 passed;       /* reclaim round in which it had nothing left */
+    COPIED   uint64_t                 busy;         /* reserves inside its shrink callback, guarded by `lock` */
+
+    COPIED   _Atomic uint64_t         charged;
+    COPIED   _Atomic uint64_t         last_used;    /* governor tick of the last hit or miss */
+    COPIED   _Atomic uint64_t         hits;
+    COPIED   _Atomic uint64_t         misses;
+    COPIED   _Atomic uint64_t         evictions;
+};
+
+struct vib_governor_t
+{
+    COPIED   _Atomic uint64_t         budget;
+    COPIED   _Atomic int64_t          heap;
+    COPIED   _Atomic uint64_t         tick;
+
+    /* Membership and retired counters, guarded by `lock` */
+    COPIED   pthread_mutex_t          lock;
+    COPIED   pthread_cond_t           idle;         /* a shrink callback returned */
+    OWNED    vib_consumer_t        ** consumers;
+    COPIED   uint64_t                 count;
+    COPIED   uint64_t                 capacity;
+    COPIED   uint64_t                 round;
+    COPIED   uint64_t                 retired_hits;
+    COPIED   uint64_t                 retired_misses;
+    COPIED   uint64_t                 retired_evictions;
+    COPIED   uint64_t                 reclaims;
+    COPIED   uint64_t                 reclaimed;
+};
+
+static vib_governor_t governor = { .lock = PTHREAD_MUTEX_INITIALIZER, .idle = PTHREAD_COND_INITIALIZER };
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Forward Declarations
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+static BORROWED vib_consumer_t * governor_victim_(COPIED uint64_t round);
+static void governor_touch_(BORROWED vib_consumer_t * consumer);
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Budget
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+void vib_governor_set_budget(COPIED uint64_t bytes)
+{
+    atomic_store_explicit(&governor.budget, bytes, memory_order_relaxed);
+}
+
+COPIED uint64_t vib_governor_default_budget()
+{
+    COPIED long pages = sysconf(_SC_PHYS_PAGES);
+    COPIED long size  = sysconf(_SC_PAGESIZE);
+    if (pages <= 0 || size <= 0)
+    {
+        return 0;
+    }
+    return (uint64_t) pages * (uint64_t) size / VIB_GOVERNOR_DEFAULT_SHARE;
+}
+
+void vib_governor_heap(COPIED int64_t delta)
+{
+    atomic_fetch_add_explicit(&governor.heap, delta, memory_order_relaxed);
+}
+
+/*
+ * Shrink the consumer with the best idle-time-to-cost ratio, as often as
+ * needed. One that frees nothing is passed over for the rest of the round,
+ * so a reserve ends once nobody has anything left to give.
+ */
+COPIED bool vib_governor_reserve(COPIED uint64_t bytes)
+{
+    COPIED uint64_t budget = atomic_load_explicit(&governor.budget, memory_order_relaxed);
+    if (EQ(budget, 0))
+    {
+        return true;
+    }
+
+    pthread_mutex_lock(&governor.lock);
+    COPIED uint64_t round = ++governor.round;
+    pthread_mutex_unlock(&governor.lock);
+
+    for (;;)
+    {
+        COPIED int64_t heap = atomic_load_explicit(&governor.heap, memory_order_relaxed);
+        COPIED uint64_t used = (heap > 0) ? (uint64_t) heap : 0;
+        if (used + bytes <= budget)
+        {
+            return true;
+        }
+
+        /* pinned: vib_consumer_dispose() waits until the callback returns */
+        pthread_mutex_lock(&governor.lock);
+        BORROWED vib_consumer_t * victim = governor_victim_(round);
+        if (victim)
+        {
+            victim->busy++;
+        }
+        pthread_mutex_unlock(&governor.lock);
+        if (!victim)
+        {
+            return false;
+        }
+
+        /* outside the lock: the callback takes its own locks and frees memory */
+        COPIED uint64_t freed = victim->shrink(victim->ctx, used + bytes - budget);
+
+        pthread_mutex_lock(&governor.lock);
+        governor.reclaims++;
+        governor.reclaimed += freed;
+        if (EQ(freed, 0))
+        {
+            victim->passed = round;
+        }
+        if (EQ(--victim->busy, 0))
+        {
+            pthread_cond_broadcast(&governor.idle);
+        }
+        pthread_mutex_unlock(&governor.lock);
+    }
+}
+
+/* Callers hold `lock`; consumers passed over in `round` are skipped. */
+static BORROWED vib_consumer_t * governor_victim_(COPIED uint64_t round)
+{
+    COPIED   uint64_t         now  = atomic_load_explicit(&governor.tick, memory_order_relaxed);
+    BORROWED vib_consumer_t * best = NIL;
+    COPIED   double           top  = -1.0;
+
+    for (uint64_t i = 0; i < governor.count; i++)
+    {
+        BORROWED vib_consumer_t * c = governor.consumers[i];
+        if (!c->shrink || EQ(c->passed, round) || EQ(atomic_load_explicit(&c->charged, memory_order_relaxed), 0))
+        {
+            continue;
+        }
+
+        COPIED uint64_t idle  = now - atomic_load_explicit(&c->last_used, memory_order_relaxed);
+        COPIED double   score = (double) (idle + 1) / (double) c->cost;
+        if (score > top)
+        {
+            top  = score;
+            best = c;
+        }
+    }
+    return best;
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Consumers
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+OWNED vib_consumer_t * vib_governor_join(COPIED vib_memory_kind_t kind, COPIED uint64_t cost, BORROWED vib_governor_shrink_fn * shrink, BORROWED void * ctx)
+{
+    OWNED vib_consumer_t * consumer = zeros(sizeof(vib_consumer_t));
+    consumer->kind   = kind;
+    consumer->cost   = cost ? cost : VIB_GOVERNOR_COST_READ;
+    consumer->shrink = shrink;
+    consumer->ctx    = ctx;
+    governor_touch_(consumer);
+
+    pthread_mutex_lock(&governor.lock);
+    if (EQ(governor.count, governor.capacity))
+    {
+        governor.capacity  = governor.capacity ? governor.capacity * 2 : 8;
+        governor.consumers = realloc_smart(governor.consumers, governor.capacity * sizeof(vib_consumer_t *));
+    }
+    governor.consumers[governor.count++] = consumer;
+    pthread_mutex_unlock(&governor.lock);
+    return consumer;
+}
+
+COPIED void * vib_consumer_dispose(OWNED void * arg)
+{
+    if (!arg)
+    {
+        return NIL;
+    }
+
+    OWNED vib_consumer_t * consumer = CAST(arg, vib_consumer_t *);
+    pthread_mutex_lock(&governor.lock);
+    while (consumer->busy)
+    {
+        pthread_cond_wait(&governor.idle, &governor.lock);
+    }
+    for (uint64_t i = 0; i < governor.count; i++)
+    {
+        if (EQ(governor.consumers[i], consumer))
+        {
+            governor.consumers[i] = governor.consumers[--governor.count];
+            break;
+        }
+    }
+    governor.retired_hits      += atomic_load(&consumer->hits);
+    governor.retired_misses    += atomic_load(&consumer->misses);
+    governor.retired_evictions += atomic_load(&consumer->evictions);
+    if (EQ(governor.count, 0))
+    {
+        free_smart(governor.consumers);
+        governor.capacity = 0;
+    }
+    pthread_mutex_unlock(&governor.lock);
+    return dispose(consumer);
+}
+
+void vib_governor_charge(BORROWED vib_consumer_t * consumer, COPIED int64_t delta)
+{
+    if (consumer)
+    {
+        atomic_fetch_add_explicit(&consumer->charged, (uint64_t) delta, memory_order_relaxed);
+    }
+}
+
+static void governor_touch_(BORROWED vib_consumer_t * consumer)
+{
+    COPIED uint64_t now = atomic_fetch_add_explicit(&governor.tick, 1, memory_order_relaxed);
+    atomic_store_explicit(&consumer->last_used, now, memory_order_relaxed);
+}
+
+void vib_governor_hit(BORROWED vib_consumer_t * consumer)
+{
+    if (consumer)
+    {
+        atomic_fetch_add_explicit(&consumer->hits, 1, memory_order_relaxed);
+        governor_touch_(consumer);
+    }
+}
+
+void vib_governor_miss(BORROWED vib_consumer_t * consumer)
+{
+    if (consumer)
+    {
+        atomic_fetch_add_explicit(&consumer->misses, 1, memory_order_relaxed);
+        governor_touch_(consumer);
+    }
+}
+
+void vib_governor_evicted(BORROWED vib_consumer_t * consumer, COPIED uint64_t count)
+{
+    if (consumer)
+    {
+        atomic_fetch_add_explicit(&consumer->evictions, count, memory_order_relaxed);
+    }
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Statistics
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+COPIED vib_governor_stats_t vib_governor_stats()
+{
+    COPIED vib_governor_stats_t stats = { 0 };
+    COPIED int64_t              heap  = atomic_load_explicit(&governor.heap, memory_order_relaxed);
+
+    stats.budget = atomic_load_explicit(&governor.budget, memory_order_relaxed);
+    stats.heap   = (heap > 0) ? (uint64_t) heap : 0;
+
+    pthread_mutex_lock(&governor.lock);
+    stats.consumers = governor.count;
+    stats.hits      = governor.retired_hits;
+    stats.misses    = governor.retired_misses;
+    stats.evictions = governor.retired_evictions;
+    stats.reclaims  = governor.reclaims;
+    stats.reclaimed = governor.reclaimed;
+    for (uint64_t i = 0; i < governor.count; i++)
+    {
+        BORROWED vib_consumer_t * c = governor.consumers[i];
+        stats.charged[c->kind] += atomic_load_explicit(&c->charged, memory_order_relaxed);
+        stats.hits             += atomic_load_explicit(&c->hits, memory_order_relaxed);
+        stats.misses           += atomic_load_explicit(&c->misses, memory_order_relaxed);
+        stats.evictions        += atomic_load_explicit(&c->evictions, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&governor.lock);
+    return stats;
+}
@@ -0,0 +1,611 @@
+#include "vib_gzip.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include "memory.h"
+#include "cstr.h"
+#include "vib_paths.h"
+
+#define VIB_GZIP_INDEX_MAGIC    "VIBGZIX1"
+#define VIB_GZIP_AUTO_BITS      (15 + 16)   /* gzip header and trailer, largest window */
+#define VIB_GZIP_RAW_BITS       (-15)       /* bare deflate, as inside a member */
+#define VIB_GZIP_TRAILER        (8UL)       /* CRC-32 and ISIZE after each member */
+
+typedef struct vib_gzip_point_t vib_gzip_point_t;
+typedef struct vib_gzip_index_header_t vib_gzip_index_header_t;
+
+struct vib_gzip_point_t
+{
+    COPIED uint64_t   out;              /* decompressed offset */
+    COPIED uint64_t   in;               /* compressed offset of the next whole byte */
+    COPIED uint32_t   bits;             /* bits of the byte before `in` still unread, 0-7 */
+    COPIED uint32_t   window_length;    /* short right after a member starts */
+    COPIED uint32_t   packed_length;    /* equal to `window_length` when stored as is */
+    OWNED  uint8_t  * packed;
+};
+
+/* Saved index: this header, then per point its five numbers and packed dictionary. */
+struct vib_gzip_index_header_t
+{
+    COPIED char       magic[8];
+    COPIED uint64_t   compressed;
+    COPIED uint64_t   mtime_sec;
+    COPIED uint64_t   mtime_nsec;
+    COPIED uint64_t   span;
+    COPIED uint64_t   size;
+    COPIED uint64_t   count;
+};
+
+struct vib_gzip_t
+{
+    COPIED   int                fd;
+    COPIED   uint64_t           size;
+
+    /* Index, fixed once open returns */
+    OWNED    vib_gzip_point_t * points;
+    COPIED   uint64_t           count;
+    COPIED   uint64_t           capacity;
+
+    /* Decoder, guarded by `lock` */
+    COPIED   pthread_mutex_t    lock;
+    COPIED   z_stream           stream;
+    COPIED   bool               active;
+    COPIED   bool               raw;        /* restored from a checkpoint, inside a member */
+    COPIED   uint64_t           in_pos;     /* compressed offset of the next read into `input` */
+    COPIED   uint64_t           out_pos;    /* decompressed offset of the next byte out */
+    OWNED    uint8_t          * input;
+    OWNED    uint8_t          * window;
+    OWNED    uint8_t          * discard;    /* output skipped on the way to an offset */
+};
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Forward Declarations
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+static COPIED int gzip_build_(BORROWED vib_gzip_t * gz);
+static void gzip_checkpoint_(BORROWED vib_gzip_t * gz, COPIED uint64_t in, COPIED uint64_t out);
+static COPIED bool gzip_member_at_(COPIED int fd, COPIED uint64_t offset);
+static BORROWED vib_gzip_point_t * gzip_point_before_(BORROWED vib_gzip_t * gz, COPIED uint64_t offset);
+static COPIED int gzip_restart_(BORROWED vib_gzip_t * gz, BORROWED vib_gzip_point_t * point);
+static COPIED int64_t gzip_refill_(BORROWED vib_gzip_t * gz);
+static COPIED int64_t gzip_inflate_(BORROWED vib_gzip_t * gz, BORROWED uint8_t * dst, COPIED uint64_t length);
+static COPIED bool gzip_next_member_(BORROWED vib_gzip_t * gz);
+static OWNED char * gzip_index_path_(BORROWED const struct stat * st, COPIED bool create);
+static COPIED vib_gzip_index_header_t gzip_index_header_(BORROWED vib_gzip_t * gz, BORROWED const struct stat * st);
+static COPIED bool gzip_load_(BORROWED vib_gzip_t * gz, BORROWED const struct stat * st);
+static void gzip_save_(BORROWED vib_gzip_t * gz, BORROWED const struct stat * st);
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Lifecycle
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+COPIED bool vib_gzip_detect(COPIED int fd)
+{
+    return gzip_member_at_(fd, 0);
+}
+
+COPIED result_t vib_gzip_open(COPIED int fd)
+{
+    struct stat st;
+    if (-1 == fstat(fd, &st))
+    {
+        return RESULT_ERR(errno);
+    }
+    if (!vib_gzip_detect(fd))
+    {
+        return RESULT_ERR(EINVAL);
+    }
+
+    OWNED vib_gzip_t * gz = zeros(sizeof(vib_gzip_t));
+    gz->fd      = fd;
+    gz->input   = new(VIB_GZIP_CHUNK);
+    gz->window  = new(VIB_GZIP_WINDOW);
+    gz->discard = new(VIB_GZIP_CHUNK);
+    pthread_mutex_init(&gz->lock, NIL);
+
+    if (!gzip_load_(gz, &st))
+    {
+        int err = gzip_build_(gz);
+        if (err)
+        {
+            vib_gzip_dispose(gz);
+            return RESULT_ERR(err);
+        }
+        gzip_save_(gz, &st);
+    }
+    return RESULT_OK(gz);
+}
+
+COPIED void * vib_gzip_dispose(OWNED void * arg)
+{
+    if (!arg)
+    {
+        return NIL;
+    }
+
+    OWNED vib_gzip_t * gz = CAST(arg, vib_gzip_t *);
+    if (gz->active)
+    {
+        inflateEnd(&gz->stream);
+    }
+    for (uint64_t i = 0; i < gz->count; i++)
+    {
+        free_smart(gz->points[i].packed);
+    }
+    free_smart(gz->points);
+    free_smart(gz->input);
+    free_smart(gz->window);
+    free_smart(gz->discard);
+    pthread_mutex_destroy(&gz->lock);
+    return dispose(gz);
+}
+
+COPIED uint64_t vib_gzip_size(BORROWED vib_gzip_t * gz)
+{
+    return gz ? gz->size : 0;
+}
+
+COPIED uint64_t vib_gzip_checkpoints(BORROWED vib_gzip_t * gz)
+{
+    return gz ? gz->count : 0;
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Indexing
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+/*
+ * One pass over the whole file. inflate() with Z_BLOCK returns at every
+ * deflate block boundary, the only places a decoder can be restarted from;
+ * a checkpoint is taken at the first one past each span. A file that breaks
+ * off or turns into garbage is indexed up to there.
+ */
+static COPIED int gzip_build_(BORROWED vib_gzip_t * gz)
+{
+    BORROWED z_stream * s = &gz->stream;
+    memset(s, 0, sizeof(*s));
+    if (NEQ(inflateInit2(s, VIB_GZIP_AUTO_BITS), Z_OK))
+    {
+        return ENOMEM;
+    }
+
+    COPIED uint64_t fed   = 0;      /* compressed bytes handed to zlib */
+    COPIED uint64_t total = 0;      /* decompressed bytes */
+    COPIED uint64_t last  = 0;      /* output offset of the last checkpoint */
+    int             err   = 0;
+
+    for (;;)
+    {
+        if (EQ(s->avail_in, 0))
+        {
+            ssize_t n = pread(gz->fd, gz->input, VIB_GZIP_CHUNK, (off_t) fed);
+            if (n < 0 && EQ(errno, EINTR))
+            {
+                continue;
+            }
+            if (n <= 0)
+            {
+                err = (n < 0) ? errno : 0;
+                break;
+            }
+            fed        += (uint64_t) n;
+            s->next_in  = gz->input;
+            s->avail_in = (uInt) n;
+        }
+
+        s->next_out  = gz->discard;
+        s->avail_out = VIB_GZIP_CHUNK;
+        int ret = inflate(s, Z_BLOCK);
+        total += VIB_GZIP_CHUNK - s->avail_out;
+
+        if (EQ(ret, Z_STREAM_END))
+        {
+            COPIED uint64_t next = fed - s->avail_in;
+            if (!gzip_member_at_(gz->fd, next))
+            {
+                break;
+            }
+            inflateReset(s);
+            s->avail_in = 0;
+            fed         = next;
+            continue;
+        }
+        if (NEQ(ret, Z_OK) && NEQ(ret, Z_BUF_ERROR))
+        {
+            err = EQ(total, 0) ? EINVAL : 0;
+            break;
+        }
+
+        /* bit 7: stopped at a block boundary; bit 6: after the member's last block */
+        if (EQ(s->data_type & 192, 128) && total - last >= VIB_GZIP_SPAN)
+        {
+            gzip_checkpoint_(gz, fed - s->avail_in, total);
+            last = total;
+        }
+    }
+
+    inflateEnd(s);
+    memset(s, 0, sizeof(*s));
+    gz->size = total;
+    return err;
+}
+
+static void gzip_checkpoint_(BORROWED vib_gzip_t * gz, COPIED uint64_t in, COPIED uint64_t out)
+{
+    if (EQ(gz->count, gz->capacity))
+    {
+        gz->capacity = gz->capacity ? gz->capacity * 2 : 64;
+        gz->points   = realloc_smart(gz->points, gz->capacity * sizeof(vib_gzip_point_t));
+    }
+
+    uInt length = VIB_GZIP_WINDOW;
+    inflateGetDictionary(&gz->stream, gz->window, &length);
+
+    /* dictionaries of text or structured dumps shrink a lot at level 1 */
+    uLongf           packed = compressBound(length);
+    OWNED  uint8_t * data   = new(packed);
+    if (NEQ(compress2(data, &packed, gz->window, length, 1), Z_OK) || packed >= length)
+    {
+        memcpy(data, gz->window, length);
+        packed = length;
+    }
+
+    gz->points[gz->count++] = (vib_gzip_point_t)
+    {
+        .out           = out,
+        .in            = in,
+        .bits          = (uint32_t) (gz->stream.data_type & 7),
+        .window_length = length,
+        .packed_length = (uint32_t) packed,
+        .packed        = realloc_smart(data, packed ? packed : 1),
+    };
+}
+
+static COPIED bool gzip_member_at_(COPIED int fd, COPIED uint64_t offset)
+{
+    uint8_t magic[2];
+    return EQ(pread(fd, magic, sizeof(magic), (off_t) offset), 2)
+        && EQ(magic[0], 0x1F)
+        && EQ(magic[1], 0x8B);
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Reading
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+COPIED int64_t vib_gzip_fill(BORROWED void * ctx, BORROWED uint8_t * dst, COPIED uint64_t offset, COPIED uint64_t length)
+{
+    BORROWED vib_gzip_t * gz = CAST(ctx, vib_gzip_t *);
+    if (offset >= gz->size)
+    {
+        return 0;
+    }
+    if (length > gz->size - offset)
+    {
+        length = gz->size - offset;
+    }
+
+    pthread_mutex_lock(&gz->lock);
+
+    /* keep going from the last read unless a checkpoint is closer */
+    BORROWED vib_gzip_point_t * point = gzip_point_before_(gz, offset);
+    COPIED   uint64_t           from  = point ? point->out : 0;
+    COPIED   int64_t            n     = 0;
+    if (!gz->active || gz->out_pos > offset || gz->out_pos < from)
+    {
+        int err = gzip_restart_(gz, point);
+        if (err)
+        {
+            pthread_mutex_unlock(&gz->lock);
+            errno = err;
+            return -1;
+        }
+    }
+
+    while (gz->out_pos < offset)
+    {
+        COPIED uint64_t skip = offset - gz->out_pos;
+        n = gzip_inflate_(gz, gz->discard, (skip < VIB_GZIP_CHUNK) ? skip : VIB_GZIP_CHUNK);
+        if (n <= 0)
+        {
+            break;
+        }
+    }
+    if (EQ(gz->out_pos, offset))
+    {
+        n = gzip_inflate_(gz, dst, length);
+    }
+
+    pthread_mutex_unlock(&gz->lock);
+    return n;
+}
+
+static BORROWED vib_gzip_point_t * gzip_point_before_(BORROWED vib_gzip_t * gz, COPIED uint64_t offset)
+{
+    COPIED uint64_t lo = 0;
+    COPIED uint64_t hi = gz->count;
+    while (lo < hi)
+    {
+        COPIED uint64_t mid = lo + (hi - lo) / 2;
+        if (gz->points[mid].out <= offset)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return EQ(lo, 0) ? NIL : &gz->points[lo - 1];
+}
+
+/* Point the decoder at a checkpoint, or at the start of the file for NIL. */
+static COPIED int gzip_restart_(BORROWED vib_gzip_t * gz, BORROWED vib_gzip_point_t * point)
+{
+    BORROWED z_stream * s = &gz->stream;
+    if (gz->active)
+    {
+        inflateEnd(s);
+        gz->active = false;
+    }
+    memset(s, 0, sizeof(*s));
+
+    if (NEQ(inflateInit2(s, point ? VIB_GZIP_RAW_BITS : VIB_GZIP_AUTO_BITS), Z_OK))
+    {
+        return ENOMEM;
+    }
+    gz->active  = true;
+    gz->raw     = NIL != point;
+    gz->in_pos  = point ? point->in : 0;
+    gz->out_pos = point ? point->out : 0;
+    if (!point)
+    {
+        return 0;
+    }
+
+    /* the checkpoint fell mid-byte: feed the decoder that byte's high bits */
+    if (point->bits)
+    {
+        uint8_t byte;
+        if (NEQ(pread(gz->fd, &byte, 1, (off_t) point->in - 1), 1))
+        {
+            gz->active = false;
+            inflateEnd(s);
+            return EIO;
+        }
+        inflatePrime(s, (int) point->bits, byte >> (8 - point->bits));
+    }
+
+    uLongf length = point->window_length;
+    if (EQ(point->packed_length, point->window_length))
+    {
+        memcpy(gz->window, point->packed, length);
+    }
+    else if (NEQ(uncompress(gz->window, &length, point->packed, point->packed_length), Z_OK))
+    {
+        gz->active = false;
+        inflateEnd(s);
+        return EIO;
+    }
+    inflateSetDictionary(s, gz->window, (uInt) length);
+    return 0;
+}
+
+static COPIED int64_t gzip_refill_(BORROWED vib_gzip_t * gz)
+{
+    for (;;)
+    {
+        ssize_t n = pread(gz->fd, gz->input, VIB_GZIP_CHUNK, (off_t) gz->in_pos);
+        if (n < 0 && EQ(errno, EINTR))
+        {
+            continue;
+        }
+        if (n > 0)
+        {
+            gz->in_pos          += (uint64_t) n;
+            gz->stream.next_in   = gz->input;
+            gz->stream.avail_in  = (uInt) n;
+        }
+        return n;
+    }
+}
+
+/* Decompress up to `length` bytes; short only at the end of the data. */
+static COPIED int64_t gzip_inflate_(BORROWED vib_gzip_t * gz, BORROWED uint8_t * dst, COPIED uint64_t length)
+{
+    BORROWED z_stream * s        = &gz->stream;
+    COPIED   uint64_t   produced = 0;
+
+    while (produced < length)
+    {
+        if (EQ(s->avail_in, 0))
+        {
+            COPIED int64_t n = gzip_refill_(gz);
+            if (n < 0)
+            {
+                gz->active = false;
+                inflateEnd(s);
+                return -1;
+            }
+            if (EQ(n, 0))
+            {
+                break;
+            }
+        }
+
+        COPIED uint64_t want = length - produced;
+        s->next_out  = dst + produced;
+        s->avail_out = (uInt) want;
+
+        int ret = inflate(s, Z_NO_FLUSH);
+        COPIED uint64_t n = want - s->avail_out;
+        produced    += n;
+        gz->out_pos += n;
+
+        if (EQ(ret, Z_STREAM_END))
+        {
+            if (!gzip_next_member_(gz))
+            {
+                break;
+            }
+        }
+        else if (NEQ(ret, Z_OK) && NEQ(ret, Z_BUF_ERROR))
+        {
+            gz->active = false;
+            inflateEnd(s);
+            errno = EIO;
+            return -1;
+        }
+    }
+    return (int64_t) produced;
+}
+
+/* Step over the member trailer onto the next member's header, if there is one. */
+static COPIED bool gzip_next_member_(BORROWED vib_gzip_t * gz)
+{
+    /* in gzip mode zlib reads the trailer itself; raw deflate stops before it */
+    COPIED uint64_t next = gz->in_pos - gz->stream.avail_in + (gz->raw ? VIB_GZIP_TRAILER : 0);
+    if (!gzip_member_at_(gz->fd, next))
+    {
+        return false;
+    }
+
+    inflateReset2(&gz->stream, VIB_GZIP_AUTO_BITS);
+    gz->stream.avail_in = 0;
+    gz->raw             = false;
+    gz->in_pos          = next;
+    return true;
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Saved Index
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+static OWNED char * gzip_index_path_(BORROWED const struct stat * st, COPIED bool create)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "gzip-%lx-%lx.idx", (uint64_t) st->st_dev, (uint64_t) st->st_ino);
+    return vib_paths_cache(name, create);
+}
+
+static COPIED vib_gzip_index_header_t gzip_index_header_(BORROWED vib_gzip_t * gz, BORROWED const struct stat * st)
+{
+    COPIED vib_gzip_index_header_t header =
+    {
+        .compressed = (uint64_t) st->st_size,
+        .mtime_sec  = (uint64_t) st->st_mtim.tv_sec,
+        .mtime_nsec = (uint64_t) st->st_mtim.tv_nsec,
+        .span       = VIB_GZIP_SPAN,
+        .size       = gz->size,
+        .count      = gz->count,
+    };
+    memcpy(header.magic, VIB_GZIP_INDEX_MAGIC, sizeof(header.magic));
+    return header;
+}
+
+/* Trust a saved index only for the same inode at the same size and mtime. */
+static COPIED bool gzip_load_(BORROWED vib_gzip_t * gz, BORROWED const struct stat * st)
+{
+    OWNED char * path = gzip_index_path_(st, false);
+    FILE        * file = path ? fopen(path, "rb") : NIL;
+    free_smart(path);
+    if (!file)
+    {
+        return false;
+    }
+
+    COPIED vib_gzip_index_header_t header;
+    COPIED vib_gzip_index_header_t expect = gzip_index_header_(gz, st);
+    COPIED bool ok = EQ(fread(&header, sizeof(header), 1, file), 1)
+                  && EQ(memcmp(header.magic, expect.magic, sizeof(header.magic)), 0)
+                  && EQ(header.compressed, expect.compressed)
+                  && EQ(header.mtime_sec, expect.mtime_sec)
+                  && EQ(header.mtime_nsec, expect.mtime_nsec)
+                  && EQ(header.span, expect.span);
+
+    for (uint64_t i = 0; ok && i < header.count; i++)
+    {
+        COPIED vib_gzip_point_t point = { 0 };
+        ok = EQ(fread(&point.out, sizeof(point.out), 1, file), 1)
+          && EQ(fread(&point.in, sizeof(point.in), 1, file), 1)
+          && EQ(fread(&point.bits, sizeof(point.bits), 1, file), 1)
+          && EQ(fread(&point.window_length, sizeof(point.window_length), 1, file), 1)
+          && EQ(fread(&point.packed_length, sizeof(point.packed_length), 1, file), 1)
+          && point.bits < 8
+          && point.in <= header.compressed
+          && point.out <= header.size
+          && point.window_length <= VIB_GZIP_WINDOW
+          && point.packed_length <= point.window_length;
+        if (!ok)
+        {
+            break;
+        }
+
+        point.packed = new(point.packed_length ? point.packed_length : 1);
+        ok = EQ(fread(point.packed, 1, point.packed_length, file), point.packed_length);
+
+        if (EQ(gz->count, gz->capacity))
+        {
+            gz->capacity = gz->capacity ? gz->capacity * 2 : 64;
+            gz->points   = realloc_smart(gz->points, gz->capacity * sizeof(vib_gzip_point_t));
+        }
+        gz->points[gz->count++] = point;
+    }
+    fclose(file);
+
+    if (!ok)
+    {
+        for (uint64_t i = 0; i < gz->count; i++)
+        {
+            free_smart(gz->points[i].packed);
+        }
+        gz->count = 0;
+        return false;
+    }
+    gz->size = header.size;
+    return true;
+}
+
+/* Best effort: without a writable cache directory the next open indexes again. */
+static void gzip_save_(BORROWED vib_gzip_t * gz, BORROWED const struct stat * st)
+{
+    OWNED char * path = gzip_index_path_(st, true);
+    if (!path)
+    {
+        return;
+    }
+    OWNED char * temp = mk_cstr(path, ".tmp");
+    FILE       * file = fopen(temp, "wb");
+
+    COPIED vib_gzip_index_header_t header = gzip_index_header_(gz, st);
+    COPIED bool ok = file && EQ(fwrite(&header, sizeof(header), 1, file), 1);
+    for (uint64_t i = 0; ok && i < gz->count; i++)
+    {
+        BORROWED vib_gzip_point_t * point = &gz->points[i];
+        ok = EQ(fwrite(&point->out, sizeof(point->out), 1, file), 1)
+          && EQ(fwrite(&point->in, sizeof(point->in), 1, file), 1)
+          && EQ(fwrite(&point->bits, sizeof(point->bits), 1, file), 1)
+          && EQ(fwrite(&point->window_length, sizeof(point->window_length), 1, file), 1)
+          && EQ(fwrite(&point->packed_length, sizeof(point->packed_length), 1, file), 1)
+          && EQ(fwrite(point->packed, 1, point->packed_length, file), point->packed_length);
+    }
+    if (file && fclose(file))
+    {
+        ok = false;
+    }
+
+    /* readers see the old index or the whole new one */
+    if (!ok || rename(temp, path))
+    {
+        unlink(temp);
+    }
+    free_smart(temp);
+    free_smart(path);
+}
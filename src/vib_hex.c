@@ -0,0 +1,664 @@
+#include "vib_hex.h"
+
+#include <string.h>
+
+#include "assertion.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define VIB_HEX_X86             (1)
+#endif
+
+#define VIB_HEX_GROUP_CHARS     (3UL * VIB_HEX_GROUP + 1UL)     /* a full group and the space after it */
+#define VIB_HEX_ROW_SHAPES      (4UL)                           /* rows of 8 << n bytes, words of 1 << n bytes */
+
+/** Format `groups` full groups of VIB_HEX_GROUP bytes, VIB_HEX_GROUP_CHARS characters each. */
+typedef void (vib_hex_digits_fn) (BORROWED char * dst, BORROWED const uint8_t * src, COPIED uint64_t groups);
+/** The two digits of each of `length` bytes, back to back. */
+typedef void (vib_hex_pairs_fn) (BORROWED char * dst, BORROWED const uint8_t * src, COPIED uint64_t length);
+/** Format one full row of a fixed width and word. */
+typedef void (vib_hex_row_fn) (BORROWED char * dst, BORROWED const uint8_t * src);
+typedef void (vib_hex_ascii_fn) (BORROWED char * dst, BORROWED const uint8_t * src, COPIED uint64_t length);
+typedef void (vib_hex_classify_fn) (BORROWED uint8_t * dst, BORROWED const uint8_t * src, COPIED uint64_t length);
+
+/* Digit pairs of every byte value: byte b is at [2b, 2b + 1]. */
+static const char VIB_HEX_PAIRS[] =
+    "000102030405060708090A0B0C0D0E0F101112131415161718191A1B1C1D1E1F"
+    "202122232425262728292A2B2C2D2E2F303132333435363738393A3B3C3D3E3F"
+    "404142434445464748494A4B4C4D4E4F505152535455565758595A5B5C5D5E5F"
+    "606162636465666768696A6B6C6D6E6F707172737475767778797A7B7C7D7E7F"
+    "808182838485868788898A8B8C8D8E8F909192939495969798999A9B9C9D9E9F"
+    "A0A1A2A3A4A5A6A7A8A9AAABACADAEAFB0B1B2B3B4B5B6B7B8B9BABBBCBDBEBF"
+    "C0C1C2C3C4C5C6C7C8C9CACBCCCDCECFD0D1D2D3D4D5D6D7D8D9DADBDCDDDEDF"
+    "E0E1E2E3E4E5E6E7E8E9EAEBECEDEEEFF0F1F2F3F4F5F6F7F8F9FAFBFCFDFEFF";
+
+#define N VIB_HEX_NUL
+#define P VIB_HEX_PRINTABLE
+#define W VIB_HEX_WHITESPACE
+#define C VIB_HEX_CONTROL
+#define H VIB_HEX_HIGH
+#define F VIB_HEX_FF
+
+const uint8_t VIB_HEX_CLASS[256] =
+{
+    N, C, C, C, C, C, C, C, C, W, W, W, W, W, C, C,     /* 0x00 */
+    C, C, C, C, C, C, C, C, C, C, C, C, C, C, C, C,     /* 0x10 */
+    W, P, P, P, P, P, P, P, P, P, P, P, P, P, P, P,     /* 0x20 */
+    P, P, P, P, P, P, P, P, P, P, P, P, P, P, P, P,     /* 0x30 */
+    P, P, P, P, P, P, P, P, P, P, P, P, P, P, P, P,     /* 0x40 */
+    P, P, P, P, P, P, P, P, P, P, P, P, P, P, P, P,     /* 0x50 */
+    P, P, P, P, P, P, P, P, P, P, P, P, P, P, P, P,     /* 0x60 */
+    P, P, P, P, P, P, P, P, P, P, P, P, P, P, P, C,     /* 0x70 */
+    H, H, H, H, H, H, H, H, H, H, H, H, H, H, H, H,     /* 0x80 */
+    H, H, H, H, H, H, H, H, H, H, H, H, H, H, H, H,
+    H, H, H, H, H, H, H, H, H, H, H, H, H, H, H, H,
+    H, H, H, H, H, H, H, H, H, H, H, H, H, H, H, H,
+    H, H, H, H, H, H, H, H, H, H, H, H, H, H, H, H,
+    H, H, H, H, H, H, H, H, H, H, H, H, H, H, H, H,
+    H, H, H, H, H, H, H, H, H, H, H, H, H, H, H, H,
+    H, H, H, H, H, H, H, H, H, H, H, H, H, H, H, F,     /* 0xF0 */
+};
+
+#undef N
+#undef P
+#undef W
+#undef C
+#undef H
+#undef F
+
+static struct {
+    COPIED   vib_hex_path_t        path;        /* VIB_HEX_AUTO until the first use */
+    BORROWED vib_hex_digits_fn   * digits;
+    BORROWED vib_hex_pairs_fn    * pairs;
+    BORROWED vib_hex_ascii_fn    * ascii;
+    BORROWED vib_hex_classify_fn * classify;
+} hex = { .path = VIB_HEX_AUTO };
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Forward Declarations
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+static void hex_ready_();
+static void hex_digits_scalar_(BORROWED char * dst, BORROWED const uint8_t * src, COPIED uint64_t groups);
+static void hex_pairs_scalar_(BORROWED char * dst, BORROWED const uint8_t * src, COPIED uint64_t length);
+static void hex_ascii_scalar_(BORROWED char * dst, BORROWED const uint8_t * src, COPIED uint64_t length);
+static void hex_classify_scalar_(BORROWED uint8_t * dst, BORROWED const uint8_t * src, COPIED uint64_t length);
+#ifdef VIB_HEX_X86
+static void hex_digits_sse2_(BORROWED char * dst, BORROWED const uint8_t * src, COPIED uint64_t groups);
+static void hex_pairs_sse2_(BORROWED char * dst, BORROWED const uint8_t * src, COPIED uint64_t length);
+static void hex_ascii_sse2_(BORROWED char * dst, BORROWED const uint8_t * src, COPIED uint64_t length);
+static void hex_classify_sse2_(BORROWED uint8_t * dst, BORROWED const uint8_t * src, COPIED uint64_t length);
+static void hex_digits_avx2_(BORROWED char * dst, BORROWED const uint8_t * src, COPIED uint64_t groups);
+static void hex_pairs_avx2_(BORROWED char * dst, BORROWED const uint8_t * src, COPIED uint64_t length);
+static void hex_ascii_avx2_(BORROWED char * dst, BORROWED const uint8_t * src, COPIED uint64_t length);
+static void hex_classify_avx2_(BORROWED uint8_t * dst, BORROWED const uint8_t * src, COPIED uint64_t length);
+#endif
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Dispatch
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+COPIED vib_hex_path_t vib_hex_use(COPIED vib_hex_path_t path)
+{
+    if (EQ(path, VIB_HEX_AUTO))
+    {
+        path = VIB_HEX_AVX2;
+    }
+
+#ifdef VIB_HEX_X86
+    __builtin_cpu_init();
+    if (EQ(path, VIB_HEX_AVX2) && !__builtin_cpu_supports("avx2"))
+    {
+        path = VIB_HEX_SSE2;
+    }
+    if (EQ(path, VIB_HEX_SSE2) && !__builtin_cpu_supports("sse2"))
+    {
+        path = VIB_HEX_SCALAR;
+    }
+#else
+    path = VIB_HEX_SCALAR;
+#endif
+
+    switch (path)
+    {
+        case VIB_HEX_SCALAR:
+        {
+            hex.digits   = hex_digits_scalar_;
+            hex.pairs    = hex_pairs_scalar_;
+            hex.ascii    = hex_ascii_scalar_;
+            hex.classify = hex_classify_scalar_;
+        } break;
+
+#ifdef VIB_HEX_X86
+        case VIB_HEX_SSE2:
+        {
+            hex.digits   = hex_digits_sse2_;
+            hex.pairs    = hex_pairs_sse2_;
+            hex.ascii    = hex_ascii_sse2_;
+            hex.classify = hex_classify_sse2_;
+        } break;
+
+        case VIB_HEX_AVX2:
+        {
+            hex.digits   = hex_digits_avx2_;
+            hex.pairs    = hex_pairs_avx2_;
+            hex.ascii    = hex_ascii_avx2_;
+            hex.classify = hex_classify_avx2_;
+        } break;
+#endif
+
+        default:
+        {
+            PANIC("%s(): unknown hex path %d", __func__, path);
+        } break;
+    }
+
+    hex.path = path;
+    return path;
+}
+
+BORROWED const char * vib_hex_path_name(COPIED vib_hex_path_t path)
+{
+    switch (path)
+    {
+        case VIB_HEX_AUTO:      return "auto";
+        case VIB_HEX_SCALAR:    return "scalar";
+        case VIB_HEX_SSE2:      return "sse2";
+        case VIB_HEX_AVX2:      return "avx2";
+        default:                return "unknown";
+    }
+}
+
+static void hex_ready_()
+{
+    if (EQ(hex.path, VIB_HEX_AUTO))
+    {
+        vib_hex_use(VIB_HEX_AUTO);
+    }
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Row Kernels
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+/*
+ * A full row of `bytes` in words of `word`. Every instance below passes
+ * constants, so the loop unrolls into fixed-size copies and the group gap
+ * tests fold away. Single-byte words are the path's own `XX ` layout.
+ */
+static inline __attribute__((always_inline)) void hex_row_(BORROWED char * dst, BORROWED const uint8_t * src, COPIED uint64_t bytes, COPIED uint64_t word)
+{
+    if (EQ(word, 1))
+    {
+        hex.digits(dst, src, bytes / VIB_HEX_GROUP);
+        return;
+    }
+
+    char            pairs[2 * VIB_HEX_ROW_MAX];
+    COPIED uint64_t n = 0;
+    hex.pairs(pairs, src, bytes);
+
+#pragma GCC unroll 64
+    for (uint64_t i = 0; i < bytes; i += word)
+    {
+        for (uint64_t k = 0; k < 2 * word; k++)
+        {
+            dst[n + k] = pairs[2 * i + k];
+        }
+        dst[n + 2 * word] = ' ';
+        n += 2 * word + 1;
+        if (EQ((i + word) % VIB_HEX_GROUP, 0))
+        {
+            dst[n++] = ' ';
+        }
+    }
+}
+
+#define VIB_HEX_ROW_KERNEL(BYTES, WORD)                                                                 \
+    static void hex_row_##BYTES##_##WORD##_(BORROWED char * dst, BORROWED const uint8_t * src)         \
+    {                                                                                                   \
+        hex_row_(dst, src, BYTES, WORD);                                                                \
+    }
+
+#define VIB_HEX_ROW_KERNELS(BYTES)                                                                      \
+    VIB_HEX_ROW_KERNEL(BYTES, 1)                                                                        \
+    VIB_HEX_ROW_KERNEL(BYTES, 2)                                                                        \
+    VIB_HEX_ROW_KERNEL(BYTES, 4)                                                                        \
+    VIB_HEX_ROW_KERNEL(BYTES, 8)
+
+VIB_HEX_ROW_KERNELS(8)
+VIB_HEX_ROW_KERNELS(16)
+VIB_HEX_ROW_KERNELS(32)
+VIB_HEX_ROW_KERNELS(64)
+
+/* By log2(bytes / 8), then log2(word). */
+static vib_hex_row_fn * const VIB_HEX_ROWS[VIB_HEX_ROW_SHAPES][VIB_HEX_ROW_SHAPES] =
+{
+    { hex_row_8_1_,  hex_row_8_2_,  hex_row_8_4_,  hex_row_8_8_  },
+    { hex_row_16_1_, hex_row_16_2_, hex_row_16_4_, hex_row_16_8_ },
+    { hex_row_32_1_, hex_row_32_2_, hex_row_32_4_, hex_row_32_8_ },
+    { hex_row_64_1_, hex_row_64_2_, hex_row_64_4_, hex_row_64_8_ },
+};
+
+#undef VIB_HEX_ROW_KERNELS
+#undef VIB_HEX_ROW_KERNEL
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Rows
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+COPIED uint64_t vib_hex_offset(BORROWED char * dst, COPIED uint64_t offset, COPIED uint64_t digits)
+{
+    COPIED uint64_t k = digits;
+    for (; k >= 2; k -= 2)
+    {
+        memcpy(dst + k - 2, VIB_HEX_PAIRS + 2 * (offset & 0xFF), 2);
+        offset >>= 8;
+    }
+    if (k)
+    {
+        dst[0] = VIB_HEX_PAIRS[2 * (offset & 0x0F) + 1];
+    }
+    return digits;
+}
+
+COPIED uint64_t vib_hex_digits(BORROWED char * dst, BORROWED const uint8_t * src, COPIED uint64_t length, COPIED uint64_t width, COPIED uint64_t word)
+{
+    hex_ready_();
+    ASSERTF(word > 0 && word <= VIB_HEX_WORD_MAX && EQ(word & (word - 1), 0) && EQ(width % word, 0),
+            "%s(): words of %lu bytes do not fit rows of %lu", __func__, word, width);
+
+    if (length > width)
+    {
+        length = width;
+    }
+
+    /* the common widths, when the row is full, have a kernel of their own */
+    if (EQ(length, width) && width >= VIB_HEX_GROUP && width <= VIB_HEX_ROW_MAX && EQ(width & (width - 1), 0))
+    {
+        VIB_HEX_ROWS[__builtin_ctzl(width) - 3][__builtin_ctzl(word)](dst, src);
+        return VIB_HEX_WIDTH(width, word);
+    }
+
+    if (NEQ(word, 1))
+    {
+        /* a short last row, once per frame at most */
+        BORROWED char * p = dst;
+        for (uint64_t i = 0; i < width; i++)
+        {
+            if (i < length)
+            {
+                memcpy(p, VIB_HEX_PAIRS + 2 * src[i], 2);
+            }
+            else
+            {
+                p[0] = ' ';
+                p[1] = ' ';
+            }
+            p += 2;
+            if (EQ((i + 1) % word, 0))
+            {
+                *p++ = ' ';
+            }
+            if (EQ((i + 1) % VIB_HEX_GROUP, 0) && i + 1 < width)
+            {
+                *p++ = ' ';
+            }
+        }
+        return VIB_HEX_WIDTH(width, word);
+    }
+
+    /* whole groups go to the kernel, which leaves the separator after each */
+    COPIED uint64_t groups = length / VIB_HEX_GROUP;
+    hex.digits(dst, src, groups);
+
+    BORROWED char * p = dst + groups * VIB_HEX_GROUP_CHARS;
+    for (uint64_t i = groups * VIB_HEX_GROUP; i < width; i++)
+    {
+        if (i > groups * VIB_HEX_GROUP && EQ(i % VIB_HEX_GROUP, 0))
+        {
+            *p++ = ' ';
+        }
+        if (i < length)
+        {
+            memcpy(p, VIB_HEX_PAIRS + 2 * src[i], 2);
+        }
+        else
+        {
+            p[0] = ' ';
+            p[1] = ' ';
+        }
+        p[2] = ' ';
+        p   += 3;
+    }
+    return VIB_HEX_WIDTH(width, word);
+}
+
+COPIED uint64_t vib_hex_ascii(BORROWED char * dst, BORROWED const uint8_t * src, COPIED uint64_t length)
+{
+    hex_ready_();
+    hex.ascii(dst, src, length);
+    return length;
+}
+
+COPIED uint64_t vib_hex_classify(BORROWED uint8_t * dst, BORROWED const uint8_t * src, COPIED uint64_t length)
+{
+    hex_ready_();
+    hex.classify(dst, src, length);
+    return length;
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Scalar
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+static void hex_digits_scalar_(BORROWED char * dst, BORROWED const uint8_t * src, COPIED uint64_t groups)
+{
+    for (uint64_t g = 0; g < groups; g++)
+    {
+        for (uint64_t k = 0; k < VIB_HEX_GROUP; k++)
+        {
+            memcpy(dst, VIB_HEX_PAIRS + 2 * src[k], 2);
+            dst[2] = ' ';
+            dst   += 3;
+        }
+        *dst++ = ' ';
+        src   += VIB_HEX_GROUP;
+    }
+}
+
+static void hex_pairs_scalar_(BORROWED char * dst, BORROWED const uint8_t * src, COPIED uint64_t length)
+{
+    for (uint64_t i = 0; i < length; i++)
+    {
+        memcpy(dst + 2 * i, VIB_HEX_PAIRS + 2 * src[i], 2);
+    }
+}
+
+static void hex_ascii_scalar_(BORROWED char * dst, BORROWED const uint8_t * src, COPIED uint64_t length)
+{
+    for (uint64_t i = 0; i < length; i++)
+    {
+        dst[i] = (0x20 <= src[i] && src[i] < 0x7F) ? (char) src[i] : '.';
+    }
+}
+
+static void hex_classify_scalar_(BORROWED uint8_t * dst, BORROWED const uint8_t * src, COPIED uint64_t length)
+{
+    for (uint64_t i = 0; i < length; i++)
+    {
+        dst[i] = VIB_HEX_CLASS[src[i]];
+    }
+}
+
+#ifdef VIB_HEX_X86
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * SSE2
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+/*
+ * SSE2 has no byte shuffle, so digits are made arithmetically (nibble + '0',
+ * plus 7 more above 9) and only the 3-byte layout is done pair by pair.
+ */
+__attribute__((target("sse2")))
+static void hex_digits_sse2_(BORROWED char * dst, BORROWED const uint8_t * src, COPIED uint64_t groups)
+{
+    const __m128i low   = _mm_set1_epi8(0x0F);
+    const __m128i nine  = _mm_set1_epi8(9);
+    const __m128i seven = _mm_set1_epi8(7);
+    const __m128i zero  = _mm_set1_epi8('0');
+
+    for (; groups >= 2; groups -= 2)
+    {
+        __m128i x  = _mm_loadu_si128((const __m128i *) src);
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(x, 4), low);
+        __m128i lo = _mm_and_si128(x, low);
+        hi = _mm_add_epi8(_mm_add_epi8(hi, zero), _mm_and_si128(_mm_cmpgt_epi8(hi, nine), seven));
+        lo = _mm_add_epi8(_mm_add_epi8(lo, zero), _mm_and_si128(_mm_cmpgt_epi8(lo, nine), seven));
+
+        char digits[32];
+        _mm_storeu_si128((__m128i *) digits, _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i *) (digits + 16), _mm_unpackhi_epi8(hi, lo));
+
+        for (uint64_t k = 0; k < 2 * VIB_HEX_GROUP; k++)
+        {
+            memcpy(dst, digits + 2 * k, 2);
+            dst[2] = ' ';
+            dst   += 3;
+            if (EQ(k % VIB_HEX_GROUP, VIB_HEX_GROUP - 1))
+            {
+                *dst++ = ' ';
+            }
+        }
+        src += 2 * VIB_HEX_GROUP;
+    }
+    hex_digits_scalar_(dst, src, groups);
+}
+
+__attribute__((target("sse2")))
+static void hex_pairs_sse2_(BORROWED char * dst, BORROWED const uint8_t * src, COPIED uint64_t length)
+{
+    const __m128i low   = _mm_set1_epi8(0x0F);
+    const __m128i nine  = _mm_set1_epi8(9);
+    const __m128i seven = _mm_set1_epi8(7);
+    const __m128i zero  = _mm_set1_epi8('0');
+
+    COPIED uint64_t i = 0;
+    for (; i + 16 <= length; i += 16)
+    {
+        __m128i x  = _mm_loadu_si128((const __m128i *) (src + i));
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(x, 4), low);
+        __m128i lo = _mm_and_si128(x, low);
+        hi = _mm_add_epi8(_mm_add_epi8(hi, zero), _mm_and_si128(_mm_cmpgt_epi8(hi, nine), seven));
+        lo = _mm_add_epi8(_mm_add_epi8(lo, zero), _mm_and_si128(_mm_cmpgt_epi8(lo, nine), seven));
+
+        _mm_storeu_si128((__m128i *) (dst + 2 * i), _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i *) (dst + 2 * i + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+    hex_pairs_scalar_(dst + 2 * i, src + i, length - i);
+}
+
+/* Printable is 0x20..0x7E; as signed bytes everything from 0x80 up is negative and fails the first test. */
+__attribute__((target("sse2")))
+static void hex_ascii_sse2_(BORROWED char * dst, BORROWED const uint8_t * src, COPIED uint64_t length)
+{
+    const __m128i space = _mm_set1_epi8(0x1F);
+    const __m128i del   = _mm_set1_epi8(0x7F);
+    const __m128i dot   = _mm_set1_epi8('.');
+
+    COPIED uint64_t i = 0;
+    for (; i + 16 <= length; i += 16)
+    {
+        __m128i x  = _mm_loadu_si128((const __m128i *) (src + i));
+        __m128i ok = _mm_and_si128(_mm_cmpgt_epi8(x, space), _mm_cmplt_epi8(x, del));
+        _mm_storeu_si128((__m128i *) (dst + i), _mm_or_si128(_mm_and_si128(ok, x), _mm_andnot_si128(ok, dot)));
+    }
+    hex_ascii_scalar_(dst + i, src + i, length - i);
+}
+
+/*
+ * Classes by compares, later ones overriding earlier ones: below 0x20 is
+ * control, then whitespace, NUL, high (negative as a signed byte, which the
+ * control compare also caught) and 0xFF. Each layer is a select between the
+ * running result and one class, so no byte takes a branch.
+ */
+#define VIB_HEX_CLASSIFY_STEPS(W, set1, cmpeq, cmpgt, and, or, andnot, x, r)    \
+    do                                                                          \
+    {                                                                           \
+        W mask_;                                                                \
+        r     = set1(VIB_HEX_PRINTABLE);                                        \
+        mask_ = or(cmpgt(set1(0x20), x), cmpeq(x, set1(0x7F)));                 \
+        r     = or(andnot(mask_, r), and(mask_, set1(VIB_HEX_CONTROL)));        \
+        mask_ = or(and(cmpgt(x, set1(0x08)), cmpgt(set1(0x0E), x)),             \
+                   cmpeq(x, set1(0x20)));                                       \
+        r     = or(andnot(mask_, r), and(mask_, set1(VIB_HEX_WHITESPACE)));     \
+        mask_ = cmpeq(x, set1(0));                                              \
+        r     = andnot(mask_, r);                                               \
+        mask_ = cmpgt(set1(0), x);                                              \
+        r     = or(andnot(mask_, r), and(mask_, set1(VIB_HEX_HIGH)));           \
+        mask_ = cmpeq(x, set1(-1));                                             \
+        r     = or(andnot(mask_, r), and(mask_, set1(VIB_HEX_FF)));             \
+    } while (0)
+
+__attribute__((target("sse2")))
+static void hex_classify_sse2_(BORROWED uint8_t * dst, BORROWED const uint8_t * src, COPIED uint64_t length)
+{
+    COPIED uint64_t i = 0;
+    for (; i + 16 <= length; i += 16)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i *) (src + i));
+        __m128i r;
+        VIB_HEX_CLASSIFY_STEPS(__m128i, _mm_set1_epi8, _mm_cmpeq_epi8, _mm_cmpgt_epi8,
+                               _mm_and_si128, _mm_or_si128, _mm_andnot_si128, x, r);
+        _mm_storeu_si128((__m128i *) (dst + i), r);
+    }
+    hex_classify_scalar_(dst + i, src + i, length - i);
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * AVX2
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+/*
+ * Every kernel hands its tail to a narrower one. GCC makes that a plain
+ * jump and does not always clear the upper halves of the ymm registers
+ * before it. Legacy SSE code running with them dirty pays a state
+ * transition on every instruction, so each kernel clears them itself.
+ */
+
+/* One group: 16 characters, 8 more, then the separator. */
+__attribute__((target("avx2")))
+static inline void hex_store_group_(BORROWED char * dst, COPIED __m128i head, COPIED __m128i tail)
+{
+    _mm_storeu_si128((__m128i *) dst, head);
+    _mm_storel_epi64((__m128i *) (dst + 16), tail);
+    dst[3 * VIB_HEX_GROUP] = ' ';
+}
+
+/*
+ * Digits come from a 16-entry shuffle table indexed by nibble. Interleaving
+ * high and low digits gives, per 128-bit lane, the 16 digit characters of one
+ * group; two more shuffles spread them to `XX XX ..` with the gaps filled by
+ * OR-ing in spaces (shuffle indices with the top bit set produce zero).
+ */
+__attribute__((target("avx2")))
+static void hex_digits_avx2_(BORROWED char * dst, BORROWED const uint8_t * src, COPIED uint64_t groups)
+{
+    const __m256i low    = _mm256_set1_epi8(0x0F);
+    const __m256i digits = _mm256_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F',
+                                            '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F');
+    const __m256i head   = _mm256_setr_epi8(0, 1, -1, 2, 3, -1, 4, 5, -1, 6, 7, -1, 8, 9, -1, 10,
+                                            0, 1, -1, 2, 3, -1, 4, 5, -1, 6, 7, -1, 8, 9, -1, 10);
+    const __m256i heads  = _mm256_setr_epi8(0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0,
+                                            0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0);
+    const __m256i tail   = _mm256_setr_epi8(11, -1, 12, 13, -1, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                            11, -1, 12, 13, -1, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m256i tails  = _mm256_setr_epi8(0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, 0, 0, 0, 0, 0, 0,
+                                            0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, 0, 0, 0, 0, 0, 0);
+
+    for (; groups >= 4; groups -= 4)
+    {
+        __m256i x  = _mm256_loadu_si256((const __m256i *) src);
+        __m256i hi = _mm256_shuffle_epi8(digits, _mm256_and_si256(_mm256_srli_epi16(x, 4), low));
+        __m256i lo = _mm256_shuffle_epi8(digits, _mm256_and_si256(x, low));
+
+        /* lane 0 holds bytes 0..15, lane 1 bytes 16..31 */
+        __m256i a  = _mm256_unpacklo_epi8(hi, lo);      /* groups 0 and 2 */
+        __m256i b  = _mm256_unpackhi_epi8(hi, lo);      /* groups 1 and 3 */
+        __m256i ah = _mm256_or_si256(_mm256_shuffle_epi8(a, head), heads);
+        __m256i at = _mm256_or_si256(_mm256_shuffle_epi8(a, tail), tails);
+        __m256i bh = _mm256_or_si256(_mm256_shuffle_epi8(b, head), heads);
+        __m256i bt = _mm256_or_si256(_mm256_shuffle_epi8(b, tail), tails);
+
+        hex_store_group_(dst + 0 * VIB_HEX_GROUP_CHARS, _mm256_castsi256_si128(ah), _mm256_castsi256_si128(at));
+        hex_store_group_(dst + 1 * VIB_HEX_GROUP_CHARS, _mm256_castsi256_si128(bh), _mm256_castsi256_si128(bt));
+        hex_store_group_(dst + 2 * VIB_HEX_GROUP_CHARS, _mm256_extracti128_si256(ah, 1), _mm256_extracti128_si256(at, 1));
+        hex_store_group_(dst + 3 * VIB_HEX_GROUP_CHARS, _mm256_extracti128_si256(bh, 1), _mm256_extracti128_si256(bt, 1));
+
+        dst += 4 * VIB_HEX_GROUP_CHARS;
+        src += 4 * VIB_HEX_GROUP;
+    }
+
+    /* the default 16-byte row: the same in one lane */
+    if (groups >= 2)
+    {
+        __m128i x  = _mm_loadu_si128((const __m128i *) src);
+        __m128i hi = _mm_shuffle_epi8(_mm256_castsi256_si128(digits), _mm_and_si128(_mm_srli_epi16(x, 4), _mm256_castsi256_si128(low)));
+        __m128i lo = _mm_shuffle_epi8(_mm256_castsi256_si128(digits), _mm_and_si128(x, _mm256_castsi256_si128(low)));
+        __m128i a  = _mm_unpacklo_epi8(hi, lo);
+        __m128i b  = _mm_unpackhi_epi8(hi, lo);
+
+        hex_store_group_(dst, _mm_or_si128(_mm_shuffle_epi8(a, _mm256_castsi256_si128(head)), _mm256_castsi256_si128(heads)),
+                              _mm_or_si128(_mm_shuffle_epi8(a, _mm256_castsi256_si128(tail)), _mm256_castsi256_si128(tails)));
+        hex_store_group_(dst + VIB_HEX_GROUP_CHARS,
+                         _mm_or_si128(_mm_shuffle_epi8(b, _mm256_castsi256_si128(head)), _mm256_castsi256_si128(heads)),
+                         _mm_or_si128(_mm_shuffle_epi8(b, _mm256_castsi256_si128(tail)), _mm256_castsi256_si128(tails)));
+
+        dst    += 2 * VIB_HEX_GROUP_CHARS;
+        src    += 2 * VIB_HEX_GROUP;
+        groups -= 2;
+    }
+    _mm256_zeroupper();
+    hex_digits_scalar_(dst, src, groups);
+}
+
+/* Unpacking works per lane, so the halves are put back in byte order before storing. */
+__attribute__((target("avx2")))
+static void hex_pairs_avx2_(BORROWED char * dst, BORROWED const uint8_t * src, COPIED uint64_t length)
+{
+    const __m256i low    = _mm256_set1_epi8(0x0F);
+    const __m256i digits = _mm256_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F',
+                                            '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F');
+
+    COPIED uint64_t i = 0;
+    for (; i + 32 <= length; i += 32)
+    {
+        __m256i x  = _mm256_loadu_si256((const __m256i *) (src + i));
+        __m256i hi = _mm256_shuffle_epi8(digits, _mm256_and_si256(_mm256_srli_epi16(x, 4), low));
+        __m256i lo = _mm256_shuffle_epi8(digits, _mm256_and_si256(x, low));
+        __m256i a  = _mm256_unpacklo_epi8(hi, lo);      /* bytes 0..7 and 16..23 */
+        __m256i b  = _mm256_unpackhi_epi8(hi, lo);      /* bytes 8..15 and 24..31 */
+
+        _mm256_storeu_si256((__m256i *) (dst + 2 * i), _mm256_permute2x128_si256(a, b, 0x20));
+        _mm256_storeu_si256((__m256i *) (dst + 2 * i + 32), _mm256_permute2x128_si256(a, b, 0x31));
+    }
+    _mm256_zeroupper();
+    hex_pairs_sse2_(dst + 2 * i, src + i, length - i);
+}
+
+__attribute__((target("avx2")))
+static void hex_ascii_avx2_(BORROWED char * dst, BORROWED const uint8_t * src, COPIED uint64_t length)
+{
+    const __m256i space = _mm256_set1_epi8(0x1F);
+    const __m256i del   = _mm256_set1_epi8(0x7F);
+    const __m256i dot   = _mm256_set1_epi8('.');
+
+    COPIED uint64_t i = 0;
+    for (; i + 32 <= length; i += 32)
+    {
+        __m256i x  = _mm256_loadu_si256((const __m256i *) (src + i));
+        __m256i ok = _mm256_and_si256(_mm256_cmpgt_epi8(x, space), _mm256_cmpgt_epi8(del, x));
+        _mm256_storeu_si256((__m256i *) (dst + i), _mm256_blendv_epi8(dot, x, ok));
+    }
+    _mm256_zeroupper();
+    hex_ascii_sse2_(dst + i, src + i, length - i);
+}
+
+__attribute__((target("avx2")))
+static void hex_classify_avx2_(BORROWED uint8_t * dst, BORROWED const uint8_t * src, COPIED uint64_t length)
+{
+    COPIED uint64_t i = 0;
+    for (; i + 32 <= length; i += 32)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i *) (src + i));
+        __m256i r;
+        VIB_HEX_CLASSIFY_STEPS(__m256i, _mm256_set1_epi8, _mm256_cmpeq_epi8, _mm256_cmpgt_epi8,
+                               _mm256_and_si256, _mm256_or_si256, _mm256_andnot_si256, x, r);
+        _mm256_storeu_si256((__m256i *) (dst + i), r);
+    }
+    _mm256_zeroupper();
+    hex_classify_sse2_(dst + i, src + i, length - i);
+}
+
+#endif
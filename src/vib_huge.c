@@ -0,0 +1,282 @@
+#define _GNU_SOURCE
+#include "vib_huge.h"
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "memory.h"
+#include "vib_governor.h"
+
+typedef struct vib_slab_region_t vib_slab_region_t;
+
+struct vib_slab_region_t
+{
+    OWNED  uint8_t * base;          /* VIB_HUGE_PAGE_SIZE bytes, 2 MiB aligned */
+    COPIED uint64_t  used;          /* bit i: buffer i is handed out */
+    COPIED bool      hugetlb;       /* from the hugetlbfs pool */
+};
+
+struct vib_slab_t
+{
+    COPIED uint64_t            size;        /* bytes per buffer */
+    COPIED uint64_t            per_region;
+    COPIED uint64_t            full;        /* `used` of a region with nothing left */
+    OWNED  vib_slab_region_t * regions;
+    COPIED uint64_t            count;
+    COPIED uint64_t            capacity;
+    COPIED uint64_t            hugetlb;
+};
+
+static _Atomic bool huge_enabled = false;
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Forward Declarations
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+static COPIED uint64_t huge_round_(COPIED uint64_t length);
+static OWNED void * huge_reserve_(COPIED uint64_t length);
+static OWNED void * huge_anonymous_(COPIED uint64_t length, BORROWED bool * hugetlb);
+static void huge_release_(OWNED void * ptr, COPIED uint64_t length);
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Policy
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+void vib_huge_enable(COPIED bool on)
+{
+    atomic_store_explicit(&huge_enabled, on, memory_order_relaxed);
+}
+
+COPIED bool vib_huge_enabled()
+{
+    return atomic_load_explicit(&huge_enabled, memory_order_relaxed);
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Regions
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+static COPIED uint64_t huge_round_(COPIED uint64_t length)
+{
+    return (length + VIB_HUGE_PAGE_SIZE - 1) & ~(VIB_HUGE_PAGE_SIZE - 1);
+}
+
+/*
+ * Reserve `length` bytes of address space at a 2 MiB boundary: map one huge
+ * page more than asked, then give back the misaligned head and the tail.
+ */
+static OWNED void * huge_reserve_(COPIED uint64_t length)
+{
+    OWNED uint8_t * raw = mmap(NIL, length + VIB_HUGE_PAGE_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (EQ(raw, MAP_FAILED))
+    {
+        return MAP_FAILED;
+    }
+
+    COPIED uintptr_t start = ((uintptr_t) raw + VIB_HUGE_PAGE_SIZE - 1) & ~(uintptr_t) (VIB_HUGE_PAGE_SIZE - 1);
+    COPIED uint64_t  head  = start - (uintptr_t) raw;
+    COPIED uint64_t  tail  = VIB_HUGE_PAGE_SIZE - head;
+    if (head)
+    {
+        munmap(raw, head);
+    }
+    if (tail)
+    {
+        munmap((uint8_t *) start + length, tail);
+    }
+    return (void *) start;
+}
+
+/*
+ * The hugetlbfs pool first: those pages are reserved up front and never
+ * split. It is usually empty, so fall back to an aligned anonymous region
+ * that khugepaged and the fault path may back with transparent huge pages.
+ */
+static OWNED void * huge_anonymous_(COPIED uint64_t length, BORROWED bool * hugetlb)
+{
+    *hugetlb = false;
+
+#ifdef MAP_HUGETLB
+    OWNED void * ptr = mmap(NIL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (NEQ(ptr, MAP_FAILED))
+    {
+        *hugetlb = true;
+        return ptr;
+    }
+#endif
+
+    OWNED void * region = huge_reserve_(length);
+    if (EQ(region, MAP_FAILED))
+    {
+        return NIL;
+    }
+    if (NEQ(mprotect(region, length, PROT_READ | PROT_WRITE), 0))
+    {
+        munmap(region, length);
+        return NIL;
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(region, length, MADV_HUGEPAGE);
+#endif
+    return region;
+}
+
+static void huge_release_(OWNED void * ptr, COPIED uint64_t length)
+{
+    munmap(ptr, length);
+    vib_governor_heap(-(int64_t) length);
+}
+
+OWNED void * vib_huge_map_file(COPIED int fd, COPIED uint64_t length)
+{
+    COPIED uint64_t span   = huge_round_(length);
+    OWNED  void   * region = huge_reserve_(span);
+    if (EQ(region, MAP_FAILED))
+    {
+        return MAP_FAILED;
+    }
+
+    OWNED void * map = mmap(region, length, PROT_READ, MAP_SHARED | MAP_FIXED, fd, 0);
+    if (EQ(map, MAP_FAILED))
+    {
+        COPIED int saved = errno;
+        munmap(region, span);
+        errno = saved;
+        return MAP_FAILED;
+    }
+
+    /* the reservation past the last file page is not part of the mapping */
+    COPIED uint64_t mapped = (length + (uint64_t) sysconf(_SC_PAGESIZE) - 1) & ~((uint64_t) sysconf(_SC_PAGESIZE) - 1);
+    if (mapped < span)
+    {
+        munmap((uint8_t *) map + mapped, span - mapped);
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(map, length, MADV_HUGEPAGE);
+#endif
+    return map;
+}
+
+OWNED void * vib_huge_alloc(COPIED uint64_t length)
+{
+    COPIED bool     hugetlb = false;
+    COPIED uint64_t span    = huge_round_(length);
+    OWNED  void   * ptr     = huge_anonymous_(span, &hugetlb);
+    SCP(ptr);
+    vib_governor_heap((int64_t) span);
+    return ptr;
+}
+
+void vib_huge_free(OWNED void * ptr, COPIED uint64_t length)
+{
+    if (ptr)
+    {
+        huge_release_(ptr, huge_round_(length));
+    }
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Slabs
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+OWNED vib_slab_t * mk_vib_slab(COPIED uint64_t size)
+{
+    ASSERTF(size > 0 && EQ(VIB_HUGE_PAGE_SIZE % size, 0) && VIB_HUGE_PAGE_SIZE / size <= 64, "%s(): %lu bytes does not fit a huge page slab", __func__, size);
+
+    OWNED vib_slab_t * slab = zeros(sizeof(vib_slab_t));
+    slab->size       = size;
+    slab->per_region = VIB_HUGE_PAGE_SIZE / size;
+    slab->full       = EQ(slab->per_region, 64) ? UINT64_MAX : ((1ULL << slab->per_region) - 1);
+    return slab;
+}
+
+OWNED void * vib_slab_alloc(BORROWED vib_slab_t * slab)
+{
+    BORROWED vib_slab_region_t * region = NIL;
+    for (uint64_t i = 0; i < slab->count; i++)
+    {
+        if (NEQ(slab->regions[i].used, slab->full))
+        {
+            region = &slab->regions[i];
+            break;
+        }
+    }
+
+    if (!region)
+    {
+        if (EQ(slab->count, slab->capacity))
+        {
+            slab->capacity = slab->capacity ? slab->capacity * 2 : 8;
+            slab->regions  = realloc_smart(slab->regions, slab->capacity * sizeof(vib_slab_region_t));
+        }
+        COPIED bool  hugetlb = false;
+        OWNED  void * base   = huge_anonymous_(VIB_HUGE_PAGE_SIZE, &hugetlb);
+        SCP(base);
+        vib_governor_heap((int64_t) VIB_HUGE_PAGE_SIZE);
+
+        region          = &slab->regions[slab->count++];
+        region->base    = base;
+        region->used    = 0;
+        region->hugetlb = hugetlb;
+        slab->hugetlb  += hugetlb;
+    }
+
+    COPIED uint64_t bit = (uint64_t) __builtin_ctzll(~region->used);
+    region->used |= 1ULL << bit;
+    return region->base + bit * slab->size;
+}
+
+void vib_slab_free(BORROWED vib_slab_t * slab, OWNED void * ptr)
+{
+    if (!ptr)
+    {
+        return;
+    }
+
+    for (uint64_t i = 0; i < slab->count; i++)
+    {
+        BORROWED vib_slab_region_t * region = &slab->regions[i];
+        if ((uint8_t *) ptr < region->base || (uint8_t *) ptr >= region->base + VIB_HUGE_PAGE_SIZE)
+        {
+            continue;
+        }
+
+        region->used &= ~(1ULL << (((uint8_t *) ptr - region->base) / slab->size));
+        if (EQ(region->used, 0))
+        {
+            slab->hugetlb -= region->hugetlb;
+            huge_release_(region->base, VIB_HUGE_PAGE_SIZE);
+            *region = slab->regions[--slab->count];
+        }
+        return;
+    }
+    PANIC("%s(): %p is not from this slab", __func__, ptr);
+}
+
+COPIED uint64_t vib_slab_regions(BORROWED vib_slab_t * slab)
+{
+    return slab->count;
+}
+
+COPIED uint64_t vib_slab_hugetlb(BORROWED vib_slab_t * slab)
+{
+    return slab->hugetlb;
+}
+
+COPIED void * vib_slab_dispose(OWNED void * arg)
+{
+    if (!arg)
+    {
+        return NIL;
+    }
+
+    OWNED vib_slab_t * slab = CAST(arg, vib_slab_t *);
+    for (uint64_t i = 0; i < slab->count; i++)
+    {
+        huge_release_(slab->regions[i].base, VIB_HUGE_PAGE_SIZE);
+    }
+    free_smart(slab->regions);
+    return dispose(slab);
+}
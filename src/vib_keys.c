@@ -36,19 +36,19 @@ static COPIED vib_key_t parse_alt_ctrl_sequence_(BORROWED const int32_t key);
 static void enable_read_timeout_()
 {
     struct termios term;
-    tcgetattr(STDIN_FILENO, &term);
+    tcgetattr(vib_terminal_input_fd(), &term);
     term.c_cc[VMIN]  = 0;
     term.c_cc[VTIME] = ESC_TIMEOUT_DS;
-    tcsetattr(STDIN_FILENO, TCSANOW, &term);
+    tcsetattr(vib_terminal_input_fd(), TCSANOW, &term);
 }
 
 static void disable_read_timeout_()
 {
     struct termios term;
-    tcgetattr(STDIN_FILENO, &term);
+    tcgetattr(vib_terminal_input_fd(), &term);
     term.c_cc[VMIN]  = 1;
     term.c_cc[VTIME] = 0;
-    tcsetattr(STDIN_FILENO, TCSANOW, &term);
+    tcsetattr(vib_terminal_input_fd(), TCSANOW, &term);
 }
 
 /* ─────────────────────────────────────────────────────────────────────────────
@@ -158,6 +158,20 @@ static COPIED vib_key_t parse_csi_sequence_()
         return parse_csi_extended_sequence_(b);
     }
 
+    // ESC [ ? ... <final>
+    // no key sends these; they are terminal replies (DECRPM, DA1) that
+    // arrived after the capability probe gave up, so swallow them whole.
+    if (b == '?')
+    {
+        do
+        {
+            b = vib_terminal_read_raw_byte();
+        } while (b != -1 && !(0x40 <= b && b <= 0x7e));
+        disable_read_timeout_();
+        return VIB_KEY_UNKNOWN;
+    }
+
+    disable_read_timeout_();
     return VIB_KEY_UNKNOWN;
 }
 
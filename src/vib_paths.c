@@ -0,0 +1,39 @@
+#include "vib_paths.h"
+
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include "memory.h"
+#include "cstr.h"
+
+OWNED char * vib_paths_cache(BORROWED const char * name, COPIED bool create)
+{
+    BORROWED const char * xdg  = getenv("XDG_CACHE_HOME");
+    BORROWED const char * home = getenv("HOME");
+
+    OWNED char * base = NIL;
+    if (xdg && xdg[0])
+    {
+        base = strdup_smart(xdg);
+    }
+    else if (home && home[0])
+    {
+        base = mk_cstr(home, "/.cache");
+    }
+    if (!base)
+    {
+        return NIL;
+    }
+
+    OWNED char * dir = mk_cstr(base, "/vib/");
+    if (create)
+    {
+        mkdir(base, 0700);
+        mkdir(dir, 0700);
+    }
+    free_smart(base);
+
+    OWNED char * path = mk_cstr(dir, name);
+    free_smart(dir);
+    return path;
+}
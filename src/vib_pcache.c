@@ -0,0 +1,629 @@
+#include "vib_pcache.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "memory.h"
+#include "vib_huge.h"
+
+#define VIB_PCACHE_EMPTY    (0U)    /* table slot holds no page */
+#define VIB_PCACHE_NO_PAGE  (UINT64_MAX)
+
+typedef struct vib_pcache_page_t vib_pcache_page_t;
+typedef struct vib_pcache_stage_t vib_pcache_stage_t;
+
+struct vib_pcache_page_t
+{
+    COPIED uint64_t  index;         /* page number in the input, VIB_PCACHE_NO_PAGE if free */
+    OWNED  uint8_t * data;
+    COPIED uint64_t  length;        /* valid bytes, shorter than a page at end of input */
+    COPIED bool      referenced;    /* CLOCK second-chance bit */
+};
+
+typedef enum vib_pcache_stage_state_t
+{
+    VIB_PCACHE_STAGE_FREE = 0,
+    VIB_PCACHE_STAGE_LOADING,       /* the readahead thread is filling it */
+    VIB_PCACHE_STAGE_READY,
+} vib_pcache_stage_state_t;
+
+struct vib_pcache_stage_t
+{
+    COPIED vib_pcache_stage_state_t state;
+    COPIED uint64_t                 index;
+    OWNED  uint8_t                * data;
+    COPIED int64_t                  length;     /* fill result */
+    COPIED uint64_t                 serial;     /* landing order, oldest is recycled first */
+    COPIED uint64_t                 epoch;      /* cache epoch when the read started */
+};
+
+struct vib_pcache_t
+{
+    COPIED   uint64_t             capacity;     /* number of pages */
+    OWNED    vib_pcache_page_t  * pages;
+    COPIED   uint64_t             hand;         /* CLOCK hand into `pages` */
+    COPIED   uint64_t             allocated;    /* pages with a buffer, resident or not */
+    OWNED    vib_consumer_t     * consumer;
+    OWNED    vib_slab_t         * slab;         /* huge page backing for buffers, NIL for the heap */
+
+    COPIED   uint64_t             table_mask;   /* table size - 1, size is a power of two */
+    OWNED    uint32_t           * table;        /* page slot + 1, or VIB_PCACHE_EMPTY */
+
+    BORROWED vib_pcache_fill_fn * fill;
+    BORROWED void               * ctx;
+    COPIED   uint64_t             eof;
+
+    COPIED   vib_pcache_stats_t   stats;
+
+    /*
+     * Shared with the readahead thread. The owner writes the page table only
+     * under `lock`, so its own lookups need no lock; the other thread takes
+     * it for everything.
+     */
+    COPIED   pthread_mutex_t      lock;
+    COPIED   pthread_cond_t       landed;       /* a staged page finished loading */
+    COPIED   vib_pcache_stage_t   staged[VIB_PCACHE_STAGED_PAGES];
+    COPIED   uint64_t             serial;
+    COPIED   uint64_t             epoch;        /* bumped by invalidate, stale loads are dropped */
+};
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Forward Declarations
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+static COPIED uint64_t pcache_hash_(COPIED uint64_t index, COPIED uint64_t mask);
+static COPIED uint64_t pcache_lookup_(BORROWED vib_pcache_t * cache, COPIED uint64_t index);
+static void pcache_table_insert_(BORROWED vib_pcache_t * cache, COPIED uint64_t index, COPIED uint64_t slot);
+static void pcache_table_remove_(BORROWED vib_pcache_t * cache, COPIED uint64_t index);
+static COPIED uint64_t pcache_victim_(BORROWED vib_pcache_t * cache, COPIED bool grow);
+static COPIED uint64_t pcache_load_(BORROWED vib_pcache_t * cache, COPIED uint64_t index);
+static BORROWED vib_pcache_stage_t * pcache_stage_find_(BORROWED vib_pcache_t * cache, COPIED uint64_t index);
+static BORROWED vib_pcache_stage_t * pcache_stage_claim_(BORROWED vib_pcache_t * cache);
+static COPIED bool pcache_adopt_(BORROWED vib_pcache_t * cache, COPIED uint64_t index, BORROWED vib_pcache_page_t * page, BORROWED int64_t * n);
+static COPIED uint64_t pcache_shrink_(BORROWED void * ctx, COPIED uint64_t bytes);
+static OWNED uint8_t * pcache_buffer_alloc_(BORROWED vib_pcache_t * cache);
+static void pcache_buffer_free_(BORROWED vib_pcache_t * cache, BORROWED uint8_t ** data);
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Lifecycle
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+OWNED vib_pcache_t * mk_vib_pcache(COPIED uint64_t budget, COPIED uint64_t cost, BORROWED vib_pcache_fill_fn * fill, BORROWED void * ctx)
+{
+    SCP(fill);
+
+    COPIED uint64_t capacity = budget / VIB_PCACHE_PAGE_SIZE;
+    if (capacity < VIB_PCACHE_MIN_PAGES)
+    {
+        capacity = VIB_PCACHE_MIN_PAGES;
+    }
+
+    /* keep the table at most half full so probe chains stay short */
+    COPIED uint64_t table_size = 1;
+    while (table_size < capacity * 2)
+    {
+        table_size <<= 1;
+    }
+
+    OWNED vib_pcache_t * cache = zeros(sizeof(vib_pcache_t));
+    cache->capacity   = capacity;
+    cache->pages      = new(capacity * sizeof(vib_pcache_page_t));
+    cache->hand       = 0;
+    cache->table_mask = table_size - 1;
+    cache->table      = zeros(table_size * sizeof(uint32_t));
+    cache->fill       = fill;
+    cache->ctx        = ctx;
+    cache->eof        = UINT64_MAX;
+
+    for (uint64_t i = 0; i < capacity; i++)
+    {
+        cache->pages[i].index      = VIB_PCACHE_NO_PAGE;
+        cache->pages[i].data       = NIL;
+        cache->pages[i].length     = 0;
+        cache->pages[i].referenced = false;
+    }
+
+    pthread_mutex_init(&cache->lock, NIL);
+    pthread_cond_init(&cache->landed, NIL);
+
+    cache->stats.capacity = capacity;
+    cache->consumer       = vib_governor_join(VIB_MEMORY_PAGES, cost, pcache_shrink_, cache);
+    cache->slab           = vib_huge_enabled() ? mk_vib_slab(VIB_PCACHE_PAGE_SIZE) : NIL;
+    return cache;
+}
+
+COPIED void * vib_pcache_dispose(OWNED void * arg)
+{
+    if (!arg)
+    {
+        return NIL;
+    }
+
+    OWNED vib_pcache_t * cache = CAST(arg, vib_pcache_t *);
+    vib_consumer_dispose(cache->consumer);
+    for (uint64_t i = 0; i < cache->capacity; i++)
+    {
+        pcache_buffer_free_(cache, &cache->pages[i].data);
+    }
+    for (uint64_t i = 0; i < VIB_PCACHE_STAGED_PAGES; i++)
+    {
+        pcache_buffer_free_(cache, &cache->staged[i].data);
+    }
+    vib_slab_dispose(cache->slab);
+    free_smart(cache->pages);
+    free_smart(cache->table);
+    pthread_cond_destroy(&cache->landed);
+    pthread_mutex_destroy(&cache->lock);
+    return dispose(cache);
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Page Table
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+static COPIED uint64_t pcache_hash_(COPIED uint64_t index, COPIED uint64_t mask)
+{
+    /* Fibonacci hashing: sequential page numbers spread over the whole table */
+    return ((index * 11400714819323198485UL) >> 32) & mask;
+}
+
+/* Returns the page slot holding `index`, or VIB_PCACHE_NO_PAGE. */
+static COPIED uint64_t pcache_lookup_(BORROWED vib_pcache_t * cache, COPIED uint64_t index)
+{
+    COPIED uint64_t i = pcache_hash_(index, cache->table_mask);
+    for (;;)
+    {
+        COPIED uint32_t entry = cache->table[i];
+        if (EQ(entry, VIB_PCACHE_EMPTY))
+        {
+            return VIB_PCACHE_NO_PAGE;
+        }
+        if (EQ(cache->pages[entry - 1].index, index))
+        {
+            return entry - 1;
+        }
+        i = (i + 1) & cache->table_mask;
+    }
+}
+
+static void pcache_table_insert_(BORROWED vib_pcache_t * cache, COPIED uint64_t index, COPIED uint64_t slot)
+{
+    COPIED uint64_t i = pcache_hash_(index, cache->table_mask);
+    while (NEQ(cache->table[i], VIB_PCACHE_EMPTY))
+    {
+        i = (i + 1) & cache->table_mask;
+    }
+    cache->table[i] = (uint32_t) (slot + 1);
+}
+
+/* Linear probing delete with backward shift, so no tombstones accumulate. */
+static void pcache_table_remove_(BORROWED vib_pcache_t * cache, COPIED uint64_t index)
+{
+    COPIED uint64_t mask = cache->table_mask;
+    COPIED uint64_t i    = pcache_hash_(index, mask);
+
+    while (NEQ(cache->table[i], VIB_PCACHE_EMPTY) && NEQ(cache->pages[cache->table[i] - 1].index, index))
+    {
+        i = (i + 1) & mask;
+    }
+    if (EQ(cache->table[i], VIB_PCACHE_EMPTY))
+    {
+        return;
+    }
+
+    COPIED uint64_t hole = i;
+    for (;;)
+    {
+        i = (i + 1) & mask;
+        COPIED uint32_t entry = cache->table[i];
+        if (EQ(entry, VIB_PCACHE_EMPTY))
+        {
+            break;
+        }
+
+        /* move the entry back if its home is not in (hole, i] */
+        COPIED uint64_t home = pcache_hash_(cache->pages[entry - 1].index, mask);
+        if (((i - home) & mask) >= ((i - hole) & mask))
+        {
+            cache->table[hole] = entry;
+            hole = i;
+        }
+    }
+    cache->table[hole] = VIB_PCACHE_EMPTY;
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * CLOCK Eviction
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+/* A slot for a new page; without `grow` only one that already has a buffer. */
+static COPIED uint64_t pcache_victim_(BORROWED vib_pcache_t * cache, COPIED bool grow)
+{
+    for (;;)
+    {
+        BORROWED vib_pcache_page_t * page = &cache->pages[cache->hand];
+        COPIED   uint64_t            slot = cache->hand;
+        cache->hand = (cache->hand + 1) % cache->capacity;
+
+        if (!grow && !page->data)
+        {
+            continue;
+        }
+        if (EQ(page->index, VIB_PCACHE_NO_PAGE))
+        {
+            return slot;
+        }
+        if (page->referenced)
+        {
+            page->referenced = false;
+            continue;
+        }
+
+        pcache_table_remove_(cache, page->index);
+        page->index = VIB_PCACHE_NO_PAGE;
+        cache->stats.evictions++;
+        cache->stats.resident--;
+        vib_governor_evicted(cache->consumer, 1);
+        return slot;
+    }
+}
+
+static COPIED uint64_t pcache_load_(BORROWED vib_pcache_t * cache, COPIED uint64_t index)
+{
+    /*
+     * growing: let the governor make room first, possibly out of this very
+     * cache. If it cannot, a page of our own is recycled instead; the
+     * smallest cache may always be reached.
+     */
+    COPIED bool grow = cache->allocated < cache->capacity;
+    if (grow && !vib_governor_reserve(VIB_PCACHE_PAGE_SIZE))
+    {
+        grow = cache->allocated < VIB_PCACHE_MIN_PAGES;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    COPIED   uint64_t            slot = pcache_victim_(cache, grow);
+    BORROWED vib_pcache_page_t * page = &cache->pages[slot];
+    COPIED   int64_t             n    = 0;
+    COPIED   bool                hit  = pcache_adopt_(cache, index, page, &n);
+    if (!page->data)
+    {
+        page->data = pcache_buffer_alloc_(cache);
+        cache->allocated++;
+        vib_governor_charge(cache->consumer, VIB_PCACHE_PAGE_SIZE);
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    COPIED uint64_t offset = index * VIB_PCACHE_PAGE_SIZE;
+    if (!hit)
+    {
+        n = cache->fill(cache->ctx, page->data, offset, VIB_PCACHE_PAGE_SIZE);
+    }
+    if (n < 0)
+    {
+        return VIB_PCACHE_NO_PAGE;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    if ((uint64_t) n < VIB_PCACHE_PAGE_SIZE && offset + (uint64_t) n < cache->eof)
+    {
+        cache->eof = offset + (uint64_t) n;
+    }
+
+    page->index      = index;
+    page->length     = (uint64_t) n;
+    page->referenced = true;
+    pcache_table_insert_(cache, index, slot);
+    cache->stats.resident++;
+    pthread_mutex_unlock(&cache->lock);
+    return slot;
+}
+
+/*
+ * Governor callback: free page buffers until `bytes` are back. Staged pages
+ * nobody is waiting for go first, then pages in CLOCK order, so a page
+ * touched since the hand last passed is spared once.
+ */
+static COPIED uint64_t pcache_shrink_(BORROWED void * ctx, COPIED uint64_t bytes)
+{
+    BORROWED vib_pcache_t * cache   = CAST(ctx, vib_pcache_t *);
+    COPIED   uint64_t       freed   = 0;
+    COPIED   uint64_t       evicted = 0;
+
+    pthread_mutex_lock(&cache->lock);
+    for (uint64_t i = 0; i < VIB_PCACHE_STAGED_PAGES && freed < bytes; i++)
+    {
+        BORROWED vib_pcache_stage_t * stage = &cache->staged[i];
+        if (NEQ(stage->state, VIB_PCACHE_STAGE_LOADING) && stage->data)
+        {
+            pcache_buffer_free_(cache, &stage->data);
+            stage->state = VIB_PCACHE_STAGE_FREE;
+            freed += VIB_PCACHE_PAGE_SIZE;
+        }
+    }
+
+    for (uint64_t step = 0; step < 2 * cache->capacity && freed < bytes && cache->allocated > VIB_PCACHE_MIN_PAGES; step++)
+    {
+        BORROWED vib_pcache_page_t * page = &cache->pages[cache->hand];
+        cache->hand = (cache->hand + 1) % cache->capacity;
+        if (!page->data)
+        {
+            continue;
+        }
+        if (NEQ(page->index, VIB_PCACHE_NO_PAGE))
+        {
+            if (page->referenced)
+            {
+                page->referenced = false;
+                continue;
+            }
+            pcache_table_remove_(cache, page->index);
+            page->index = VIB_PCACHE_NO_PAGE;
+            cache->stats.evictions++;
+            cache->stats.resident--;
+            evicted++;
+        }
+        pcache_buffer_free_(cache, &page->data);
+        cache->allocated--;
+        freed += VIB_PCACHE_PAGE_SIZE;
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    vib_governor_charge(cache->consumer, -(int64_t) freed);
+    vib_governor_evicted(cache->consumer, evicted);
+    return freed;
+}
+
+/* Page buffers come from the huge page slab when there is one. Callers hold `lock`. */
+static OWNED uint8_t * pcache_buffer_alloc_(BORROWED vib_pcache_t * cache)
+{
+    if (cache->slab)
+    {
+        return vib_slab_alloc(cache->slab);
+    }
+    return new_aligned(VIB_PCACHE_PAGE_ALIGN, VIB_PCACHE_PAGE_SIZE);
+}
+
+static void pcache_buffer_free_(BORROWED vib_pcache_t * cache, BORROWED uint8_t ** data)
+{
+    if (cache->slab)
+    {
+        vib_slab_free(cache->slab, *data);
+        *data = NIL;
+        return;
+    }
+    free_smart(*data);
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Prefetch Staging
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+/* Callers hold `lock`. */
+static BORROWED vib_pcache_stage_t * pcache_stage_find_(BORROWED vib_pcache_t * cache, COPIED uint64_t index)
+{
+    for (uint64_t i = 0; i < VIB_PCACHE_STAGED_PAGES; i++)
+    {
+        BORROWED vib_pcache_stage_t * stage = &cache->staged[i];
+        if (NEQ(stage->state, VIB_PCACHE_STAGE_FREE) && EQ(stage->index, index))
+        {
+            return stage;
+        }
+    }
+    return NIL;
+}
+
+/* A free slot, else the oldest ready one: newer predictions win. Callers hold `lock`. */
+static BORROWED vib_pcache_stage_t * pcache_stage_claim_(BORROWED vib_pcache_t * cache)
+{
+    BORROWED vib_pcache_stage_t * oldest = NIL;
+    for (uint64_t i = 0; i < VIB_PCACHE_STAGED_PAGES; i++)
+    {
+        BORROWED vib_pcache_stage_t * stage = &cache->staged[i];
+        if (EQ(stage->state, VIB_PCACHE_STAGE_FREE))
+        {
+            return stage;
+        }
+        if (EQ(stage->state, VIB_PCACHE_STAGE_READY) && (!oldest || stage->serial < oldest->serial))
+        {
+            oldest = stage;
+        }
+    }
+    return oldest;
+}
+
+/*
+ * On a miss, take the page from the staging area if the readahead thread has
+ * it, waiting if it is being read right now. The buffers are swapped, so
+ * adopting costs no copy. Callers hold `lock`.
+ */
+static COPIED bool pcache_adopt_(BORROWED vib_pcache_t * cache, COPIED uint64_t index, BORROWED vib_pcache_page_t * page, BORROWED int64_t * n)
+{
+    BORROWED vib_pcache_stage_t * stage = pcache_stage_find_(cache, index);
+    while (stage && EQ(stage->state, VIB_PCACHE_STAGE_LOADING))
+    {
+        pthread_cond_wait(&cache->landed, &cache->lock);
+        stage = pcache_stage_find_(cache, index);
+    }
+    if (!stage)
+    {
+        return false;
+    }
+
+    /* the page may have had no buffer yet; it keeps the staged one either way */
+    OWNED uint8_t * data = page->data;
+    cache->allocated += data ? 0 : 1;
+    page->data   = stage->data;
+    stage->data  = data;
+    stage->state = VIB_PCACHE_STAGE_FREE;
+    *n = stage->length;
+    cache->stats.prefetched++;
+    return true;
+}
+
+void vib_pcache_prefetch(BORROWED vib_pcache_t * cache, COPIED uint64_t offset, COPIED uint64_t length)
+{
+    if (!cache || EQ(length, 0))
+    {
+        return;
+    }
+
+    COPIED uint64_t first = offset / VIB_PCACHE_PAGE_SIZE;
+    COPIED uint64_t last  = (offset + length - 1) / VIB_PCACHE_PAGE_SIZE;
+    for (uint64_t index = first; index <= last; index++)
+    {
+        pthread_mutex_lock(&cache->lock);
+        if (index * VIB_PCACHE_PAGE_SIZE >= cache->eof)
+        {
+            pthread_mutex_unlock(&cache->lock);
+            return;
+        }
+        if (NEQ(pcache_lookup_(cache, index), VIB_PCACHE_NO_PAGE) || pcache_stage_find_(cache, index))
+        {
+            pthread_mutex_unlock(&cache->lock);
+            continue;
+        }
+
+        BORROWED vib_pcache_stage_t * stage = pcache_stage_claim_(cache);
+        if (!stage)
+        {
+            pthread_mutex_unlock(&cache->lock);
+            return;
+        }
+        stage->state = VIB_PCACHE_STAGE_LOADING;
+        stage->index = index;
+        stage->epoch = cache->epoch;
+        if (!stage->data)
+        {
+            /* staging is small and bounded; it is charged but never waits on a reserve */
+            stage->data = pcache_buffer_alloc_(cache);
+            vib_governor_charge(cache->consumer, VIB_PCACHE_PAGE_SIZE);
+        }
+        BORROWED uint8_t * data = stage->data;
+        pthread_mutex_unlock(&cache->lock);
+
+        COPIED int64_t n = cache->fill(cache->ctx, data, index * VIB_PCACHE_PAGE_SIZE, VIB_PCACHE_PAGE_SIZE);
+
+        pthread_mutex_lock(&cache->lock);
+        stage->length = n;
+        stage->serial = ++cache->serial;
+        stage->state  = (n < 0 || NEQ(stage->epoch, cache->epoch)) ? VIB_PCACHE_STAGE_FREE : VIB_PCACHE_STAGE_READY;
+        pthread_cond_broadcast(&cache->landed);
+        pthread_mutex_unlock(&cache->lock);
+    }
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Access
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+COPIED vib_span_t vib_pcache_span(BORROWED vib_pcache_t * cache, COPIED uint64_t offset, COPIED uint64_t length)
+{
+    COPIED vib_span_t span = { .data = NIL, .length = 0 };
+    if (!cache || offset >= cache->eof)
+    {
+        return span;
+    }
+
+    COPIED uint64_t index = offset / VIB_PCACHE_PAGE_SIZE;
+    COPIED uint64_t slot  = pcache_lookup_(cache, index);
+    if (EQ(slot, VIB_PCACHE_NO_PAGE))
+    {
+        cache->stats.misses++;
+        vib_governor_miss(cache->consumer);
+        slot = pcache_load_(cache, index);
+        if (EQ(slot, VIB_PCACHE_NO_PAGE))
+        {
+            return span;
+        }
+    }
+    else
+    {
+        cache->stats.hits++;
+        cache->pages[slot].referenced = true;
+        vib_governor_hit(cache->consumer);
+    }
+
+    BORROWED vib_pcache_page_t * page  = &cache->pages[slot];
+    COPIED   uint64_t            start = offset - index * VIB_PCACHE_PAGE_SIZE;
+    if (start >= page->length)
+    {
+        return span;
+    }
+
+    COPIED uint64_t avail = page->length - start;
+    span.data   = page->data + start;
+    span.length = (length < avail) ? length : avail;
+    return span;
+}
+
+void vib_pcache_invalidate(BORROWED vib_pcache_t * cache, COPIED uint64_t offset)
+{
+    if (!cache)
+    {
+        return;
+    }
+
+    COPIED uint64_t first = offset / VIB_PCACHE_PAGE_SIZE;
+    pthread_mutex_lock(&cache->lock);
+    for (uint64_t slot = 0; slot < cache->capacity; slot++)
+    {
+        BORROWED vib_pcache_page_t * page = &cache->pages[slot];
+        if (EQ(page->index, VIB_PCACHE_NO_PAGE) || page->index < first)
+        {
+            continue;
+        }
+        pcache_table_remove_(cache, page->index);
+        page->index      = VIB_PCACHE_NO_PAGE;
+        page->referenced = false;
+        cache->stats.resident--;
+    }
+    for (uint64_t i = 0; i < VIB_PCACHE_STAGED_PAGES; i++)
+    {
+        if (EQ(cache->staged[i].state, VIB_PCACHE_STAGE_READY) && cache->staged[i].index >= first)
+        {
+            cache->staged[i].state = VIB_PCACHE_STAGE_FREE;
+        }
+    }
+    cache->eof = UINT64_MAX;
+    cache->epoch++;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+COPIED uint64_t vib_pcache_eof(BORROWED vib_pcache_t * cache)
+{
+    return cache ? cache->eof : UINT64_MAX;
+}
+
+COPIED vib_pcache_stats_t vib_pcache_stats(BORROWED vib_pcache_t * cache)
+{
+    COPIED vib_pcache_stats_t none = { 0 };
+    return cache ? cache->stats : none;
+}
+
+COPIED int64_t vib_pcache_fill_pread(BORROWED void * ctx, BORROWED uint8_t * dst, COPIED uint64_t offset, COPIED uint64_t length)
+{
+    COPIED int      fd    = (int) (intptr_t) ctx;
+    COPIED uint64_t total = 0;
+
+    /* keep reading until the page is full: /proc and FUSE happily return short */
+    while (total < length)
+    {
+        ssize_t n = pread(fd, dst + total, length - total, (off_t) (offset + total));
+        if (n < 0)
+        {
+            if (EQ(errno, EINTR))
+            {
+                continue;
+            }
+            return total > 0 ? (int64_t) total : -1;
+        }
+        if (EQ(n, 0))
+        {
+            break;
+        }
+        total += (uint64_t) n;
+    }
+    return (int64_t) total;
+}
@@ -0,0 +1,356 @@
+#include "vib_piece.h"
+
+#include <string.h>
+
+#include "memory.h"
+
+#define VIB_PIECE_ADD_INITIAL_CAPACITY  (4096UL)
+
+typedef struct vib_piece_node_t vib_piece_node_t;
+
+struct vib_piece_node_t
+{
+    COPIED vib_piece_source_t   source;
+    COPIED uint64_t             start;
+    COPIED uint64_t             length;
+    COPIED uint64_t             total;      /* bytes in this subtree */
+    COPIED uint64_t             count;      /* pieces in this subtree */
+    COPIED uint32_t             priority;   /* max-heap on priority keeps the treap balanced */
+    OWNED  vib_piece_node_t   * left;
+    OWNED  vib_piece_node_t   * right;
+};
+
+struct vib_piece_table_t
+{
+    OWNED  vib_piece_node_t * root;
+
+    OWNED  uint8_t          * add;
+    COPIED uint64_t           add_length;
+    COPIED uint64_t           add_capacity;
+
+    COPIED uint64_t           seed;
+};
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Forward Declarations
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+static COPIED uint32_t piece_random_(BORROWED vib_piece_table_t * pt);
+static OWNED vib_piece_node_t * mk_piece_node_(BORROWED vib_piece_table_t * pt, COPIED vib_piece_source_t source, COPIED uint64_t start, COPIED uint64_t length);
+static void piece_node_dispose_(OWNED vib_piece_node_t * node);
+static void piece_update_(BORROWED vib_piece_node_t * node);
+static void piece_split_(OWNED vib_piece_node_t * node, COPIED uint64_t offset, BORROWED vib_piece_node_t ** l, BORROWED vib_piece_node_t ** r);
+static OWNED vib_piece_node_t * piece_merge_(OWNED vib_piece_node_t * l, OWNED vib_piece_node_t * r);
+static COPIED bool piece_extend_tail_(BORROWED vib_piece_node_t * node, COPIED uint64_t start, COPIED uint64_t length);
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Nodes
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+/* xorshift64: priorities only need to be unpredictable relative to the edit pattern */
+static COPIED uint32_t piece_random_(BORROWED vib_piece_table_t * pt)
+{
+    pt->seed ^= pt->seed << 13;
+    pt->seed ^= pt->seed >> 7;
+    pt->seed ^= pt->seed << 17;
+    return (uint32_t) (pt->seed >> 32);
+}
+
+static OWNED vib_piece_node_t * mk_piece_node_(BORROWED vib_piece_table_t * pt, COPIED vib_piece_source_t source, COPIED uint64_t start, COPIED uint64_t length)
+{
+    OWNED vib_piece_node_t * node = new(sizeof(vib_piece_node_t));
+    node->source   = source;
+    node->start    = start;
+    node->length   = length;
+    node->total    = length;
+    node->count    = 1;
+    node->priority = piece_random_(pt);
+    node->left     = NIL;
+    node->right    = NIL;
+    return node;
+}
+
+static void piece_node_dispose_(OWNED vib_piece_node_t * node)
+{
+    if (!node)
+    {
+        return;
+    }
+    piece_node_dispose_(node->left);
+    piece_node_dispose_(node->right);
+    dispose(node);
+}
+
+static void piece_update_(BORROWED vib_piece_node_t * node)
+{
+    node->total = node->length;
+    node->count = 1;
+    if (node->left)
+    {
+        node->total += node->left->total;
+        node->count += node->left->count;
+    }
+    if (node->right)
+    {
+        node->total += node->right->total;
+        node->count += node->right->count;
+    }
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Treap Split / Merge
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+/**
+ * Split `node` so that `*l` holds exactly the first `offset` bytes.
+ * A piece straddling `offset` is cut in two; the tail inherits the priority
+ * of its head, which keeps the heap order valid on both sides.
+ */
+static void piece_split_(OWNED vib_piece_node_t * node, COPIED uint64_t offset, BORROWED vib_piece_node_t ** l, BORROWED vib_piece_node_t ** r)
+{
+    if (!node)
+    {
+        *l = NIL;
+        *r = NIL;
+        return;
+    }
+
+    COPIED uint64_t left = node->left ? node->left->total : 0;
+
+    if (offset <= left)
+    {
+        piece_split_(node->left, offset, l, &node->left);
+        piece_update_(node);
+        *r = node;
+    }
+    else if (offset >= left + node->length)
+    {
+        piece_split_(node->right, offset - left - node->length, &node->right, r);
+        piece_update_(node);
+        *l = node;
+    }
+    else
+    {
+        COPIED uint64_t cut = offset - left;
+
+        OWNED vib_piece_node_t * tail = new(sizeof(vib_piece_node_t));
+        tail->source   = node->source;
+        tail->start    = node->start + cut;
+        tail->length   = node->length - cut;
+        tail->priority = node->priority;
+        tail->left     = NIL;
+        tail->right    = node->right;
+
+        node->length = cut;
+        node->right  = NIL;
+
+        piece_update_(tail);
+        piece_update_(node);
+        *l = node;
+        *r = tail;
+    }
+}
+
+static OWNED vib_piece_node_t * piece_merge_(OWNED vib_piece_node_t * l, OWNED vib_piece_node_t * r)
+{
+    if (!l)
+    {
+        return r;
+    }
+    if (!r)
+    {
+        return l;
+    }
+
+    if (l->priority >= r->priority)
+    {
+        l->right = piece_merge_(l->right, r);
+        piece_update_(l);
+        return l;
+    }
+
+    r->left = piece_merge_(l, r->left);
+    piece_update_(r);
+    return r;
+}
+
+/**
+ * Typing appends to the add buffer right after the previous keystroke, so
+ * the last piece before the cursor can usually just grow instead of a new
+ * piece being created. Walks the right spine of `node`.
+ */
+static COPIED bool piece_extend_tail_(BORROWED vib_piece_node_t * node, COPIED uint64_t start, COPIED uint64_t length)
+{
+    if (!node)
+    {
+        return false;
+    }
+
+    BORROWED vib_piece_node_t * last = node;
+    while (last->right)
+    {
+        last = last->right;
+    }
+    if (NEQ(last->source, VIB_PIECE_ADD) || NEQ(last->start + last->length, start))
+    {
+        return false;
+    }
+
+    last->length += length;
+    for (BORROWED vib_piece_node_t * n = node; n; n = n->right)
+    {
+        n->total += length;
+    }
+    return true;
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Lifecycle
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+OWNED vib_piece_table_t * mk_vib_piece_table(COPIED uint64_t original_length)
+{
+    OWNED vib_piece_table_t * pt = zeros(sizeof(vib_piece_table_t));
+    pt->seed         = 0x9E3779B97F4A7C15UL;
+    pt->add_capacity = VIB_PIECE_ADD_INITIAL_CAPACITY;
+    pt->add          = new(pt->add_capacity);
+    pt->add_length   = 0;
+
+    if (original_length > 0)
+    {
+        pt->root = mk_piece_node_(pt, VIB_PIECE_ORIGINAL, 0, original_length);
+    }
+    return pt;
+}
+
+COPIED void * vib_piece_table_dispose(OWNED void * arg)
+{
+    if (!arg)
+    {
+        return NIL;
+    }
+
+    OWNED vib_piece_table_t * pt = CAST(arg, vib_piece_table_t *);
+    piece_node_dispose_(pt->root);
+    free_smart(pt->add);
+    return dispose(pt);
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Queries
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+COPIED vib_piece_loc_t vib_piece_locate(BORROWED vib_piece_table_t * pt, COPIED uint64_t offset)
+{
+    COPIED   vib_piece_loc_t    loc  = { .source = VIB_PIECE_ORIGINAL, .start = 0, .length = 0, .into = 0 };
+    BORROWED vib_piece_node_t * node = pt->root;
+
+    while (node)
+    {
+        COPIED uint64_t left = node->left ? node->left->total : 0;
+        if (offset < left)
+        {
+            node = node->left;
+        }
+        else if (offset < left + node->length)
+        {
+            COPIED uint64_t into = offset - left;
+            loc.source = node->source;
+            loc.start  = node->start + into;
+            loc.length = node->length - into;
+            loc.into   = into;
+            return loc;
+        }
+        else
+        {
+            offset -= left + node->length;
+            node = node->right;
+        }
+    }
+    return loc;
+}
+
+BORROWED const uint8_t * vib_piece_add_data(BORROWED vib_piece_table_t * pt, COPIED uint64_t start)
+{
+    return pt->add + start;
+}
+
+COPIED uint64_t vib_piece_length(BORROWED vib_piece_table_t * pt)
+{
+    return (pt && pt->root) ? pt->root->total : 0;
+}
+
+COPIED uint64_t vib_piece_count(BORROWED vib_piece_table_t * pt)
+{
+    return (pt && pt->root) ? pt->root->count : 0;
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Edits
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+void vib_piece_insert(BORROWED vib_piece_table_t * pt, COPIED uint64_t offset, BORROWED const uint8_t * data, COPIED uint64_t length)
+{
+    if (EQ(length, 0))
+    {
+        return;
+    }
+
+    COPIED uint64_t total = vib_piece_length(pt);
+    ASSERTF(offset <= total, "%s(): offset %lu is past the end (%lu)", __func__, offset, total);
+
+    /* the add buffer only ever grows; pieces refer to it by offset, so moving it is fine */
+    if (pt->add_length + length > pt->add_capacity)
+    {
+        while (pt->add_length + length > pt->add_capacity)
+        {
+            pt->add_capacity *= 2;
+        }
+        pt->add = realloc_smart(pt->add, pt->add_capacity);
+    }
+
+    COPIED uint64_t start = pt->add_length;
+    memcpy(pt->add + start, data, length);
+    pt->add_length += length;
+
+    BORROWED vib_piece_node_t * l = NIL;
+    BORROWED vib_piece_node_t * r = NIL;
+    piece_split_(pt->root, offset, &l, &r);
+
+    if (!piece_extend_tail_(l, start, length))
+    {
+        l = piece_merge_(l, mk_piece_node_(pt, VIB_PIECE_ADD, start, length));
+    }
+    pt->root = piece_merge_(l, r);
+}
+
+void vib_piece_delete(BORROWED vib_piece_table_t * pt, COPIED uint64_t offset, COPIED uint64_t length)
+{
+    COPIED uint64_t total = vib_piece_length(pt);
+    if (offset >= total || EQ(length, 0))
+    {
+        return;
+    }
+    if (length > total - offset)
+    {
+        length = total - offset;
+    }
+
+    BORROWED vib_piece_node_t * l   = NIL;
+    BORROWED vib_piece_node_t * mid = NIL;
+    BORROWED vib_piece_node_t * r   = NIL;
+    piece_split_(pt->root, offset, &l, &mid);
+    piece_split_(mid, length, &mid, &r);
+
+    piece_node_dispose_(mid);
+    pt->root = piece_merge_(l, r);
+}
+
+void vib_piece_append_original(BORROWED vib_piece_table_t * pt, COPIED uint64_t start, COPIED uint64_t length)
+{
+    if (EQ(length, 0))
+    {
+        return;
+    }
+    pt->root = piece_merge_(pt->root, mk_piece_node_(pt, VIB_PIECE_ORIGINAL, start, length));
+}
@@ -0,0 +1,220 @@
+#include "vib_readahead.h"
+
+#include <pthread.h>
+#include <time.h>
+
+#include "memory.h"
+
+struct vib_readahead_t
+{
+    BORROWED vib_readahead_fn * fn;
+    BORROWED void             * ctx;
+    COPIED   pthread_t          worker;
+
+    /* Predictor, touched by the observing thread only */
+    COPIED   bool               seen;
+    COPIED   uint64_t           last_offset;
+    COPIED   uint64_t           last_ns;
+    COPIED   double             velocity;       /* bytes per second, negative when scrolling up */
+    COPIED   uint64_t           posted_start;
+    COPIED   uint64_t           posted_end;
+
+    /* Mailbox, guarded by `lock` */
+    COPIED   pthread_mutex_t    lock;
+    COPIED   pthread_cond_t     wake;
+    COPIED   bool               pending;
+    COPIED   bool               stop;
+    COPIED   uint64_t           start;
+    COPIED   uint64_t           length;
+    COPIED   bool               backward;       /* read the range from its end down */
+};
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Forward Declarations
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+static COPIED uint64_t readahead_now_ns_();
+static void readahead_post_(BORROWED vib_readahead_t * ra, COPIED uint64_t start, COPIED uint64_t end, COPIED bool backward);
+static void * readahead_worker_(BORROWED void * arg);
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Lifecycle
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+OWNED vib_readahead_t * mk_vib_readahead(BORROWED vib_readahead_fn * fn, BORROWED void * ctx)
+{
+    SCP(fn);
+
+    OWNED vib_readahead_t * ra = zeros(sizeof(vib_readahead_t));
+    ra->fn  = fn;
+    ra->ctx = ctx;
+    pthread_mutex_init(&ra->lock, NIL);
+    pthread_cond_init(&ra->wake, NIL);
+
+    if (pthread_create(&ra->worker, NIL, readahead_worker_, ra))
+    {
+        pthread_cond_destroy(&ra->wake);
+        pthread_mutex_destroy(&ra->lock);
+        return dispose(ra);
+    }
+    return ra;
+}
+
+COPIED void * vib_readahead_dispose(OWNED void * arg)
+{
+    if (!arg)
+    {
+        return NIL;
+    }
+
+    OWNED vib_readahead_t * ra = CAST(arg, vib_readahead_t *);
+    pthread_mutex_lock(&ra->lock);
+    ra->stop = true;
+    pthread_cond_signal(&ra->wake);
+    pthread_mutex_unlock(&ra->lock);
+    pthread_join(ra->worker, NIL);
+
+    pthread_cond_destroy(&ra->wake);
+    pthread_mutex_destroy(&ra->lock);
+    return dispose(ra);
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Prediction
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+static COPIED uint64_t readahead_now_ns_()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000UL + (uint64_t) ts.tv_nsec;
+}
+
+void vib_readahead_observe(BORROWED vib_readahead_t * ra, COPIED uint64_t offset, COPIED uint64_t length, COPIED uint64_t end)
+{
+    if (!ra)
+    {
+        return;
+    }
+
+    COPIED uint64_t now   = readahead_now_ns_();
+    COPIED int64_t  delta = (int64_t) (offset - ra->last_offset);
+    COPIED uint64_t dist  = (delta < 0) ? (uint64_t) -delta : (uint64_t) delta;
+
+    if (!ra->seen || dist > VIB_READAHEAD_JUMP_SCREENS * length)
+    {
+        /* a seek says nothing about where the user goes next */
+        ra->velocity = 0.0;
+    }
+    else if (dist > 0)
+    {
+        COPIED uint64_t elapsed = now - ra->last_ns;
+        COPIED double   seconds = (double) ((elapsed > 1000000UL) ? elapsed : 1000000UL) / 1e9;
+
+        /* smooth over single keys so one stray `k` does not flip the direction */
+        ra->velocity = 0.5 * ra->velocity + 0.5 * ((double) delta / seconds);
+    }
+    ra->seen        = true;
+    ra->last_offset = offset;
+    ra->last_ns     = now;
+
+    COPIED uint64_t least = VIB_READAHEAD_MIN_SCREENS * length;
+    if (least < VIB_READAHEAD_MIN_BYTES)
+    {
+        least = VIB_READAHEAD_MIN_BYTES;
+    }
+
+    COPIED double   speed = (ra->velocity < 0) ? -ra->velocity : ra->velocity;
+    COPIED uint64_t ahead = (uint64_t) (speed * VIB_READAHEAD_HORIZON_MS / 1000.0);
+    ahead = (ahead < least) ? least : ahead;
+    ahead = (ahead > VIB_READAHEAD_MAX_BYTES) ? VIB_READAHEAD_MAX_BYTES : ahead;
+
+    COPIED uint64_t start = offset;
+    COPIED uint64_t stop  = offset + length;
+    if (ra->velocity > 0)
+    {
+        stop  = offset + length + ahead;
+    }
+    else if (ra->velocity < 0)
+    {
+        start = (offset > ahead) ? offset - ahead : 0;
+    }
+    else
+    {
+        /* no direction yet: a little on both sides */
+        start = (offset > least) ? offset - least : 0;
+        stop  = offset + length + least;
+    }
+    stop = (stop < end) ? stop : end;
+
+    if (start >= stop || (start >= ra->posted_start && stop <= ra->posted_end))
+    {
+        return;
+    }
+
+    /* ask for twice as much, so the next few moves are already covered */
+    if (ra->velocity > 0)
+    {
+        stop = (stop + ahead < end) ? stop + ahead : end;
+    }
+    else if (ra->velocity < 0)
+    {
+        start = (start > ahead) ? start - ahead : 0;
+    }
+
+    ra->posted_start = start;
+    ra->posted_end   = stop;
+    readahead_post_(ra, start, stop, ra->velocity < 0);
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Worker
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+static void readahead_post_(BORROWED vib_readahead_t * ra, COPIED uint64_t start, COPIED uint64_t end, COPIED bool backward)
+{
+    pthread_mutex_lock(&ra->lock);
+    ra->pending  = true;
+    ra->start    = start;
+    ra->length   = end - start;
+    ra->backward = backward;
+    pthread_cond_signal(&ra->wake);
+    pthread_mutex_unlock(&ra->lock);
+}
+
+static void * readahead_worker_(BORROWED void * arg)
+{
+    BORROWED vib_readahead_t * ra = CAST(arg, vib_readahead_t *);
+
+    pthread_mutex_lock(&ra->lock);
+    for (;;)
+    {
+        while (!ra->pending && !ra->stop)
+        {
+            pthread_cond_wait(&ra->wake, &ra->lock);
+        }
+        if (ra->stop)
+        {
+            break;
+        }
+
+        COPIED uint64_t start    = ra->start;
+        COPIED uint64_t left     = ra->length;
+        COPIED bool     backward = ra->backward;
+        ra->pending = false;
+
+        /* nearest bytes first, in chunks, giving up as soon as a newer range arrives */
+        while (left > 0 && !ra->pending && !ra->stop)
+        {
+            COPIED uint64_t chunk = (left < VIB_READAHEAD_CHUNK) ? left : VIB_READAHEAD_CHUNK;
+            COPIED uint64_t from  = backward ? start + left - chunk : start;
+            pthread_mutex_unlock(&ra->lock);
+            ra->fn(ra->ctx, from, chunk);
+            pthread_mutex_lock(&ra->lock);
+            start += backward ? 0 : chunk;
+            left  -= chunk;
+        }
+    }
+    pthread_mutex_unlock(&ra->lock);
+    return NIL;
+}
@@ -0,0 +1,741 @@
+#define _GNU_SOURCE
+
+#include "vib_save.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+
+#include "memory.h"
+#include "cstr.h"
+#include "vib_piece.h"
+
+#define VIB_SAVE_COPY_CHUNK     (1UL * 1024UL * 1024UL)
+
+/*
+ * Journal layout, native byte order (it never leaves this machine):
+ *     magic[8]  file size  device  inode  entry count
+ *     { offset  length  old bytes[length] } * entry count
+ *     FNV-1a of everything above
+ * A journal whose hash does not match was torn while being written; one
+ * whose file is no longer the same size on the same inode is about a file
+ * that has since been replaced. The mtime cannot tell: the interrupted
+ * patch changed it.
+ */
+#define VIB_SAVE_JOURNAL_MAGIC  "VIBJRNL2"
+#define VIB_SAVE_JOURNAL_HEADER (40UL)
+#define VIB_SAVE_JOURNAL_COUNT  (32UL)      /* offset of the entry count */
+#define VIB_SAVE_FNV_OFFSET     (0xCBF29CE484222325UL)
+#define VIB_SAVE_FNV_PRIME      (0x100000001B3UL)
+
+typedef struct vib_save_job_t vib_save_job_t;
+typedef struct vib_save_journal_t vib_save_journal_t;
+
+struct vib_save_job_t
+{
+    COPIED   int                src;
+    COPIED   int                dst;
+    COPIED   uint64_t           src_size;
+    COPIED   uint64_t           block;      /* reflink granularity */
+    COPIED   bool               clone;      /* false once the filesystem refused a reflink */
+    BORROWED vib_save_stats_t * stats;
+};
+
+struct vib_save_journal_t
+{
+    COPIED int      fd;
+    COPIED uint64_t offset;     /* bytes written so far */
+    COPIED uint64_t hash;       /* of those bytes */
+};
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Forward Declarations
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+static COPIED int save_rewrite_(BORROWED vib_buffer_t * buf, BORROWED const char * target, BORROWED struct stat * st, BORROWED vib_save_stats_t * stats);
+static COPIED int save_assemble_(BORROWED vib_buffer_t * buf, BORROWED vib_save_job_t * job);
+static COPIED int save_sparse_(BORROWED vib_save_job_t * job, COPIED uint64_t src, COPIED uint64_t dst, COPIED uint64_t length);
+static COPIED int save_original_(BORROWED vib_save_job_t * job, COPIED uint64_t src, COPIED uint64_t dst, COPIED uint64_t length);
+static COPIED int save_copy_(BORROWED vib_save_job_t * job, COPIED uint64_t src, COPIED uint64_t dst, COPIED uint64_t length);
+static COPIED int save_readback_(BORROWED vib_save_job_t * job, COPIED uint64_t src, COPIED uint64_t dst, COPIED uint64_t length);
+static COPIED bool save_fits_in_place_(BORROWED vib_buffer_t * buf, COPIED uint64_t file_size, BORROWED uint64_t * dirty);
+static COPIED int save_in_place_(BORROWED vib_buffer_t * buf, BORROWED const char * target, COPIED uint64_t dirty, BORROWED vib_save_stats_t * stats);
+static COPIED int save_journal_(BORROWED vib_buffer_t * buf, COPIED int fd, COPIED int target, COPIED uint64_t dirty);
+static COPIED int save_journal_put_(BORROWED vib_save_journal_t * journal, BORROWED const void * data, COPIED uint64_t length);
+static COPIED uint64_t save_hash_(COPIED uint64_t hash, BORROWED const uint8_t * data, COPIED uint64_t length);
+static COPIED int save_write_(COPIED int fd, BORROWED const uint8_t * data, COPIED uint64_t length, COPIED uint64_t offset);
+static COPIED int save_read_(COPIED int fd, BORROWED uint8_t * data, COPIED uint64_t length, COPIED uint64_t offset);
+static COPIED int save_sync_dir_(BORROWED const char * path);
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Saving
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+COPIED result_t vib_save(BORROWED vib_buffer_t * buf, COPIED vib_save_mode_t mode, BORROWED vib_save_stats_t * stats)
+{
+    COPIED vib_save_stats_t scratch = { 0 };
+    stats = stats ? stats : &scratch;
+    memset(stats, 0, sizeof(*stats));
+
+    if (!buf)
+    {
+        return RESULT_ERR(EINVAL);
+    }
+    if (!buf->pieces)
+    {
+        return RESULT_OK(0);
+    }
+    if (NEQ(buf->kind, VIB_BUFFER_MMAP) && NEQ(buf->kind, VIB_BUFFER_PAGED))
+    {
+        return RESULT_ERR(ENOTSUP);
+    }
+
+    struct stat st;
+    if (-1 == fstat(buf->fd, &st))
+    {
+        return RESULT_ERR(errno);
+    }
+    if (!S_ISREG(st.st_mode))
+    {
+        return RESULT_ERR(ENOTSUP);
+    }
+
+    COPIED uint64_t dirty    = 0;
+    COPIED bool     in_place = save_fits_in_place_(buf, (uint64_t) st.st_size, &dirty);
+    switch (mode)
+    {
+        case VIB_SAVE_AUTO:
+            break;
+
+        case VIB_SAVE_REWRITE:
+        {
+            in_place = false;
+        } break;
+
+        case VIB_SAVE_IN_PLACE:
+        {
+            if (!in_place)
+            {
+                return RESULT_ERR(EINVAL);
+            }
+        } break;
+
+        default:
+            PANIC("%s(): unknown save mode %d", __func__, mode);
+    }
+
+    /* write what a symlink points at, not the link; a temporary file or
+     * journal has to live on the same filesystem as the target */
+    char resolved[PATH_MAX];
+    if (!realpath(buf->path, resolved))
+    {
+        return RESULT_ERR(errno);
+    }
+    OWNED char * target = strdup_smart(resolved);
+
+    int err = in_place ? save_in_place_(buf, target, dirty, stats) : save_rewrite_(buf, target, &st, stats);
+    free_smart(target);
+    if (err)
+    {
+        return RESULT_ERR(err);
+    }
+    return vib_buffer_reload(buf);
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Rewrite And Rename
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+static COPIED int save_rewrite_(BORROWED vib_buffer_t * buf, BORROWED const char * target, BORROWED struct stat * st, BORROWED vib_save_stats_t * stats)
+{
+    OWNED char * temp = mk_cstr(target, ".vib-XXXXXX");
+
+    int dst = mkostemp(temp, O_CLOEXEC);
+    if (-1 == dst)
+    {
+        int err = errno;
+        free_smart(temp);
+        return err;
+    }
+
+    COPIED vib_save_job_t job =
+    {
+        .src      = buf->fd,
+        .dst      = dst,
+        .src_size = (uint64_t) st->st_size,
+        .block    = (st->st_blksize > 0) ? (uint64_t) st->st_blksize : 4096,
+        .clone    = true,
+        .stats    = stats,
+    };
+
+    int err = save_assemble_(buf, &job);
+    if (!err && -1 == ftruncate(dst, (off_t) vib_buffer_size(buf)))
+    {
+        err = errno;
+    }
+    if (!err)
+    {
+        /* keep the original's permissions; ownership only sticks for root */
+        fchmod(dst, st->st_mode & 07777);
+        if (fchown(dst, st->st_uid, st->st_gid)) { /* not ours to give away */ }
+    }
+    if (!err && -1 == fsync(dst))
+    {
+        err = errno;
+    }
+    close(dst);
+
+    if (!err && -1 == rename(temp, target))
+    {
+        err = errno;
+    }
+    if (err)
+    {
+        unlink(temp);
+        free_smart(temp);
+        return err;
+    }
+    free_smart(temp);
+
+    /* the rename itself is only durable once the directory is */
+    return save_sync_dir_(target);
+}
+
+/* Walk the pieces in order: add pieces are written, the data of original pieces moved. */
+static COPIED int save_assemble_(BORROWED vib_buffer_t * buf, BORROWED vib_save_job_t * job)
+{
+    BORROWED vib_piece_table_t * pieces = buf->pieces;
+    COPIED   uint64_t            total  = vib_piece_length(pieces);
+
+    for (uint64_t offset = 0; offset < total; )
+    {
+        COPIED vib_piece_loc_t loc = vib_piece_locate(pieces, offset);
+        if (EQ(loc.length, 0))
+        {
+            return EIO;
+        }
+
+        int err = 0;
+        if (EQ(loc.source, VIB_PIECE_ADD))
+        {
+            err = save_write_(job->dst, vib_piece_add_data(pieces, loc.start), loc.length, offset);
+            job->stats->written += err ? 0 : loc.length;
+        }
+        else
+        {
+            err = save_sparse_(job, loc.start, offset, loc.length);
+        }
+        if (err)
+        {
+            return err;
+        }
+        offset += loc.length;
+    }
+    return 0;
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * In-Place Patching
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+/* Same-length patches only: every original piece still sits at its own offset. */
+static COPIED bool save_fits_in_place_(BORROWED vib_buffer_t * buf, COPIED uint64_t file_size, BORROWED uint64_t * dirty)
+{
+    BORROWED vib_piece_table_t * pieces = buf->pieces;
+    COPIED   uint64_t            total  = vib_piece_length(pieces);
+
+    *dirty = 0;
+    if (NEQ(total, file_size) || NEQ(total, buf->size))
+    {
+        return false;
+    }
+
+    for (uint64_t offset = 0; offset < total; )
+    {
+        COPIED vib_piece_loc_t loc = vib_piece_locate(pieces, offset);
+        if (EQ(loc.source, VIB_PIECE_ADD))
+        {
+            (*dirty)++;
+        }
+        else if (NEQ(loc.start, offset))
+        {
+            return false;
+        }
+        offset += loc.length;
+    }
+    return true;
+}
+
+/*
+ * Journal the old bytes of every dirty range and make the journal durable,
+ * then patch. If patching fails half way the journal is replayed at once,
+ * so the file is either fully patched or as it was.
+ */
+static COPIED int save_in_place_(BORROWED vib_buffer_t * buf, BORROWED const char * target, COPIED uint64_t dirty, BORROWED vib_save_stats_t * stats)
+{
+    /* a target that cannot be written must not leave a journal behind */
+    int out = open(target, O_WRONLY | O_CLOEXEC);
+    if (-1 == out)
+    {
+        return errno;
+    }
+
+    OWNED char * journal = mk_cstr(target, VIB_SAVE_JOURNAL_SUFFIX);
+
+    /* an existing journal is an unrecovered crash; never overwrite it */
+    int jfd = open(journal, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (-1 == jfd)
+    {
+        int err = errno;
+        close(out);
+        free_smart(journal);
+        return err;
+    }
+
+    int err = save_journal_(buf, jfd, out, dirty);
+    close(jfd);
+    err = err ? err : save_sync_dir_(target);
+    if (err)
+    {
+        unlink(journal);
+        close(out);
+        free_smart(journal);
+        return err;
+    }
+
+    BORROWED vib_piece_table_t * pieces = buf->pieces;
+    COPIED   uint64_t            total  = vib_piece_length(pieces);
+    for (uint64_t offset = 0; offset < total && !err; )
+    {
+        COPIED vib_piece_loc_t loc = vib_piece_locate(pieces, offset);
+        if (EQ(loc.source, VIB_PIECE_ADD))
+        {
+            err = save_write_(out, vib_piece_add_data(pieces, loc.start), loc.length, offset);
+            stats->written += err ? 0 : loc.length;
+        }
+        offset += loc.length;
+    }
+    if (!err && -1 == fsync(out))
+    {
+        err = errno;
+    }
+    close(out);
+
+    if (err)
+    {
+        /* on failure to roll back the journal stays for the next start */
+        vib_save_recover(target);
+        free_smart(journal);
+        return err;
+    }
+
+    stats->in_place = true;
+    unlink(journal);
+    free_smart(journal);
+    return save_sync_dir_(target);
+}
+
+static COPIED int save_journal_(BORROWED vib_buffer_t * buf, COPIED int fd, COPIED int target, COPIED uint64_t dirty)
+{
+    struct stat st;
+    if (-1 == fstat(target, &st))
+    {
+        return errno;
+    }
+
+    COPIED vib_save_journal_t journal     = { .fd = fd, .offset = 0, .hash = VIB_SAVE_FNV_OFFSET };
+    COPIED uint64_t           identity[3] = { (uint64_t) st.st_size, (uint64_t) st.st_dev, (uint64_t) st.st_ino };
+
+    int err = save_journal_put_(&journal, VIB_SAVE_JOURNAL_MAGIC, 8);
+    err = err ? err : save_journal_put_(&journal, identity, sizeof(identity));
+    err = err ? err : save_journal_put_(&journal, &dirty, sizeof(dirty));
+
+    OWNED    uint8_t           * chunk  = new(VIB_SAVE_COPY_CHUNK);
+    BORROWED vib_piece_table_t * pieces = buf->pieces;
+    COPIED   uint64_t            total  = vib_piece_length(pieces);
+    for (uint64_t offset = 0; offset < total && !err; )
+    {
+        COPIED vib_piece_loc_t loc = vib_piece_locate(pieces, offset);
+        if (EQ(loc.source, VIB_PIECE_ADD))
+        {
+            err = save_journal_put_(&journal, &offset, sizeof(offset));
+            err = err ? err : save_journal_put_(&journal, &loc.length, sizeof(loc.length));
+            for (uint64_t done = 0; done < loc.length && !err; )
+            {
+                COPIED uint64_t want = loc.length - done;
+                want = (want < VIB_SAVE_COPY_CHUNK) ? want : VIB_SAVE_COPY_CHUNK;
+                err = save_read_(buf->fd, chunk, want, offset + done);
+                err = err ? err : save_journal_put_(&journal, chunk, want);
+                done += want;
+            }
+        }
+        offset += loc.length;
+    }
+    free_smart(chunk);
+
+    COPIED uint64_t hash = journal.hash;
+    err = err ? err : save_journal_put_(&journal, &hash, sizeof(hash));
+    if (!err && -1 == fsync(fd))
+    {
+        err = errno;
+    }
+    return err;
+}
+
+static COPIED int save_journal_put_(BORROWED vib_save_journal_t * journal, BORROWED const void * data, COPIED uint64_t length)
+{
+    journal->hash = save_hash_(journal->hash, data, length);
+    int err = save_write_(journal->fd, data, length, journal->offset);
+    journal->offset += length;
+    return err;
+}
+
+static COPIED uint64_t save_hash_(COPIED uint64_t hash, BORROWED const uint8_t * data, COPIED uint64_t length)
+{
+    for (uint64_t i = 0; i < length; i++)
+    {
+        hash = (hash ^ data[i]) * VIB_SAVE_FNV_PRIME;
+    }
+    return hash;
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Recovery
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+COPIED result_t vib_save_recover(BORROWED const char * path)
+{
+    if (!path)
+    {
+        return RESULT_ERR(EINVAL);
+    }
+
+    char resolved[PATH_MAX];
+    if (!realpath(path, resolved))
+    {
+        return EQ(errno, ENOENT) ? RESULT_OK(false) : RESULT_ERR(errno);
+    }
+    OWNED char * target = strdup_smart(resolved);
+    OWNED char * journal = mk_cstr(target, VIB_SAVE_JOURNAL_SUFFIX);
+
+    int         jfd = open(journal, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (-1 == jfd || -1 == fstat(jfd, &st))
+    {
+        int err = errno;
+        if (-1 != jfd)
+        {
+            close(jfd);
+        }
+        free_smart(journal);
+        free_smart(target);
+        return EQ(err, ENOENT) ? RESULT_OK(false) : RESULT_ERR(err);
+    }
+
+    COPIED uint64_t length = (uint64_t) st.st_size;
+    OWNED  uint8_t * data   = new(length + 1);
+    int             err    = save_read_(jfd, data, length, 0);
+    close(jfd);
+
+    /* validate everything before writing anything */
+    COPIED bool     whole = !err && length >= VIB_SAVE_JOURNAL_HEADER + sizeof(uint64_t)
+                                 && EQ(memcmp(data, VIB_SAVE_JOURNAL_MAGIC, 8), 0);
+    COPIED uint64_t count = 0;
+    if (whole)
+    {
+        COPIED uint64_t hash;
+        memcpy(&hash, data + length - sizeof(hash), sizeof(hash));
+        memcpy(&count, data + VIB_SAVE_JOURNAL_COUNT, sizeof(count));
+        whole = EQ(hash, save_hash_(VIB_SAVE_FNV_OFFSET, data, length - sizeof(hash)));
+    }
+
+    COPIED uint64_t end = length - sizeof(uint64_t);
+    COPIED uint64_t at  = VIB_SAVE_JOURNAL_HEADER;
+    for (uint64_t i = 0; i < count && whole; i++)
+    {
+        COPIED uint64_t entry[2];
+        whole = at + sizeof(entry) <= end;
+        if (whole)
+        {
+            memcpy(entry, data + at, sizeof(entry));
+            whole = entry[1] <= end - at - sizeof(entry);
+            at   += sizeof(entry) + entry[1];
+        }
+    }
+    whole = whole && EQ(at, end);
+
+    /* the old bytes belong to that file only: one rebuilt since is left alone */
+    COPIED bool restored = false;
+    if (whole && count > 0)
+    {
+        int out = open(target, O_WRONLY | O_CLOEXEC);
+        err = (-1 == out) ? errno : 0;
+        if (!err)
+        {
+            COPIED uint64_t identity[3];
+            memcpy(identity, data + 8, sizeof(identity));
+            whole = EQ(fstat(out, &st), 0)
+                 && EQ(identity[0], (uint64_t) st.st_size)
+                 && EQ(identity[1], (uint64_t) st.st_dev)
+                 && EQ(identity[2], (uint64_t) st.st_ino);
+        }
+        at  = VIB_SAVE_JOURNAL_HEADER;
+        for (uint64_t i = 0; i < count && whole && !err; i++)
+        {
+            COPIED uint64_t entry[2];
+            memcpy(entry, data + at, sizeof(entry));
+            err = save_write_(out, data + at + sizeof(entry), entry[1], entry[0]);
+            at += sizeof(entry) + entry[1];
+        }
+        if (whole && !err && -1 == fsync(out))
+        {
+            err = errno;
+        }
+        if (-1 != out)
+        {
+            close(out);
+        }
+        restored = whole && !err;
+    }
+    free_smart(data);
+
+    if (!err || !whole)
+    {
+        unlink(journal);
+        err = save_sync_dir_(target);
+    }
+    free_smart(journal);
+    free_smart(target);
+    return err ? RESULT_ERR(err) : RESULT_OK(restored);
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Moving Original Ranges
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+/*
+ * The target starts empty and is only sized at the end, so whatever is not
+ * written stays a hole. Only the data extents of an original range are
+ * moved; the holes of a sparse image cost nothing, as with reflinks, even
+ * where copy_file_range() would write them out as zeros.
+ */
+static COPIED int save_sparse_(BORROWED vib_save_job_t * job, COPIED uint64_t src, COPIED uint64_t dst, COPIED uint64_t length)
+{
+    COPIED uint64_t end = src + length;
+    while (src < end)
+    {
+        off_t data = lseek(job->src, (off_t) src, SEEK_DATA);
+        if (data < 0)
+        {
+            /* ENXIO: nothing but a hole up to EOF; anything else: no hole map, move it all */
+            if (NEQ(errno, ENXIO))
+            {
+                return save_original_(job, src, dst, end - src);
+            }
+            /* the file got shorter than the piece table remembers */
+            return (end > job->src_size) ? EIO : 0;
+        }
+        if ((uint64_t) data >= end)
+        {
+            return 0;
+        }
+
+        off_t           hole = lseek(job->src, data, SEEK_HOLE);
+        COPIED uint64_t stop = (hole < 0 || (uint64_t) hole > end) ? end : (uint64_t) hole;
+        dst += (uint64_t) data - src;
+        src  = (uint64_t) data;
+
+        int err = save_original_(job, src, dst, stop - src);
+        if (err)
+        {
+            return err;
+        }
+        dst += stop - src;
+        src  = stop;
+    }
+    return 0;
+}
+
+/*
+ * Reflinks share whole filesystem blocks, so they need source and target at
+ * the same offset within a block. When they are, the unaligned head and tail
+ * are copied and the aligned middle is cloned; an insert or delete of a
+ * non-multiple of the block size shifts every later piece out of phase,
+ * and those go through copy_file_range() instead.
+ */
+static COPIED int save_original_(BORROWED vib_save_job_t * job, COPIED uint64_t src, COPIED uint64_t dst, COPIED uint64_t length)
+{
+    if (!job->clone || NEQ(src % job->block, dst % job->block))
+    {
+        return save_copy_(job, src, dst, length);
+    }
+
+    COPIED uint64_t head = (job->block - src % job->block) % job->block;
+    head = (head < length) ? head : length;
+
+    /* an unaligned length is fine when it runs to the end of the source */
+    COPIED uint64_t middle = EQ(src + length, job->src_size) ? length - head : FLOOR_DIV(length - head, job->block);
+    if (EQ(middle, 0))
+    {
+        return save_copy_(job, src, dst, length);
+    }
+
+    int err = save_copy_(job, src, dst, head);
+    if (err)
+    {
+        return err;
+    }
+
+    struct file_clone_range range =
+    {
+        .src_fd      = job->src,
+        .src_offset  = src + head,
+        .src_length  = middle,
+        .dest_offset = dst + head,
+    };
+    if (EQ(ioctl(job->dst, FICLONERANGE, &range), 0))
+    {
+        job->stats->cloned += middle;
+        return save_copy_(job, src + head + middle, dst + head + middle, length - head - middle);
+    }
+
+    /* EINVAL is about this range; anything else means the filesystem cannot */
+    if (NEQ(errno, EINVAL))
+    {
+        job->clone = false;
+    }
+    return save_copy_(job, src + head, dst + head, length - head);
+}
+
+static COPIED int save_copy_(BORROWED vib_save_job_t * job, COPIED uint64_t src, COPIED uint64_t dst, COPIED uint64_t length)
+{
+    while (length > 0)
+    {
+        loff_t  in  = (loff_t) src;
+        loff_t  out = (loff_t) dst;
+        ssize_t n   = copy_file_range(job->src, &in, job->dst, &out, length, 0);
+        if (n > 0)
+        {
+            src    += (uint64_t) n;
+            dst    += (uint64_t) n;
+            length -= (uint64_t) n;
+            job->stats->moved += (uint64_t) n;
+            continue;
+        }
+        if (EQ(n, 0))
+        {
+            /* the file got shorter than the piece table remembers */
+            return EIO;
+        }
+        if (EQ(errno, EINTR))
+        {
+            continue;
+        }
+        if (EQ(errno, EXDEV) || EQ(errno, ENOSYS) || EQ(errno, EOPNOTSUPP) || EQ(errno, EINVAL))
+        {
+            return save_readback_(job, src, dst, length);
+        }
+        return errno;
+    }
+    return 0;
+}
+
+/* Last resort where copy_file_range() is refused: through userspace. */
+static COPIED int save_readback_(BORROWED vib_save_job_t * job, COPIED uint64_t src, COPIED uint64_t dst, COPIED uint64_t length)
+{
+    OWNED uint8_t * chunk = new(VIB_SAVE_COPY_CHUNK);
+    int             err   = 0;
+
+    while (length > 0 && !err)
+    {
+        COPIED uint64_t want = (length < VIB_SAVE_COPY_CHUNK) ? length : VIB_SAVE_COPY_CHUNK;
+        ssize_t n = pread(job->src, chunk, want, (off_t) src);
+        if (n < 0 && EQ(errno, EINTR))
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            err = (n < 0) ? errno : EIO;
+            break;
+        }
+
+        err = save_write_(job->dst, chunk, (uint64_t) n, dst);
+        src    += (uint64_t) n;
+        dst    += (uint64_t) n;
+        length -= (uint64_t) n;
+        job->stats->moved += (uint64_t) n;
+    }
+
+    free_smart(chunk);
+    return err;
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Helpers
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+static COPIED int save_write_(COPIED int fd, BORROWED const uint8_t * data, COPIED uint64_t length, COPIED uint64_t offset)
+{
+    while (length > 0)
+    {
+        ssize_t n = pwrite(fd, data, length, (off_t) offset);
+        if (n < 0)
+        {
+            if (EQ(errno, EINTR))
+            {
+                continue;
+            }
+            return errno;
+        }
+        data   += n;
+        offset += (uint64_t) n;
+        length -= (uint64_t) n;
+    }
+    return 0;
+}
+
+static COPIED int save_read_(COPIED int fd, BORROWED uint8_t * data, COPIED uint64_t length, COPIED uint64_t offset)
+{
+    while (length > 0)
+    {
+        ssize_t n = pread(fd, data, length, (off_t) offset);
+        if (n < 0 && EQ(errno, EINTR))
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return (n < 0) ? errno : EIO;
+        }
+        data   += n;
+        offset += (uint64_t) n;
+        length -= (uint64_t) n;
+    }
+    return 0;
+}
+
+static COPIED int save_sync_dir_(BORROWED const char * path)
+{
+    BORROWED const char * slash = strrchr(path, '/');
+    OWNED    char       * dir   = slash ? mk_cstr_from_u8_buffer((const uint8_t *) path, (uint64_t) (slash - path) + 1) : strdup_smart(".");
+
+    int fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    free_smart(dir);
+    if (-1 == fd)
+    {
+        return errno;
+    }
+
+    int err = fsync(fd) ? errno : 0;
+    close(fd);
+
+    /* some filesystems cannot fsync a directory; the file itself is synced */
+    return (EQ(err, EINVAL) || EQ(err, EROFS)) ? 0 : err;
+}
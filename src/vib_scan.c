@@ -0,0 +1,560 @@
+#define _DEFAULT_SOURCE
+
+#include "vib_scan.h"
+
+#include <errno.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+#include "memory.h"
+#include "vib_huge.h"
+
+typedef struct vib_scan_slot_t vib_scan_slot_t;
+typedef struct vib_scan_ring_t vib_scan_ring_t;
+
+struct vib_scan_slot_t
+{
+    OWNED  uint8_t  * data;
+    COPIED uint64_t   block;        /* block index this slot was last asked to read */
+    COPIED int64_t    result;       /* bytes read, or -errno */
+    COPIED bool       done;
+};
+
+/* The three shared mappings of an io_uring instance. */
+struct vib_scan_ring_t
+{
+    COPIED int                   fd;
+    COPIED bool                  fixed;         /* buffers registered, use READ_FIXED */
+    COPIED uint32_t              queued;        /* SQEs written but not yet submitted */
+    COPIED uint32_t              inflight;      /* submitted, completion not reaped */
+
+    BORROWED uint32_t          * sq_tail;
+    BORROWED uint32_t          * sq_mask;
+    BORROWED uint32_t          * sq_array;
+    BORROWED struct io_uring_sqe * sqes;
+    BORROWED uint32_t          * cq_head;
+    BORROWED uint32_t          * cq_tail;
+    BORROWED uint32_t          * cq_mask;
+    BORROWED struct io_uring_cqe * cqes;
+
+    OWNED  void                * sq_map;
+    COPIED uint64_t              sq_map_size;
+    OWNED  void                * cq_map;        /* == sq_map with IORING_FEAT_SINGLE_MMAP */
+    COPIED uint64_t              cq_map_size;
+    COPIED uint64_t              sqes_size;
+};
+
+struct vib_scan_t
+{
+    COPIED vib_scan_backend_t   backend;
+    COPIED int                  fd;
+    COPIED uint64_t             base;           /* offset of block 0, block aligned */
+    COPIED uint64_t             begin;          /* first byte handed out */
+    COPIED uint64_t             end;            /* one past the last byte, UINT64_MAX if unknown */
+    COPIED uint64_t             blocks;         /* block count, UINT64_MAX if unknown */
+    COPIED uint64_t             next;           /* next block for the consumer */
+    COPIED bool                 held;           /* the consumer still borrows block `next - 1` */
+    COPIED bool                 finished;       /* the consumer saw end of input */
+    COPIED uint64_t             issued;         /* blocks handed to the backend so far */
+    COPIED int                  error;
+
+    COPIED vib_scan_slot_t      slots[VIB_SCAN_DEPTH];
+    OWNED  uint8_t            * arena;          /* huge page region holding every slot, or NIL */
+
+    /* VIB_SCAN_URING */
+    COPIED vib_scan_ring_t      ring;
+
+    /* VIB_SCAN_PREAD, slots and counters below guarded by `lock` */
+    COPIED pthread_t            threads[VIB_SCAN_THREADS];
+    COPIED uint64_t             thread_count;
+    COPIED pthread_mutex_t      lock;
+    COPIED pthread_cond_t       work;           /* a block may be issued, or stop */
+    COPIED pthread_cond_t       landed;         /* a slot finished */
+    COPIED uint64_t             limit;          /* blocks below this may be issued */
+    COPIED uint64_t             eof_block;      /* first block that came back short */
+    COPIED bool                 stop;
+};
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Forward Declarations
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+static COPIED int scan_ring_setup_(BORROWED vib_scan_t * scan);
+static void scan_ring_teardown_(BORROWED vib_scan_t * scan);
+static void scan_ring_queue_(BORROWED vib_scan_t * scan, COPIED uint64_t block);
+static COPIED int scan_ring_enter_(BORROWED vib_scan_t * scan, COPIED uint32_t wait);
+static void scan_ring_reap_(BORROWED vib_scan_t * scan);
+static void scan_ring_refill_(BORROWED vib_scan_t * scan);
+static COPIED int scan_pool_setup_(BORROWED vib_scan_t * scan);
+static void scan_pool_teardown_(BORROWED vib_scan_t * scan);
+static void * scan_pool_worker_(BORROWED void * arg);
+static COPIED int64_t scan_pread_(COPIED int fd, BORROWED uint8_t * dst, COPIED uint64_t offset, COPIED uint64_t length);
+static COPIED uint64_t scan_block_length_(BORROWED vib_scan_t * scan, COPIED uint64_t block);
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Lifecycle
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+OWNED vib_scan_t * mk_vib_scan(COPIED int fd, COPIED uint64_t offset, COPIED uint64_t length, COPIED vib_scan_backend_t backend)
+{
+    OWNED vib_scan_t * scan = zeros(sizeof(vib_scan_t));
+    scan->fd        = fd;
+    scan->base      = FLOOR_DIV(offset, VIB_SCAN_BLOCK_SIZE);
+    scan->begin     = offset;
+    scan->end       = (length > UINT64_MAX - offset) ? UINT64_MAX : offset + length;
+    scan->blocks    = EQ(scan->end, UINT64_MAX) ? UINT64_MAX : CEIL_DIV(scan->end - scan->base, VIB_SCAN_BLOCK_SIZE);
+    scan->eof_block = UINT64_MAX;
+    scan->ring.fd   = -1;
+
+    /* one region for the whole ring: 8 MiB is four huge pages instead of 2048 small ones */
+    scan->arena = vib_huge_enabled() ? vib_huge_alloc(VIB_SCAN_DEPTH * VIB_SCAN_BLOCK_SIZE) : NIL;
+    for (uint64_t i = 0; i < VIB_SCAN_DEPTH; i++)
+    {
+        scan->slots[i].data = scan->arena ? scan->arena + i * VIB_SCAN_BLOCK_SIZE : new_aligned(VIB_SCAN_ALIGN, VIB_SCAN_BLOCK_SIZE);
+    }
+
+    if (NEQ(backend, VIB_SCAN_PREAD) && EQ(scan_ring_setup_(scan), 0))
+    {
+        scan->backend = VIB_SCAN_URING;
+        scan_ring_refill_(scan);
+        return scan;
+    }
+
+    scan->backend = VIB_SCAN_PREAD;
+    if (scan_pool_setup_(scan))
+    {
+        /* not even one thread: the consumer reads every block itself */
+        scan->thread_count = 0;
+    }
+    return scan;
+}
+
+COPIED void * vib_scan_dispose(OWNED void * arg)
+{
+    if (!arg)
+    {
+        return NIL;
+    }
+
+    OWNED vib_scan_t * scan = CAST(arg, vib_scan_t *);
+    switch (scan->backend)
+    {
+        case VIB_SCAN_URING:
+        {
+            scan_ring_teardown_(scan);
+        } break;
+
+        case VIB_SCAN_PREAD:
+        {
+            scan_pool_teardown_(scan);
+        } break;
+
+        default:
+        {
+            PANIC("%s(): unknown scan backend %d", __func__, scan->backend);
+        } break;
+    }
+
+    if (scan->arena)
+    {
+        vib_huge_free(scan->arena, VIB_SCAN_DEPTH * VIB_SCAN_BLOCK_SIZE);
+    }
+    else
+    {
+        for (uint64_t i = 0; i < VIB_SCAN_DEPTH; i++)
+        {
+            free_smart(scan->slots[i].data);
+        }
+    }
+    return dispose(scan);
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Consumer
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+/* Bytes to read for `block`: a full block, less at a known end. */
+static COPIED uint64_t scan_block_length_(BORROWED vib_scan_t * scan, COPIED uint64_t block)
+{
+    COPIED uint64_t offset = scan->base + block * VIB_SCAN_BLOCK_SIZE;
+    if (NEQ(scan->end, UINT64_MAX) && scan->end - offset < VIB_SCAN_BLOCK_SIZE)
+    {
+        /* O_DIRECT wants whole blocks; the read comes back short at EOF anyway */
+        return CEIL_DIV(scan->end - offset, VIB_SCAN_ALIGN) * VIB_SCAN_ALIGN;
+    }
+    return VIB_SCAN_BLOCK_SIZE;
+}
+
+static COPIED int64_t scan_pread_(COPIED int fd, BORROWED uint8_t * dst, COPIED uint64_t offset, COPIED uint64_t length)
+{
+    COPIED uint64_t total = 0;
+    while (total < length)
+    {
+        ssize_t n = pread(fd, dst + total, length - total, (off_t) (offset + total));
+        if (n < 0)
+        {
+            if (EQ(errno, EINTR))
+            {
+                continue;
+            }
+            return (total > 0) ? (int64_t) total : -errno;
+        }
+        if (EQ(n, 0))
+        {
+            break;
+        }
+        total += (uint64_t) n;
+    }
+    return (int64_t) total;
+}
+
+COPIED vib_span_t vib_scan_next(BORROWED vib_scan_t * scan)
+{
+    COPIED vib_span_t span = { .data = NIL, .length = 0 };
+    if (!scan)
+    {
+        return span;
+    }
+
+    /* the previous block is returned: its slot can read ahead again */
+    if (scan->held)
+    {
+        scan->held = false;
+        if (scan->finished)
+        {
+            /* nothing more to read ahead */
+        }
+        else if (EQ(scan->backend, VIB_SCAN_URING))
+        {
+            scan_ring_refill_(scan);
+        }
+        else
+        {
+            pthread_mutex_lock(&scan->lock);
+            scan->slots[(scan->next - 1) % VIB_SCAN_DEPTH].done = false;
+            scan->limit++;
+            pthread_cond_signal(&scan->work);
+            pthread_mutex_unlock(&scan->lock);
+        }
+    }
+
+    if (scan->error || scan->finished || scan->next >= scan->blocks)
+    {
+        return span;
+    }
+
+    COPIED uint64_t            block  = scan->next;
+    BORROWED vib_scan_slot_t * slot = &scan->slots[block % VIB_SCAN_DEPTH];
+    COPIED uint64_t            offset = scan->base + block * VIB_SCAN_BLOCK_SIZE;
+    COPIED uint64_t            want   = scan_block_length_(scan, block);
+
+    if (EQ(scan->backend, VIB_SCAN_URING))
+    {
+        while (!slot->done)
+        {
+            /* a signal (SIGWINCH) interrupts the wait, not the reads */
+            if (scan_ring_enter_(scan, 1) < 0 && NEQ(errno, EINTR))
+            {
+                scan->error = errno;
+                return span;
+            }
+            scan_ring_reap_(scan);
+        }
+    }
+    else if (EQ(scan->thread_count, 0))
+    {
+        slot->result = scan_pread_(scan->fd, slot->data, offset, want);
+        slot->done   = true;
+    }
+    else
+    {
+        pthread_mutex_lock(&scan->lock);
+        while (!slot->done || NEQ(slot->block, block))
+        {
+            pthread_cond_wait(&scan->landed, &scan->lock);
+        }
+        pthread_mutex_unlock(&scan->lock);
+    }
+
+    COPIED int64_t n = slot->result;
+    if (n < 0)
+    {
+        scan->error = (int) -n;
+        return span;
+    }
+
+    /* io_uring may stop short of EOF; finish the block the slow way */
+    if ((uint64_t) n < want)
+    {
+        COPIED int64_t rest = scan_pread_(scan->fd, slot->data + n, offset + (uint64_t) n, want - (uint64_t) n);
+        n += (rest > 0) ? rest : 0;
+    }
+    if ((uint64_t) n < want || offset + (uint64_t) n >= scan->end)
+    {
+        /* end of input or of the range: nothing after this block */
+        scan->finished = true;
+    }
+
+    COPIED uint64_t from = (offset < scan->begin) ? scan->begin - offset : 0;
+    COPIED uint64_t to   = scan->end - offset;
+    to = (to < (uint64_t) n) ? to : (uint64_t) n;
+
+    scan->next++;
+    scan->held  = true;
+    span.data   = slot->data + from;
+    span.length = (to > from) ? to - from : 0;
+    return span;
+}
+
+COPIED vib_scan_backend_t vib_scan_backend(BORROWED vib_scan_t * scan)
+{
+    return scan ? scan->backend : VIB_SCAN_AUTO;
+}
+
+COPIED int vib_scan_error(BORROWED vib_scan_t * scan)
+{
+    return scan ? scan->error : EINVAL;
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * io_uring Backend
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+static COPIED int scan_ring_setup_(BORROWED vib_scan_t * scan)
+{
+    BORROWED vib_scan_ring_t * ring = &scan->ring;
+    struct io_uring_params     p;
+    memset(&p, 0, sizeof(p));
+
+    ring->fd = (int) syscall(__NR_io_uring_setup, (unsigned) VIB_SCAN_DEPTH, &p);
+    if (ring->fd < 0)
+    {
+        return errno;
+    }
+
+    ring->sq_map_size = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+    ring->cq_map_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size   = p.sq_entries * sizeof(struct io_uring_sqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        ring->sq_map_size = (ring->sq_map_size > ring->cq_map_size) ? ring->sq_map_size : ring->cq_map_size;
+        ring->cq_map_size = ring->sq_map_size;
+    }
+
+    ring->sq_map = mmap(NIL, ring->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    ring->cq_map = (p.features & IORING_FEAT_SINGLE_MMAP)
+                 ? ring->sq_map
+                 : mmap(NIL, ring->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    ring->sqes   = mmap(NIL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (MAP_FAILED == ring->sq_map || MAP_FAILED == ring->cq_map || MAP_FAILED == ring->sqes)
+    {
+        int err = errno;
+        scan_ring_teardown_(scan);
+        return err;
+    }
+
+    BORROWED uint8_t * sq = ring->sq_map;
+    BORROWED uint8_t * cq = ring->cq_map;
+    ring->sq_tail  = CAST(sq + p.sq_off.tail, uint32_t *);
+    ring->sq_mask  = CAST(sq + p.sq_off.ring_mask, uint32_t *);
+    ring->sq_array = CAST(sq + p.sq_off.array, uint32_t *);
+    ring->cq_head  = CAST(cq + p.cq_off.head, uint32_t *);
+    ring->cq_tail  = CAST(cq + p.cq_off.tail, uint32_t *);
+    ring->cq_mask  = CAST(cq + p.cq_off.ring_mask, uint32_t *);
+    ring->cqes     = CAST(cq + p.cq_off.cqes, struct io_uring_cqe *);
+
+    /* fixed buffers skip the per-read page pinning; RLIMIT_MEMLOCK may refuse them */
+    struct iovec iov[VIB_SCAN_DEPTH];
+    for (uint64_t i = 0; i < VIB_SCAN_DEPTH; i++)
+    {
+        iov[i].iov_base = scan->slots[i].data;
+        iov[i].iov_len  = VIB_SCAN_BLOCK_SIZE;
+    }
+    ring->fixed = EQ(syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_BUFFERS, iov, (unsigned) VIB_SCAN_DEPTH), 0);
+    return 0;
+}
+
+static void scan_ring_teardown_(BORROWED vib_scan_t * scan)
+{
+    BORROWED vib_scan_ring_t * ring = &scan->ring;
+
+    /* the kernel may still be writing into our buffers */
+    while (ring->inflight > 0 || ring->queued > 0)
+    {
+        if (scan_ring_enter_(scan, 1) < 0 && NEQ(errno, EINTR))
+        {
+            break;
+        }
+        scan_ring_reap_(scan);
+    }
+
+    if (ring->sqes && MAP_FAILED != ring->sqes)
+    {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_map && MAP_FAILED != ring->cq_map && NEQ(ring->cq_map, ring->sq_map))
+    {
+        munmap(ring->cq_map, ring->cq_map_size);
+    }
+    if (ring->sq_map && MAP_FAILED != ring->sq_map)
+    {
+        munmap(ring->sq_map, ring->sq_map_size);
+    }
+    if (ring->fd >= 0)
+    {
+        close(ring->fd);
+    }
+    ring->fd = -1;
+}
+
+/* Write one SQE; it reaches the kernel with the next enter. */
+static void scan_ring_queue_(BORROWED vib_scan_t * scan, COPIED uint64_t block)
+{
+    BORROWED vib_scan_ring_t   * ring = &scan->ring;
+    COPIED   uint64_t            slot = block % VIB_SCAN_DEPTH;
+    COPIED   uint32_t            tail = *ring->sq_tail;
+    COPIED   uint32_t            idx  = tail & *ring->sq_mask;
+    BORROWED struct io_uring_sqe * sqe = &ring->sqes[idx];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode    = ring->fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    sqe->fd        = scan->fd;
+    sqe->addr      = (uint64_t) (uintptr_t) scan->slots[slot].data;
+    sqe->len       = (uint32_t) scan_block_length_(scan, block);
+    sqe->off       = scan->base + block * VIB_SCAN_BLOCK_SIZE;
+    sqe->buf_index = (uint16_t) slot;
+    sqe->user_data = slot;
+
+    scan->slots[slot].block = block;
+    scan->slots[slot].done  = false;
+    ring->sq_array[idx] = idx;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ring->queued++;
+}
+
+/* Submit everything queued and optionally wait for `wait` completions. */
+static COPIED int scan_ring_enter_(BORROWED vib_scan_t * scan, COPIED uint32_t wait)
+{
+    BORROWED vib_scan_ring_t * ring = &scan->ring;
+    COPIED   uint32_t          flags = (wait > 0) ? IORING_ENTER_GETEVENTS : 0;
+
+    long n = syscall(__NR_io_uring_enter, ring->fd, ring->queued, wait, flags, NIL, 0);
+    if (n < 0)
+    {
+        return -1;
+    }
+    ring->queued   -= (uint32_t) n;
+    ring->inflight += (uint32_t) n;
+    return 0;
+}
+
+static void scan_ring_reap_(BORROWED vib_scan_t * scan)
+{
+    BORROWED vib_scan_ring_t * ring = &scan->ring;
+    COPIED   uint32_t          head = *ring->cq_head;
+    COPIED   uint32_t          tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+
+    for (; NEQ(head, tail); head++)
+    {
+        BORROWED struct io_uring_cqe * cqe  = &ring->cqes[head & *ring->cq_mask];
+        BORROWED vib_scan_slot_t     * slot = &scan->slots[cqe->user_data];
+        slot->result = cqe->res;
+        slot->done   = true;
+        ring->inflight--;
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+}
+
+/* Keep VIB_SCAN_DEPTH blocks issued; submit in batches to save syscalls. */
+static void scan_ring_refill_(BORROWED vib_scan_t * scan)
+{
+    while (scan->issued < scan->blocks && scan->issued < scan->next + VIB_SCAN_DEPTH)
+    {
+        scan_ring_queue_(scan, scan->issued++);
+    }
+    if (scan->ring.queued >= VIB_SCAN_BATCH)
+    {
+        scan_ring_enter_(scan, 0);
+    }
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * pread Pool Backend
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+static COPIED int scan_pool_setup_(BORROWED vib_scan_t * scan)
+{
+    pthread_mutex_init(&scan->lock, NIL);
+    pthread_cond_init(&scan->work, NIL);
+    pthread_cond_init(&scan->landed, NIL);
+    scan->limit = VIB_SCAN_DEPTH;
+
+    for (uint64_t i = 0; i < VIB_SCAN_THREADS; i++)
+    {
+        if (pthread_create(&scan->threads[i], NIL, scan_pool_worker_, scan))
+        {
+            break;
+        }
+        scan->thread_count++;
+    }
+    return scan->thread_count ? 0 : EAGAIN;
+}
+
+static void scan_pool_teardown_(BORROWED vib_scan_t * scan)
+{
+    pthread_mutex_lock(&scan->lock);
+    scan->stop = true;
+    pthread_cond_broadcast(&scan->work);
+    pthread_mutex_unlock(&scan->lock);
+
+    for (uint64_t i = 0; i < scan->thread_count; i++)
+    {
+        pthread_join(scan->threads[i], NIL);
+    }
+    pthread_cond_destroy(&scan->landed);
+    pthread_cond_destroy(&scan->work);
+    pthread_mutex_destroy(&scan->lock);
+}
+
+static void * scan_pool_worker_(BORROWED void * arg)
+{
+    BORROWED vib_scan_t * scan = CAST(arg, vib_scan_t *);
+
+    pthread_mutex_lock(&scan->lock);
+    for (;;)
+    {
+        /* blocks past the first short one would only read EOF again */
+        while (!scan->stop && (scan->issued >= scan->limit || scan->issued >= scan->blocks || scan->issued > scan->eof_block))
+        {
+            pthread_cond_wait(&scan->work, &scan->lock);
+        }
+        if (scan->stop)
+        {
+            break;
+        }
+
+        COPIED   uint64_t          block = scan->issued++;
+        BORROWED vib_scan_slot_t * slot  = &scan->slots[block % VIB_SCAN_DEPTH];
+        COPIED   uint64_t          want  = scan_block_length_(scan, block);
+        pthread_mutex_unlock(&scan->lock);
+
+        COPIED int64_t n = scan_pread_(scan->fd, slot->data, scan->base + block * VIB_SCAN_BLOCK_SIZE, want);
+
+        pthread_mutex_lock(&scan->lock);
+        slot->block  = block;
+        slot->result = n;
+        slot->done   = true;
+        if ((n < 0 || (uint64_t) n < want) && block < scan->eof_block)
+        {
+            scan->eof_block = block;
+        }
+        pthread_cond_broadcast(&scan->landed);
+    }
+    pthread_mutex_unlock(&scan->lock);
+    return NIL;
+}
@@ -0,0 +1,139 @@
+#include "vib_stream.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "memory.h"
+
+#define VIB_STREAM_INITIAL_SEGMENTS (16UL)
+
+struct vib_stream_t
+{
+    COPIED int          fd;
+    OWNED  uint8_t   ** segments;
+    COPIED uint64_t     count;          /* segments allocated */
+    COPIED uint64_t     capacity;       /* slots in `segments` */
+    COPIED uint64_t     length;         /* bytes stored */
+    COPIED bool         eof;
+};
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Lifecycle
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+OWNED vib_stream_t * mk_vib_stream(COPIED int fd)
+{
+    OWNED vib_stream_t * stream = zeros(sizeof(vib_stream_t));
+    stream->fd       = fd;
+    stream->capacity = VIB_STREAM_INITIAL_SEGMENTS;
+    stream->segments = zeros(stream->capacity * sizeof(uint8_t *));
+
+    COPIED int flags = fcntl(fd, F_GETFL);
+    if (flags >= 0)
+    {
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    }
+    return stream;
+}
+
+COPIED void * vib_stream_dispose(OWNED void * arg)
+{
+    if (!arg)
+    {
+        return NIL;
+    }
+
+    OWNED vib_stream_t * stream = CAST(arg, vib_stream_t *);
+    for (uint64_t i = 0; i < stream->count; i++)
+    {
+        free_smart(stream->segments[i]);
+    }
+    free_smart(stream->segments);
+    return dispose(stream);
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Reading
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+COPIED uint64_t vib_stream_pump(BORROWED vib_stream_t * stream)
+{
+    COPIED uint64_t appended = 0;
+
+    while (!stream->eof && appended < VIB_STREAM_PUMP_BUDGET)
+    {
+        COPIED uint64_t used = stream->length % VIB_STREAM_SEGMENT_SIZE;
+
+        /* the tail segment is full (or there is none yet): start a new one */
+        if (EQ(used, 0) && EQ(stream->length / VIB_STREAM_SEGMENT_SIZE, stream->count))
+        {
+            if (EQ(stream->count, stream->capacity))
+            {
+                stream->capacity *= 2;
+                stream->segments  = realloc_smart(stream->segments, stream->capacity * sizeof(uint8_t *));
+            }
+            stream->segments[stream->count++] = new(VIB_STREAM_SEGMENT_SIZE);
+        }
+
+        BORROWED uint8_t * tail = stream->segments[stream->count - 1];
+        ssize_t n = read(stream->fd, tail + used, VIB_STREAM_SEGMENT_SIZE - used);
+        if (n > 0)
+        {
+            stream->length += (uint64_t) n;
+            appended       += (uint64_t) n;
+            continue;
+        }
+        if (EQ(n, 0))
+        {
+            stream->eof = true;
+            break;
+        }
+        if (EQ(errno, EINTR))
+        {
+            continue;
+        }
+        if (NEQ(errno, EAGAIN) && NEQ(errno, EWOULDBLOCK))
+        {
+            stream->eof = true;
+        }
+        break;
+    }
+
+    return appended;
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Access
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+COPIED vib_span_t vib_stream_span(BORROWED vib_stream_t * stream, COPIED uint64_t offset, COPIED uint64_t length)
+{
+    COPIED vib_span_t span = { .data = NIL, .length = 0 };
+    if (!stream || offset >= stream->length)
+    {
+        return span;
+    }
+
+    COPIED uint64_t segment = offset / VIB_STREAM_SEGMENT_SIZE;
+    COPIED uint64_t start   = offset % VIB_STREAM_SEGMENT_SIZE;
+    COPIED uint64_t avail   = VIB_STREAM_SEGMENT_SIZE - start;
+    if (avail > stream->length - offset)
+    {
+        avail = stream->length - offset;
+    }
+
+    span.data   = stream->segments[segment] + start;
+    span.length = (length < avail) ? length : avail;
+    return span;
+}
+
+COPIED uint64_t vib_stream_length(BORROWED vib_stream_t * stream)
+{
+    return stream ? stream->length : 0;
+}
+
+COPIED bool vib_stream_eof(BORROWED vib_stream_t * stream)
+{
+    return !stream || stream->eof;
+}
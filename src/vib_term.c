@@ -1,18 +1,42 @@
 #include "vib_term.h"
 
 #include <stdio.h>
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <termios.h>
 #include <signal.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 
 #include "common.h"
+#include "memory.h"
+#include "cstr.h"
+#include "vib_paths.h"
 
 #define VIB_TERMINAL_DEFAULT_ROWS    (24UL)
 #define VIB_TERMINAL_DEFAULT_COLUMNS (80UL)
 
+#define VIB_TERMINAL_CHUNK_SIZE (16UL * 1024UL)    /* output buffer granule */
+#define VIB_TERMINAL_IOV_BATCH  (64UL)              /* chunks per writev(), well under IOV_MAX */
+#define VIB_TERMINAL_LINE_SIZE  (512UL)             /* vib_terminal_writef() stack buffer */
+
+#define VIB_TERMINAL_PROBE_MS   (200)               /* longest wait for the probe replies */
+#define VIB_TERMINAL_PROBE_SIZE (256UL)             /* reply bytes kept; DA1 lists a dozen numbers at most */
+#define VIB_TERMINAL_PENDING    (64UL)              /* keys typed while the probe waited */
+#define VIB_TERMINAL_CAPS_MAGIC "VIBCAPS1"
+
+#define VIB_TERMINAL_RESIZE_MS  (16)                /* at most one relayout per frame interval while a window is dragged */
+
+#define VIB_SCREEN_GAP          (8UL)       /* unchanged cells cheaper to resend than to jump over */
+#define VIB_SCREEN_LINE_SIZE    (1024UL)    /* vib_screen_printf() formatting limit */
+#define VIB_SCREEN_UNKNOWN      (UINT64_MAX)
+#define VIB_SCREEN_SCROLL_GAIN  (2UL)       /* rows a shift must save over a plain diff to be worth a scroll */
+
 /* ─────────────────────────────────────────────────────────────────────────────
  * ANSI Escape Sequences
  * ───────────────────────────────────────────────────────────────────────────── */
@@ -29,6 +53,18 @@
 #define VIB_CURSOR_LOCATION     (CSI "%lu;%luH")    // move cursor to (row, column)
 
 #define VIB_TERMINAL_CLR        (CSI "2J")          // clear the entire terminal screen
+#define VIB_TERMINAL_ERASE_LINE (CSI "K")           // clear from the cursor to the end of the line
+#define VIB_TERMINAL_RESET_PEN  (CSI "0m")          // default colors, no attributes
+
+#define VIB_QUERY_SYNC          (CSI "?2026$p")     // DECRQM: is synchronized output (mode 2026) known?
+#define VIB_QUERY_DA1           (CSI "c")           // primary device attributes; every terminal answers
+#define VIB_SYNC_BEGIN          (CSI "?2026h")      // hold painting until the matching end
+#define VIB_SYNC_END            (CSI "?2026l")
+
+#define VIB_SCROLL_REGION       (CSI "%lu;%lur")    // DECSTBM: scroll only rows top..bottom (1-indexed); homes the cursor
+#define VIB_SCROLL_RESET        (CSI "r")           // scroll region back to the whole screen; homes the cursor
+#define VIB_INDEX               (ESC "D")           // IND: down a row, scrolling the region up at its bottom
+#define VIB_REVERSE_INDEX       (ESC "M")           // RI: up a row, scrolling the region down at its top
 
 /* ─────────────────────────────────────────────────────────────────────────────
  * Module State
@@ -36,19 +72,70 @@
 
 static struct {
     COPIED struct termios original;         /* Original terminal attributes */
+    COPIED int input;                       /* Keyboard: stdin, or /dev/tty when stdin carries data */
     COPIED uint64_t rows;                   /* Terminal rows */
     COPIED uint64_t columns;                /* Terminal columns */
     COPIED bool raw;                        /* True if raw mode is active */
     COPIED bool alt;                        /* True if alternate buffer is active */
-    COPIED volatile sig_atomic_t resized;   /* Resize flag (signal-safe) */
+    COPIED int resize_pipe[2];              /* SIGWINCH writes a byte; the read end wakes poll() */
+    COPIED bool resize_pending;             /* Drained from the pipe, not yet applied */
+    COPIED struct timespec resize_applied;  /* When the last relayout was handed out */
+    COPIED uint64_t frame_ns;               /* Shortest time between presented frames, 0 for none */
+    COPIED struct timespec frame_presented; /* When vib_screen_present() last ran */
+
+    /* Capabilities, from the probe or the cache */
+    COPIED bool sync;                       /* Frames are wrapped in synchronized output */
+
+    /* Bytes that reached the probe but belong to the key reader */
+    COPIED uint8_t pending[VIB_TERMINAL_PENDING];
+    COPIED uint64_t pending_head;
+    COPIED uint64_t pending_count;
 } _terminal_state = {
+    .input   = STDIN_FILENO,
     .rows    = VIB_TERMINAL_DEFAULT_ROWS,
     .columns = VIB_TERMINAL_DEFAULT_COLUMNS,
     .raw     = false,
     .alt     = false,
-    .resized = 0,
+    .resize_pipe = { -1, -1 },
+    .frame_ns    = 1000000000UL / VIB_TERMINAL_DEFAULT_FPS,
 };
 
+static struct {
+    OWNED  vib_cell_t * front;              /* What the terminal shows */
+    OWNED  vib_cell_t * back;               /* The frame being composed */
+    OWNED  uint64_t * front_hash;           /* Per row, to spot rows that moved */
+    OWNED  uint64_t * back_hash;
+    COPIED uint64_t blank_hash;             /* Hash of a blank row at this width */
+    COPIED uint64_t rows;
+    COPIED uint64_t columns;
+    COPIED bool valid;                      /* False until the terminal is known to match `front` */
+
+    /* Terminal state as left by the last frame */
+    COPIED crayon_pen_t pen;                /* Colors and attributes in effect */
+    COPIED uint64_t cursor_row;             /* VIB_SCREEN_UNKNOWN after a wrap or a foreign write */
+    COPIED uint64_t cursor_column;
+
+} _screen_state = {
+    .cursor_row    = VIB_SCREEN_UNKNOWN,
+    .cursor_column = VIB_SCREEN_UNKNOWN,
+};
+
+/*
+ * The first chunk is static so that the exit path, which may run in a signal
+ * handler, can still write without allocating.
+ */
+static struct {
+    COPIED char first[VIB_TERMINAL_CHUNK_SIZE];
+    OWNED  char ** extra;                   /* Chunks 1.. from the heap, kept across frames */
+    COPIED uint64_t allocated;              /* Entries of `extra` holding a chunk */
+    COPIED uint64_t slots;                  /* Capacity of `extra` */
+    COPIED uint64_t current;                /* Chunk being appended to */
+    COPIED uint64_t tail;                   /* Bytes used in the current chunk */
+    COPIED uint64_t depth;                  /* Open frames */
+} _output_state;
+
+static const vib_cell_t VIB_SCREEN_BLANK = { .glyph = ' ', .fg = VIB_COLOR_DEFAULT, .bg = VIB_COLOR_DEFAULT, .attrs = 0 };
+
 /* ─────────────────────────────────────────────────────────────────────────────
  * Forward Declarations
  * ───────────────────────────────────────────────────────────────────────────── */
@@ -59,6 +146,25 @@ static void terminal_setup_raw_mode_signals_();
 static void terminal_sig_default_handler_(int sig);
 static void terminal_sig_winch_handler_(int sig);
 static void terminal_size_query_();
+static COPIED int64_t terminal_resize_wait_();
+static void terminal_probe_();
+static COPIED bool terminal_probe_parse_(BORROWED const uint8_t * reply, COPIED uint64_t length, COPIED bool final);
+static OWNED char * terminal_caps_path_(COPIED bool create);
+static COPIED bool terminal_caps_load_();
+static void terminal_caps_save_();
+static BORROWED char * terminal_chunk_(COPIED uint64_t index);
+static void terminal_output_flush_();
+static void terminal_output_reset_();
+static void screen_resize_(COPIED uint64_t rows, COPIED uint64_t columns);
+static void screen_fill_(BORROWED vib_cell_t * cells, COPIED uint64_t count);
+static void screen_emit_glyph_(COPIED uint32_t glyph);
+static void screen_emit_pen_(BORROWED const vib_cell_t * cell);
+static void screen_move_(COPIED uint64_t row, COPIED uint64_t column);
+static void screen_present_row_(COPIED uint64_t row);
+static COPIED uint64_t screen_hash_row_(BORROWED const vib_cell_t * cells);
+static COPIED int64_t screen_find_shift_(BORROWED uint64_t * first, BORROWED uint64_t * last);
+static void screen_scroll_(COPIED int64_t shift, COPIED uint64_t first, COPIED uint64_t last);
+static COPIED uint32_t screen_decode_(BORROWED const char ** text);
 
 /* ─────────────────────────────────────────────────────────────────────────────
  * Lifecycle
@@ -71,21 +177,38 @@ COPIED result_t vib_terminal_init()
         return RESULT_OK(1);
     }
 
-    /* must be a terminal */
+    /* keys come from the controlling terminal when stdin is piped data */
     if (0 == isatty(STDIN_FILENO))
     {
-        return RESULT_ERR(1);
+        int tty = open("/dev/tty", O_RDWR | O_CLOEXEC);
+        if (-1 == tty)
+        {
+            return RESULT_ERR(1);
+        }
+        _terminal_state.input = tty;
     }
 
     /* save original terminal attributes */
-    if (-1 == tcgetattr(STDIN_FILENO, &_terminal_state.original))
+    if (-1 == tcgetattr(_terminal_state.input, &_terminal_state.original))
     {
         return RESULT_ERR(2);
     }
 
+    /* a byte per SIGWINCH; a full pipe already means "resized", so writes never block */
+    if (-1 == pipe(_terminal_state.resize_pipe))
+    {
+        return RESULT_ERR(3);
+    }
+    for (int i = 0; i < 2; i++)
+    {
+        fcntl(_terminal_state.resize_pipe[i], F_SETFD, FD_CLOEXEC);
+        fcntl(_terminal_state.resize_pipe[i], F_SETFL, O_NONBLOCK);
+    }
+
     terminal_enter_raw_mode_();
     terminal_setup_raw_mode_signals_();
     terminal_size_query_();
+    terminal_probe_();
     vib_tui_use_alternate_buffer();
 
     atexit(vib_terminal_quit);
@@ -100,10 +223,12 @@ void vib_terminal_quit()
         return;
     }
 
+    vib_terminal_begin_frame();
     vib_terminal_cursor_show();
     vib_terminal_clear();
     vib_terminal_cursor_home();
     vib_tui_use_normal_buffer();
+    vib_terminal_end_frame();
 
     terminal_leave_raw_mode_();
 }
@@ -160,7 +285,7 @@ static void terminal_enter_raw_mode_()
     term.c_cc[VMIN] = 1;
     term.c_cc[VTIME] = 0;
 
-    tcsetattr(STDIN_FILENO, TCSAFLUSH, &term);
+    tcsetattr(_terminal_state.input, TCSAFLUSH, &term);
     _terminal_state.raw = true;
 }
 
@@ -170,7 +295,7 @@ static void terminal_leave_raw_mode_()
     {
         return;
     }
-    tcsetattr(STDIN_FILENO, TCSAFLUSH, &_terminal_state.original);
+    tcsetattr(_terminal_state.input, TCSAFLUSH, &_terminal_state.original);
     _terminal_state.raw = false;
 }
 
@@ -198,6 +323,8 @@ static void terminal_setup_raw_mode_signals_()
 static void terminal_sig_default_handler_(int sig)
 {
     (void) sig;
+    /* drop any half-built frame; the restore sequence fits the static chunk */
+    terminal_output_reset_();
     vib_terminal_quit();
     _exit(128 + sig);
 }
@@ -205,7 +332,11 @@ static void terminal_sig_default_handler_(int sig)
 static void terminal_sig_winch_handler_(int sig)
 {
     (void) sig;
-    _terminal_state.resized = 1;
+    int saved = errno;
+    COPIED char byte = 0;
+    COPIED ssize_t unused = write(_terminal_state.resize_pipe[1], &byte, 1);
+    (void) unused;
+    errno = saved;
 }
 
 /* ─────────────────────────────────────────────────────────────────────────────
@@ -220,6 +351,15 @@ static void terminal_size_query_()
         _terminal_state.rows    = ws.ws_row;
         _terminal_state.columns = ws.ws_col;
     }
+    if (_terminal_state.raw)
+    {
+        screen_resize_(_terminal_state.rows, _terminal_state.columns);
+    }
+}
+
+COPIED int vib_terminal_input_fd()
+{
+    return _terminal_state.input;
 }
 
 COPIED uint64_t vib_terminal_get_rows()
@@ -237,15 +377,395 @@ void vib_terminal_size_update()
     terminal_size_query_();
 }
 
+COPIED int vib_terminal_resize_fd()
+{
+    return _terminal_state.resize_pipe[0];
+}
+
+/* Milliseconds until a pending resize may be applied, 0 if now. */
+static COPIED int64_t terminal_resize_wait_()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    COPIED int64_t elapsed = (int64_t) (now.tv_sec - _terminal_state.resize_applied.tv_sec) * 1000
+                           + (now.tv_nsec - _terminal_state.resize_applied.tv_nsec) / 1000000;
+    return (elapsed >= VIB_TERMINAL_RESIZE_MS) ? 0 : VIB_TERMINAL_RESIZE_MS - elapsed;
+}
+
 COPIED bool vib_terminal_was_resized(void)
 {
-    if (_terminal_state.resized)
+    char    drain[64];
+    ssize_t n;
+    while ((n = read(_terminal_state.resize_pipe[0], drain, sizeof(drain))) > 0 || (n < 0 && EQ(errno, EINTR)))
+    {
+        _terminal_state.resize_pending |= (n > 0);
+    }
+
+    /* a drag sends a storm of SIGWINCH: the size is read once per interval, after the latest one */
+    if (!_terminal_state.resize_pending || terminal_resize_wait_() > 0)
+    {
+        return false;
+    }
+    _terminal_state.resize_pending = false;
+    clock_gettime(CLOCK_MONOTONIC, &_terminal_state.resize_applied);
+    terminal_size_query_();
+    return true;
+}
+
+COPIED int vib_terminal_resize_timeout()
+{
+    return _terminal_state.resize_pending ? (int) terminal_resize_wait_() : -1;
+}
+
+void vib_terminal_set_fps(COPIED uint64_t fps)
+{
+    _terminal_state.frame_ns = (fps > 0) ? 1000000000UL / fps : 0;
+}
+
+COPIED int vib_terminal_frame_timeout()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    COPIED int64_t elapsed = (int64_t) (now.tv_sec - _terminal_state.frame_presented.tv_sec) * 1000000000
+                           + (now.tv_nsec - _terminal_state.frame_presented.tv_nsec);
+    COPIED int64_t left    = (int64_t) _terminal_state.frame_ns - elapsed;
+
+    /* rounded up, so that the wait never wakes a hair too early and spins */
+    return (left > 0) ? (int) CEIL_DIV(left, 1000000) : 0;
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Capability Probe
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+/*
+ * Ask for mode 2026 with DECRQM, then for DA1. Terminals answer in order and
+ * all of them answer DA1, so its reply means every answer is in and the
+ * result is cached for this terminal. A terminal that stays silent costs
+ * VIB_TERMINAL_PROBE_MS on this start and gets no extras; replies that
+ * arrive later are dropped by vib_keys_read().
+ */
+static void terminal_probe_()
+{
+    BORROWED const char * term = getenv("TERM");
+    if (!term || !term[0] || strcmp_smart(term, "dumb"))
+    {
+        return;
+    }
+    if (terminal_caps_load_())
+    {
+        return;
+    }
+
+    vib_terminal_begin_frame();
+    vib_terminal_write(VIB_QUERY_SYNC, sizeof(VIB_QUERY_SYNC) - 1);
+    vib_terminal_write(VIB_QUERY_DA1, sizeof(VIB_QUERY_DA1) - 1);
+    vib_terminal_end_frame();
+
+    COPIED uint8_t  reply[VIB_TERMINAL_PROBE_SIZE];
+    COPIED uint64_t length = 0;
+    COPIED bool     done   = false;
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (!done && length < sizeof(reply))
+    {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        COPIED int64_t left = VIB_TERMINAL_PROBE_MS
+                            - ((int64_t) (now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000);
+        if (left <= 0)
+        {
+            break;
+        }
+
+        struct pollfd pfd = { .fd = _terminal_state.input, .events = POLLIN };
+        int ready = poll(&pfd, 1, (int) left);
+        if (ready < 0 && EQ(errno, EINTR))
+        {
+            continue;
+        }
+        if (ready <= 0)
+        {
+            break;
+        }
+
+        ssize_t n = read(_terminal_state.input, reply + length, sizeof(reply) - length);
+        if (n <= 0)
+        {
+            break;
+        }
+        length += (uint64_t) n;
+        done    = terminal_probe_parse_(reply, length, false);
+    }
+
+    /* a reply that was merely slow must not be remembered as no reply */
+    terminal_probe_parse_(reply, length, true);
+    if (done)
+    {
+        terminal_caps_save_();
+    }
+}
+
+/*
+ * Scan the replies collected so far: `CSI ? 2026 ; Ps $ y` reports mode 2026
+ * (1 set, 2 reset: either way the terminal knows it) and `CSI ? ... c` is
+ * DA1. Returns true once DA1 is in. With `final`, whatever is not a reply was
+ * typed meanwhile and is handed on to vib_terminal_read_raw_byte().
+ */
+static COPIED bool terminal_probe_parse_(BORROWED const uint8_t * reply, COPIED uint64_t length, COPIED bool final)
+{
+    COPIED bool done = false;
+
+    for (uint64_t i = 0; i < length; )
+    {
+        if (i + 2 < length && EQ(reply[i], 0x1B) && EQ(reply[i + 1], '[') && EQ(reply[i + 2], '?'))
+        {
+            /* parameters and intermediates run up to the final byte */
+            COPIED uint64_t end = i + 3;
+            while (end < length && !(0x40 <= reply[end] && reply[end] <= 0x7E))
+            {
+                end++;
+            }
+            if (EQ(end, length))
+            {
+                break;
+            }
+
+            if (EQ(reply[end], 'c'))
+            {
+                done = true;
+            }
+            else if (EQ(reply[end], 'y') && end - i > 9 && EQ(memcmp(reply + i + 3, "2026;", 5), 0))
+            {
+                COPIED uint8_t mode = reply[i + 8];
+                _terminal_state.sync = EQ(mode, '1') || EQ(mode, '2');
+            }
+            i = end + 1;
+            continue;
+        }
+
+        if (final && _terminal_state.pending_count < VIB_TERMINAL_PENDING)
+        {
+            _terminal_state.pending[_terminal_state.pending_count++] = reply[i];
+        }
+        i++;
+    }
+    return done;
+}
+
+/*
+ * Terminals that share a $TERM (most claim xterm-256color) still differ, so
+ * $TERM_PROGRAM, where the terminal sets it, is part of the key.
+ */
+static OWNED char * terminal_caps_path_(COPIED bool create)
+{
+    BORROWED const char * term    = getenv("TERM");
+    BORROWED const char * program = getenv("TERM_PROGRAM");
+
+    /* the key becomes a file name: anything but [A-Za-z0-9._-] turns into '_' */
+    char name[128];
+    int  n = snprintf(name, sizeof(name), "term-%s%s%s", term, (program && program[0]) ? "-" : "", (program && program[0]) ? program : "");
+    for (int i = 0; i < n && i < (int) sizeof(name) - 1; i++)
+    {
+        char c = name[i];
+        if (!(('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || ('0' <= c && c <= '9') || c == '.' || c == '-' || c == '_'))
+        {
+            name[i] = '_';
+        }
+    }
+    return vib_paths_cache(name, create);
+}
+
+static COPIED bool terminal_caps_load_()
+{
+    OWNED char * path = terminal_caps_path_(false);
+    FILE       * file = path ? fopen(path, "r") : NIL;
+    free_smart(path);
+    if (!file)
+    {
+        return false;
+    }
+
+    char magic[16] = { 0 };
+    int  sync      = 0;
+    COPIED bool ok = EQ(fscanf(file, "%15s sync=%d", magic, &sync), 2) && strcmp_smart(magic, VIB_TERMINAL_CAPS_MAGIC);
+    fclose(file);
+
+    if (ok)
     {
-        _terminal_state.resized = 0;
-        terminal_size_query_();
-        return true;
+        _terminal_state.sync = (sync != 0);
     }
-    return false;
+    return ok;
+}
+
+/* Best effort: without a writable cache directory the next start probes again. */
+static void terminal_caps_save_()
+{
+    OWNED char * path = terminal_caps_path_(true);
+    if (!path)
+    {
+        return;
+    }
+    OWNED char * temp = mk_cstr(path, ".tmp");
+    FILE       * file = fopen(temp, "w");
+
+    COPIED bool ok = file && fprintf(file, "%s sync=%d\n", VIB_TERMINAL_CAPS_MAGIC, _terminal_state.sync ? 1 : 0) > 0;
+    if (file)
+    {
+        ok = EQ(fclose(file), 0) && ok;
+    }
+    if (!ok || rename(temp, path) < 0)
+    {
+        unlink(temp);
+    }
+    free_smart(temp);
+    free_smart(path);
+}
+
+COPIED bool vib_terminal_synchronized()
+{
+    return _terminal_state.sync;
+}
+
+COPIED bool vib_terminal_input_pending()
+{
+    return _terminal_state.pending_head < _terminal_state.pending_count;
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Output Buffer
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+static BORROWED char * terminal_chunk_(COPIED uint64_t index)
+{
+    return EQ(index, 0) ? _output_state.first : _output_state.extra[index - 1];
+}
+
+void vib_terminal_begin_frame()
+{
+    /* the buffer is empty here: outside a frame every write was flushed */
+    if (EQ(_output_state.depth++, 0) && _terminal_state.sync)
+    {
+        vib_terminal_write(VIB_SYNC_BEGIN, sizeof(VIB_SYNC_BEGIN) - 1);
+    }
+}
+
+void vib_terminal_end_frame()
+{
+    if (EQ(_output_state.depth, 0))
+    {
+        return;
+    }
+
+    if (EQ(_output_state.depth, 1) && _terminal_state.sync)
+    {
+        /* a frame that drew nothing sends nothing */
+        if (EQ(_output_state.current, 0) && EQ(_output_state.tail, sizeof(VIB_SYNC_BEGIN) - 1))
+        {
+            terminal_output_reset_();
+            return;
+        }
+        vib_terminal_write(VIB_SYNC_END, sizeof(VIB_SYNC_END) - 1);
+    }
+
+    if (EQ(--_output_state.depth, 0))
+    {
+        terminal_output_flush_();
+    }
+}
+
+void vib_terminal_write(BORROWED const char * sequence, COPIED uint64_t len)
+{
+    while (len > 0)
+    {
+        if (EQ(_output_state.tail, VIB_TERMINAL_CHUNK_SIZE))
+        {
+            /* chunks never move, so nothing already appended is copied again */
+            if (EQ(_output_state.current, _output_state.allocated))
+            {
+                if (EQ(_output_state.allocated, _output_state.slots))
+                {
+                    _output_state.slots = _output_state.slots ? _output_state.slots * 2 : 8;
+                    _output_state.extra = realloc_smart(_output_state.extra, _output_state.slots * sizeof(char *));
+                }
+                _output_state.extra[_output_state.allocated++] = new(VIB_TERMINAL_CHUNK_SIZE);
+            }
+            _output_state.current++;
+            _output_state.tail = 0;
+        }
+
+        COPIED uint64_t room = VIB_TERMINAL_CHUNK_SIZE - _output_state.tail;
+        COPIED uint64_t n    = (len < room) ? len : room;
+        memcpy(terminal_chunk_(_output_state.current) + _output_state.tail, sequence, n);
+        _output_state.tail += n;
+        sequence           += n;
+        len                -= n;
+    }
+
+    if (EQ(_output_state.depth, 0))
+    {
+        terminal_output_flush_();
+    }
+}
+
+/*
+ * Send every chunk with as few writev() calls as the kernel allows. A short
+ * write resumes inside the chunk where it stopped; errors other than EINTR
+ * drop the rest, as the terminal is gone.
+ */
+static void terminal_output_flush_()
+{
+    COPIED uint64_t index = 0;
+    COPIED uint64_t skip  = 0;
+
+    while (index < _output_state.current || (EQ(index, _output_state.current) && skip < _output_state.tail))
+    {
+        struct iovec iov[VIB_TERMINAL_IOV_BATCH];
+        int          count = 0;
+        for (uint64_t k = index; k <= _output_state.current && (uint64_t) count < VIB_TERMINAL_IOV_BATCH; k++)
+        {
+            COPIED uint64_t from = EQ(k, index) ? skip : 0;
+            COPIED uint64_t to   = EQ(k, _output_state.current) ? _output_state.tail : VIB_TERMINAL_CHUNK_SIZE;
+            iov[count].iov_base = terminal_chunk_(k) + from;
+            iov[count].iov_len  = to - from;
+            count++;
+        }
+
+        ssize_t n = writev(STDOUT_FILENO, iov, count);
+        if (n < 0 && EQ(errno, EINTR))
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            break;
+        }
+
+        COPIED uint64_t left = (uint64_t) n;
+        while (left > 0)
+        {
+            COPIED uint64_t length = (EQ(index, _output_state.current) ? _output_state.tail : VIB_TERMINAL_CHUNK_SIZE) - skip;
+            if (left < length)
+            {
+                skip += left;
+                break;
+            }
+            left -= length;
+            index++;
+            skip = 0;
+        }
+    }
+
+    _output_state.current = 0;
+    _output_state.tail    = 0;
+}
+
+static void terminal_output_reset_()
+{
+    _output_state.current = 0;
+    _output_state.tail    = 0;
+    _output_state.depth   = 0;
 }
 
 /* ─────────────────────────────────────────────────────────────────────────────
@@ -289,11 +809,28 @@ void vib_terminal_writef(BORROWED const char * fmt, ...)
     {
         return;
     }
+
+    char    line[VIB_TERMINAL_LINE_SIZE];
     va_list args;
     va_start(args, fmt);
-    vfprintf(stdout, fmt, args);
-    fflush(stdout);
+    int n = vsnprintf(line, sizeof(line), fmt, args);
     va_end(args);
+    if (n < 0)
+    {
+        return;
+    }
+    if ((uint64_t) n < sizeof(line))
+    {
+        vib_terminal_write(line, (uint64_t) n);
+        return;
+    }
+
+    OWNED char * long_line = new((uint64_t) n + 1);
+    va_start(args, fmt);
+    vsnprintf(long_line, (uint64_t) n + 1, fmt, args);
+    va_end(args);
+    vib_terminal_write(long_line, (uint64_t) n);
+    free_smart(long_line);
 }
 
 void vib_terminal_writef_owned(OWNED char * fmt, ...)
@@ -302,11 +839,16 @@ void vib_terminal_writef_owned(OWNED char * fmt, ...)
     {
         return;
     }
+
+    char    line[VIB_TERMINAL_LINE_SIZE];
     va_list args;
     va_start(args, fmt);
-    vfprintf(stdout, fmt, args);
-    fflush(stdout);
+    int n = vsnprintf(line, sizeof(line), fmt, args);
     va_end(args);
+    if (n > 0)
+    {
+        vib_terminal_write(line, ((uint64_t) n < sizeof(line)) ? (uint64_t) n : sizeof(line) - 1);
+    }
     free_smart(fmt);
 }
 
@@ -315,6 +857,11 @@ void vib_terminal_clear()
     vib_terminal_write(VIB_TERMINAL_CLR, sizeof(VIB_TERMINAL_CLR) - 1);
 }
 
+void vib_terminal_erase_line()
+{
+    vib_terminal_write(VIB_TERMINAL_ERASE_LINE, sizeof(VIB_TERMINAL_ERASE_LINE) - 1);
+}
+
 void vib_terminal_cursor_home()
 {
     vib_terminal_write(VIB_CURSOR_HOME, sizeof(VIB_CURSOR_HOME) - 1);
@@ -339,12 +886,428 @@ void vib_terminal_cursor_show()
 
 void vib_terminal_flush()
 {
-    fflush(stdout);
+    terminal_output_flush_();
 }
 
 COPIED int32_t vib_terminal_read_raw_byte()
 {
+    if (vib_terminal_input_pending())
+    {
+        return _terminal_state.pending[_terminal_state.pending_head++];
+    }
+
     unsigned char c;
-    return (1 == read(STDIN_FILENO, &c, 1)) ? c : -1;
+    return (1 == read(_terminal_state.input, &c, 1)) ? c : -1;
 }
 
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Screen Model
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+static void screen_fill_(BORROWED vib_cell_t * cells, COPIED uint64_t count)
+{
+    for (uint64_t i = 0; i < count; i++)
+    {
+        cells[i] = VIB_SCREEN_BLANK;
+    }
+}
+
+static void screen_resize_(COPIED uint64_t rows, COPIED uint64_t columns)
+{
+    if (EQ(rows, _screen_state.rows) && EQ(columns, _screen_state.columns) && _screen_state.back)
+    {
+        return;
+    }
+
+    COPIED uint64_t cells = rows * columns;
+    free_smart(_screen_state.front);
+    free_smart(_screen_state.back);
+    free_smart(_screen_state.front_hash);
+    free_smart(_screen_state.back_hash);
+    _screen_state.front      = cells ? new(cells * sizeof(vib_cell_t)) : NIL;
+    _screen_state.back       = cells ? new(cells * sizeof(vib_cell_t)) : NIL;
+    _screen_state.front_hash = cells ? new(rows * sizeof(uint64_t)) : NIL;
+    _screen_state.back_hash  = cells ? new(rows * sizeof(uint64_t)) : NIL;
+    _screen_state.rows    = cells ? rows : 0;
+    _screen_state.columns = cells ? columns : 0;
+    screen_fill_(_screen_state.back, cells);
+    _screen_state.blank_hash = cells ? screen_hash_row_(_screen_state.back) : 0;
+    vib_screen_invalidate();
+}
+
+void vib_screen_clear()
+{
+    screen_fill_(_screen_state.back, _screen_state.rows * _screen_state.columns);
+}
+
+BORROWED vib_cell_t * vib_screen_row(COPIED uint64_t row)
+{
+    if (row >= _screen_state.rows)
+    {
+        return NIL;
+    }
+    return _screen_state.back + row * _screen_state.columns;
+}
+
+/* Next code point of UTF-8 `*text`; malformed sequences come out as U+FFFD, one byte at a time. */
+static COPIED uint32_t screen_decode_(BORROWED const char ** text)
+{
+    BORROWED const uint8_t * s = (const uint8_t *) *text;
+    COPIED   uint32_t        c = s[0];
+    COPIED   uint64_t        n = (c >= 0xF0 && c < 0xF8) ? 3 : (c >= 0xE0) ? 2 : (c >= 0xC0) ? 1 : 0;
+
+    if (c < 0x80 || (c < 0xC0) || c >= 0xF8)
+    {
+        *text += 1;
+        return (c < 0x80) ? c : 0xFFFD;
+    }
+
+    c &= 0x3FU >> n;
+    for (uint64_t i = 1; i <= n; i++)
+    {
+        if (NEQ(s[i] & 0xC0, 0x80))
+        {
+            *text += 1;
+            return 0xFFFD;
+        }
+        c = (c << 6) | (s[i] & 0x3FU);
+    }
+    *text += n + 1;
+    return c;
+}
+
+COPIED uint64_t vib_screen_put(COPIED uint64_t row, COPIED uint64_t column, COPIED uint32_t attrs, BORROWED const char * text)
+{
+    BORROWED vib_cell_t * cells = vib_screen_row(row);
+    if (!cells || !text)
+    {
+        return column;
+    }
+
+    while (*text && column < _screen_state.columns)
+    {
+        cells[column].glyph = screen_decode_(&text);
+        cells[column].fg    = VIB_COLOR_DEFAULT;
+        cells[column].bg    = VIB_COLOR_DEFAULT;
+        cells[column].attrs = attrs;
+        column++;
+    }
+    return column;
+}
+
+COPIED uint64_t vib_screen_printf(COPIED uint64_t row, COPIED uint64_t column, COPIED uint32_t attrs, BORROWED const char * fmt, ...)
+{
+    char line[VIB_SCREEN_LINE_SIZE];
+
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+
+    return vib_screen_put(row, column, attrs, line);
+}
+
+void vib_screen_erase(COPIED uint64_t row, COPIED uint64_t column)
+{
+    BORROWED vib_cell_t * cells = vib_screen_row(row);
+    if (cells && column < _screen_state.columns)
+    {
+        screen_fill_(cells + column, _screen_state.columns - column);
+    }
+}
+
+void vib_screen_paint(COPIED uint64_t row, COPIED uint64_t column, COPIED uint64_t length, COPIED uint32_t attrs)
+{
+    BORROWED vib_cell_t * cells = vib_screen_row(row);
+    for (uint64_t c = column; cells && c < column + length && c < _screen_state.columns; c++)
+    {
+        cells[c].attrs = attrs;
+    }
+}
+
+void vib_screen_invalidate()
+{
+    _screen_state.valid = false;
+}
+
+/* ─── Output ─── */
+
+static void screen_emit_glyph_(COPIED uint32_t glyph)
+{
+    char     utf8[4];
+    uint64_t n = 0;
+
+    if (glyph < 0x80)
+    {
+        utf8[n++] = (char) glyph;
+    }
+    else if (glyph < 0x800)
+    {
+        utf8[n++] = (char) (0xC0 | (glyph >> 6));
+        utf8[n++] = (char) (0x80 | (glyph & 0x3F));
+    }
+    else if (glyph < 0x10000)
+    {
+        utf8[n++] = (char) (0xE0 | (glyph >> 12));
+        utf8[n++] = (char) (0x80 | ((glyph >> 6) & 0x3F));
+        utf8[n++] = (char) (0x80 | (glyph & 0x3F));
+    }
+    else
+    {
+        utf8[n++] = (char) (0xF0 | ((glyph >> 18) & 0x07));
+        utf8[n++] = (char) (0x80 | ((glyph >> 12) & 0x3F));
+        utf8[n++] = (char) (0x80 | ((glyph >> 6) & 0x3F));
+        utf8[n++] = (char) (0x80 | (glyph & 0x3F));
+    }
+    vib_terminal_write(utf8, n);
+}
+
+/* Switch to the pen of `cell` with the shortest SGR delta from the current one. */
+static void screen_emit_pen_(BORROWED const vib_cell_t * cell)
+{
+    COPIED crayon_pen_t pen = { .attrs = cell->attrs, .fg = cell->fg, .bg = cell->bg };
+    char                sgr[CRAYON_SGR_MAX];
+    COPIED uint64_t     n   = crayon_sgr(sgr, &_screen_state.pen, &pen);
+    if (n)
+    {
+        vib_terminal_write(sgr, n);
+        _screen_state.pen = pen;
+    }
+}
+
+static void screen_move_(COPIED uint64_t row, COPIED uint64_t column)
+{
+    if (EQ(_screen_state.cursor_row, row) && EQ(_screen_state.cursor_column, column))
+    {
+        return;
+    }
+    vib_terminal_writef(VIB_CURSOR_LOCATION, row + 1, column + 1);
+    _screen_state.cursor_row    = row;
+    _screen_state.cursor_column = column;
+}
+
+/*
+ * Emit the changed runs of one row. Runs closer than VIB_SCREEN_GAP cells
+ * are merged, since resending a few cells is cheaper than a cursor jump,
+ * and a blank tail is cleared with one erase-line instead of spaces.
+ */
+static void screen_present_row_(COPIED uint64_t row)
+{
+    COPIED   uint64_t     columns = _screen_state.columns;
+    BORROWED vib_cell_t * front   = _screen_state.front + row * columns;
+    BORROWED vib_cell_t * back    = _screen_state.back + row * columns;
+
+    if (EQ(memcmp(front, back, columns * sizeof(vib_cell_t)), 0))
+    {
+        return;
+    }
+
+    COPIED uint64_t tail = columns;
+    while (tail > 0 && EQ(memcmp(&back[tail - 1], &VIB_SCREEN_BLANK, sizeof(vib_cell_t)), 0))
+    {
+        tail--;
+    }
+
+    COPIED uint64_t c = 0;
+    while (c < columns)
+    {
+        if (EQ(memcmp(&front[c], &back[c], sizeof(vib_cell_t)), 0))
+        {
+            c++;
+            continue;
+        }
+
+        screen_move_(row, c);
+        if (c >= tail)
+        {
+            screen_emit_pen_(&VIB_SCREEN_BLANK);
+            vib_terminal_write(VIB_TERMINAL_ERASE_LINE, sizeof(VIB_TERMINAL_ERASE_LINE) - 1);
+            break;
+        }
+
+        COPIED uint64_t last = c;
+        for (uint64_t j = c + 1; j < tail && j - last <= VIB_SCREEN_GAP; j++)
+        {
+            if (NEQ(memcmp(&front[j], &back[j], sizeof(vib_cell_t)), 0))
+            {
+                last = j;
+            }
+        }
+
+        for (; c <= last; c++)
+        {
+            screen_emit_pen_(&back[c]);
+            screen_emit_glyph_(back[c].glyph);
+        }
+
+        /* the last column leaves the cursor in the pending-wrap state, wherever that is */
+        _screen_state.cursor_column = (c < columns) ? c : VIB_SCREEN_UNKNOWN;
+    }
+
+    memcpy(front, back, columns * sizeof(vib_cell_t));
+}
+
+static COPIED uint64_t screen_hash_row_(BORROWED const vib_cell_t * cells)
+{
+    /* FNV-1a over whole cells; a collision only costs a wasted scroll, never a wrong screen */
+    COPIED uint64_t hash = 0xCBF29CE484222325UL;
+    for (uint64_t c = 0; c < _screen_state.columns; c++)
+    {
+        hash = (hash ^ cells[c].glyph) * 0x100000001B3UL;
+        hash = (hash ^ cells[c].fg) * 0x100000001B3UL;
+        hash = (hash ^ cells[c].bg) * 0x100000001B3UL;
+        hash = (hash ^ cells[c].attrs) * 0x100000001B3UL;
+    }
+    return hash;
+}
+
+/*
+ * Find the vertical shift that lines the most rows of the new frame up with
+ * rows already on the terminal: back row r equal to front row r + shift, so
+ * a positive shift means contents moved up. Blank rows do not count, as they
+ * match anywhere and cost one erase-line to redraw. Returns 0 unless the best
+ * shift saves VIB_SCREEN_SCROLL_GAIN rows over the plain diff; `first` and
+ * `last` receive the back rows it matches.
+ */
+static COPIED int64_t screen_find_shift_(BORROWED uint64_t * first, BORROWED uint64_t * last)
+{
+    COPIED   int64_t    rows  = (int64_t) _screen_state.rows;
+    COPIED   uint64_t   blank = _screen_state.blank_hash;
+    BORROWED uint64_t * front = _screen_state.front_hash;
+    BORROWED uint64_t * back  = _screen_state.back_hash;
+
+    COPIED uint64_t in_place = 0;
+    for (int64_t r = 0; r < rows; r++)
+    {
+        in_place += NEQ(back[r], blank) && EQ(back[r], front[r]);
+    }
+
+    COPIED int64_t  best    = 0;
+    COPIED uint64_t matches = in_place;
+    for (int64_t shift = 1 - rows; shift < rows; shift++)
+    {
+        COPIED uint64_t n = 0;
+        for (int64_t r = (shift < 0) ? -shift : 0; r < rows && r + shift < rows; r++)
+        {
+            n += NEQ(back[r], blank) && EQ(back[r], front[r + shift]);
+        }
+        if (n > matches)
+        {
+            best    = shift;
+            matches = n;
+        }
+    }
+    if (EQ(best, 0) || matches < in_place + VIB_SCREEN_SCROLL_GAIN)
+    {
+        return 0;
+    }
+
+    *first = UINT64_MAX;
+    *last  = 0;
+    for (int64_t r = (best < 0) ? -best : 0; r < rows && r + best < rows; r++)
+    {
+        if (NEQ(back[r], blank) && EQ(back[r], front[r + best]))
+        {
+            *first = (*first < (uint64_t) r) ? *first : (uint64_t) r;
+            *last  = (uint64_t) r;
+        }
+    }
+    return best;
+}
+
+/*
+ * Move rows inside the terminal instead of resending them: a scroll region
+ * around the rows that moved, IND at its bottom (or RI at its top) once per
+ * row, and the region reset. The front grid is shifted the same way, so the
+ * diff that follows sends only the rows scrolled in and whatever else changed.
+ */
+static void screen_scroll_(COPIED int64_t shift, COPIED uint64_t first, COPIED uint64_t last)
+{
+    COPIED uint64_t columns = _screen_state.columns;
+    COPIED uint64_t count   = (uint64_t) ((shift > 0) ? shift : -shift);
+    COPIED uint64_t top     = (shift > 0) ? first : first - count;      /* front rows of the region */
+    COPIED uint64_t bottom  = (shift > 0) ? last + count : last;
+    COPIED uint64_t keep    = bottom - top + 1 - count;                 /* rows that survive the scroll */
+
+    /* rows scrolled in take the current background, so make it the default */
+    screen_emit_pen_(&VIB_SCREEN_BLANK);
+    vib_terminal_writef(VIB_SCROLL_REGION, top + 1, bottom + 1);
+    vib_terminal_writef(VIB_CURSOR_LOCATION, ((shift > 0) ? bottom : top) + 1, 1UL);
+    for (uint64_t i = 0; i < count; i++)
+    {
+        if (shift > 0)
+        {
+            vib_terminal_write(VIB_INDEX, sizeof(VIB_INDEX) - 1);
+        }
+        else
+        {
+            vib_terminal_write(VIB_REVERSE_INDEX, sizeof(VIB_REVERSE_INDEX) - 1);
+        }
+    }
+    vib_terminal_write(VIB_SCROLL_RESET, sizeof(VIB_SCROLL_RESET) - 1);
+    _screen_state.cursor_row    = 0;
+    _screen_state.cursor_column = 0;
+
+    COPIED uint64_t from  = (shift > 0) ? top + count : top;
+    COPIED uint64_t to    = (shift > 0) ? top : top + count;
+    COPIED uint64_t blank = (shift > 0) ? top + keep : top;
+    memmove(_screen_state.front + to * columns, _screen_state.front + from * columns, keep * columns * sizeof(vib_cell_t));
+    memmove(_screen_state.front_hash + to, _screen_state.front_hash + from, keep * sizeof(uint64_t));
+    screen_fill_(_screen_state.front + blank * columns, count * columns);
+    for (uint64_t r = blank; r < blank + count; r++)
+    {
+        _screen_state.front_hash[r] = _screen_state.blank_hash;
+    }
+}
+
+void vib_screen_present()
+{
+    if (!_screen_state.back)
+    {
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &_terminal_state.frame_presented);
+    vib_terminal_begin_frame();
+    for (uint64_t row = 0; row < _screen_state.rows; row++)
+    {
+        _screen_state.back_hash[row] = screen_hash_row_(_screen_state.back + row * _screen_state.columns);
+    }
+
+    if (!_screen_state.valid)
+    {
+        /* start from a known blank screen; the diff then paints only what is not blank */
+        screen_fill_(_screen_state.front, _screen_state.rows * _screen_state.columns);
+        for (uint64_t row = 0; row < _screen_state.rows; row++)
+        {
+            _screen_state.front_hash[row] = _screen_state.blank_hash;
+        }
+        _screen_state.pen = (crayon_pen_t) { .attrs = 0, .fg = VIB_COLOR_DEFAULT, .bg = VIB_COLOR_DEFAULT };
+        vib_terminal_write(VIB_TERMINAL_RESET_PEN, sizeof(VIB_TERMINAL_RESET_PEN) - 1);
+        vib_terminal_write(VIB_TERMINAL_CLR, sizeof(VIB_TERMINAL_CLR) - 1);
+        _screen_state.cursor_row    = VIB_SCREEN_UNKNOWN;
+        _screen_state.cursor_column = VIB_SCREEN_UNKNOWN;
+        _screen_state.valid         = true;
+    }
+    else
+    {
+        COPIED uint64_t first = 0;
+        COPIED uint64_t last  = 0;
+        COPIED int64_t  shift = screen_find_shift_(&first, &last);
+        if (NEQ(shift, 0))
+        {
+            screen_scroll_(shift, first, last);
+        }
+    }
+
+    for (uint64_t row = 0; row < _screen_state.rows; row++)
+    {
+        screen_present_row_(row);
+    }
+    memcpy(_screen_state.front_hash, _screen_state.back_hash, _screen_state.rows * sizeof(uint64_t));
+
+    /* leave the default pen behind for anyone writing to the terminal directly */
+    screen_emit_pen_(&VIB_SCREEN_BLANK);
+    vib_terminal_end_frame();
+}
@@ -0,0 +1,913 @@
+#include "vib_view.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "memory.h"
+#include "cstr.h"
+#include "vib_term.h"
+#include "vib_save.h"
+#include "vib_governor.h"
+#include "vib_hex.h"
+
+#define VIB_VIEW_LINE_CAPACITY  (1024UL)
+#define VIB_VIEW_MARKS          (2UL)       /* the cursor shows in the hex and the ASCII column */
+#define VIB_VIEW_LINE_SLOTS     (64UL)      /* fewest row cache slots; at least twice the screen rows */
+#define VIB_VIEW_NOWHERE        (UINT64_MAX)
+
+/* Foreground of each vib_hex class; printable text keeps the default. */
+static const uint32_t VIB_VIEW_PALETTE[VIB_HEX_CLASSES] =
+{
+    [VIB_HEX_NUL]        = VIB_COLOR_INDEX(8),
+    [VIB_HEX_PRINTABLE]  = VIB_COLOR_DEFAULT,
+    [VIB_HEX_WHITESPACE] = VIB_COLOR_INDEX(2),
+    [VIB_HEX_CONTROL]    = VIB_COLOR_INDEX(5),
+    [VIB_HEX_HIGH]       = VIB_COLOR_INDEX(3),
+    [VIB_HEX_FF]         = VIB_COLOR_INDEX(1),
+};
+
+static bool _view_colors = true;
+
+typedef struct vib_view_mark_t vib_view_mark_t;
+
+/* Columns of a formatted row drawn reversed; `length` 0 marks nothing. */
+struct vib_view_mark_t
+{
+    COPIED uint64_t column;
+    COPIED uint64_t length;
+};
+
+/* A formatted data row; its text lives at `slot * line_stride` in `line_text`. */
+struct vib_view_line_t
+{
+    COPIED uint64_t offset;         /* VIB_VIEW_NOWHERE when empty */
+    COPIED uint64_t length;         /* bytes of the row it was formatted from */
+    COPIED uint64_t classified;     /* bytes actually read and classified, short when a read fails */
+    COPIED uint64_t text_length;
+};
+
+/* What a screen row of the back grid holds since the last compose. */
+struct vib_view_drawn_t
+{
+    COPIED uint64_t offset;         /* VIB_VIEW_NOWHERE: compose it again */
+    COPIED uint64_t length;
+    COPIED bool     marked;         /* the cursor was painted in it */
+};
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Forward Declarations
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+static COPIED uint64_t view_last_offset_(BORROWED vib_view_t * view);
+static COPIED uint64_t view_window_bytes_(BORROWED vib_view_t * view);
+static COPIED vib_extent_t view_collapsed_(BORROWED vib_view_t * view, COPIED uint64_t offset);
+static COPIED uint64_t view_row_start_(BORROWED vib_view_t * view, COPIED uint64_t offset);
+static COPIED uint64_t view_row_next_(BORROWED vib_view_t * view, COPIED uint64_t row);
+static COPIED uint64_t view_row_prev_(BORROWED vib_view_t * view, COPIED uint64_t row);
+static void view_move_cursor_(BORROWED vib_view_t * view, COPIED int64_t delta);
+static void view_move_rows_(BORROWED vib_view_t * view, COPIED int64_t count);
+static void view_skip_hole_(BORROWED vib_view_t * view, COPIED bool forward);
+static void view_follow_cursor_(BORROWED vib_view_t * view);
+static void view_fit_(BORROWED vib_view_t * view);
+static COPIED bool view_handle_replace_(BORROWED vib_view_t * view, COPIED vib_key_t key);
+static COPIED vib_span_t view_row_bytes_(BORROWED vib_view_t * view, COPIED uint64_t offset, BORROWED uint8_t * scratch);
+static COPIED uint64_t view_digits_(BORROWED vib_view_t * view);
+static COPIED uint64_t view_layout_(BORROWED vib_view_t * view);
+static void view_lines_prepare_(BORROWED vib_view_t * view);
+static COPIED uint64_t view_format_row_(BORROWED vib_view_t * view, COPIED uint64_t offset, BORROWED char * line, BORROWED uint8_t * classes, BORROWED uint64_t * classified);
+static BORROWED const char * view_row_text_(BORROWED vib_view_t * view, COPIED uint64_t offset, COPIED uint64_t length, BORROWED const uint8_t ** classes, BORROWED uint64_t * classified);
+static void view_row_colors_(BORROWED vib_view_t * view, COPIED uint64_t row, COPIED uint64_t length, BORROWED const uint8_t * classes);
+static void view_row_marks_(BORROWED vib_view_t * view, COPIED uint64_t offset, COPIED uint64_t length, BORROWED vib_view_mark_t * marks);
+static void view_draw_status_(BORROWED vib_view_t * view);
+static void view_save_(BORROWED vib_view_t * view);
+static void view_memory_(BORROWED vib_view_t * view);
+static COPIED uint64_t view_format_hole_(BORROWED vib_view_t * view, COPIED vib_extent_t run, BORROWED char * line, COPIED uint64_t capacity, BORROWED vib_view_mark_t * marks);
+static void view_draw_row_(BORROWED vib_view_t * view, COPIED uint64_t row, COPIED uint64_t offset);
+static void view_append_(BORROWED char * line, BORROWED uint64_t * n, COPIED uint64_t capacity, BORROWED const char * fmt, ...);
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Lifecycle
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+void vib_view_colors_enable(COPIED bool enabled)
+{
+    _view_colors = enabled;
+}
+
+COPIED bool vib_view_colors_enabled()
+{
+    return _view_colors;
+}
+
+OWNED vib_view_t * vib_view_init(OWNED vib_view_t * view, BORROWED vib_buffer_t * buffer)
+{
+    if (!view)
+    {
+        view = new(sizeof(vib_view_t));
+    }
+
+    view->buffer        = buffer;
+    view->top           = 0;
+    view->cursor        = 0;
+    view->bytes_per_row = VIB_VIEW_BYTES_PER_ROW;
+    view->word          = 1;
+    view->rows          = 1;
+    view->columns       = 0;
+    view->pending       = VIB_KEY_NONE;
+    view->digits        = 0;
+    view->value         = 0;
+    view->message[0]    = '\0';
+
+    view->lines         = NIL;
+    view->line_text     = NIL;
+    view->line_classes  = NIL;
+    view->line_slots    = 0;
+    view->line_stride   = 0;
+    view->layout        = 0;
+    view->generation    = 0;
+    view->drawn         = NIL;
+    view->drawn_rows    = 0;
+
+    return view;
+}
+
+COPIED void * vib_view_dispose(OWNED void * arg)
+{
+    if (!arg)
+    {
+        return NIL;
+    }
+
+    OWNED vib_view_t * view = CAST(arg, vib_view_t *);
+    free_smart(view->lines);
+    free_smart(view->line_text);
+    free_smart(view->line_classes);
+    free_smart(view->drawn);
+    return dispose(view);
+}
+
+void vib_view_resize(BORROWED vib_view_t * view, COPIED uint64_t rows, COPIED uint64_t columns)
+{
+    /* the last terminal row is reserved for the status line */
+    view->rows    = (rows > 1) ? rows - 1 : 1;
+    view->columns = columns;
+    view_fit_(view);
+    view->top     = view_row_start_(view, view->top);
+    view_follow_cursor_(view);
+
+    /* a resized screen starts blank, so every row is composed again */
+    free_smart(view->drawn);
+    view->drawn      = NIL;
+    view->drawn_rows = 0;
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Motions
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+static COPIED uint64_t view_last_offset_(BORROWED vib_view_t * view)
+{
+    COPIED uint64_t size = vib_buffer_size(view->buffer);
+    return (size > 0) ? size - 1 : 0;
+}
+
+static COPIED uint64_t view_window_bytes_(BORROWED vib_view_t * view)
+{
+    return view->rows * view->bytes_per_row;
+}
+
+/*
+ * Screen rows are `bytes_per_row` apart, except that the whole rows inside a
+ * hole of at least two rows collapse into a single screen row.
+ */
+static COPIED vib_extent_t view_collapsed_(BORROWED vib_view_t * view, COPIED uint64_t offset)
+{
+    COPIED vib_extent_t run  = { .offset = offset, .length = 0 };
+    COPIED vib_extent_t hole = vib_buffer_hole(view->buffer, offset);
+    if (EQ(hole.length, 0))
+    {
+        return run;
+    }
+
+    COPIED uint64_t bpr   = view->bytes_per_row;
+    COPIED uint64_t start = CEIL_DIV(hole.offset, bpr) * bpr;
+    COPIED uint64_t end   = FLOOR_DIV(hole.offset + hole.length, bpr);
+    if (end < start + 2 * bpr || offset < start || offset >= end)
+    {
+        return run;
+    }
+
+    run.offset = start;
+    run.length = end - start;
+    return run;
+}
+
+/* Offset of the screen row holding `offset`. */
+static COPIED uint64_t view_row_start_(BORROWED vib_view_t * view, COPIED uint64_t offset)
+{
+    COPIED vib_extent_t run = view_collapsed_(view, offset);
+    return run.length ? run.offset : FLOOR_DIV(offset, view->bytes_per_row);
+}
+
+static COPIED uint64_t view_row_next_(BORROWED vib_view_t * view, COPIED uint64_t row)
+{
+    COPIED vib_extent_t run = view_collapsed_(view, row);
+    return run.length ? run.offset + run.length : row + view->bytes_per_row;
+}
+
+static COPIED uint64_t view_row_prev_(BORROWED vib_view_t * view, COPIED uint64_t row)
+{
+    return (row > 0) ? view_row_start_(view, row - 1) : 0;
+}
+
+static void view_move_cursor_(BORROWED vib_view_t * view, COPIED int64_t delta)
+{
+    if (delta < 0)
+    {
+        COPIED uint64_t back = (uint64_t) -delta;
+        view->cursor = (view->cursor > back) ? view->cursor - back : 0;
+    }
+    else
+    {
+        COPIED uint64_t forth = (uint64_t) delta;
+
+        /* inputs of unknown size only learn about bytes once they are read */
+        vib_buffer_reaches(view->buffer, view->cursor + forth);
+
+        /* a delete of the last byte leaves the cursor one past the end */
+        COPIED uint64_t last = view_last_offset_(view);
+        if (view->cursor >= last)
+        {
+            view->cursor = last;
+        }
+        view->cursor = (last - view->cursor > forth) ? view->cursor + forth : last;
+    }
+}
+
+/*
+ * Move `count` screen rows up (negative) or down, keeping the column. A
+ * collapsed hole counts as one row but the cursor only stops on it when
+ * there is no data beyond it. Running into either end lands on that end.
+ */
+static void view_move_rows_(BORROWED vib_view_t * view, COPIED int64_t count)
+{
+    COPIED uint64_t bpr    = view->bytes_per_row;
+    COPIED uint64_t column = view->cursor % bpr;
+    COPIED uint64_t row    = view_row_start_(view, view->cursor);
+    COPIED uint64_t left   = (count < 0) ? (uint64_t) -count : (uint64_t) count;
+
+    if (count < 0)
+    {
+        for (; left > 0 && row > 0; left--)
+        {
+            row = view_row_prev_(view, row);
+        }
+        if (view_collapsed_(view, row).length && row > 0)
+        {
+            row = view_row_prev_(view, row);
+        }
+        view->cursor = (left > 0) ? 0 : row + column;
+    }
+    else
+    {
+        for (; left > 0; left--)
+        {
+            COPIED uint64_t next = view_row_next_(view, row);
+            if (!vib_buffer_reaches(view->buffer, next))
+            {
+                break;
+            }
+            row = next;
+        }
+        if (view_collapsed_(view, row).length && vib_buffer_reaches(view->buffer, view_row_next_(view, row)))
+        {
+            row = view_row_next_(view, row);
+        }
+        view->cursor = (left > 0) ? UINT64_MAX : row + column;
+    }
+
+    COPIED uint64_t last = view_last_offset_(view);
+    if (view->cursor > last)
+    {
+        view->cursor = last;
+    }
+}
+
+/* After a horizontal step into a collapsed hole, carry on to the data past it. */
+static void view_skip_hole_(BORROWED vib_view_t * view, COPIED bool forward)
+{
+    COPIED vib_extent_t run = view_collapsed_(view, view->cursor);
+    if (EQ(run.length, 0))
+    {
+        return;
+    }
+
+    if (forward && vib_buffer_reaches(view->buffer, run.offset + run.length))
+    {
+        view->cursor = run.offset + run.length;
+    }
+    else if (!forward && run.offset > 0)
+    {
+        view->cursor = run.offset - 1;
+    }
+}
+
+/* Scroll just enough for the cursor row to be visible. */
+static void view_follow_cursor_(BORROWED vib_view_t * view)
+{
+    COPIED uint64_t row = view_row_start_(view, view->cursor);
+    if (row < view->top)
+    {
+        view->top = row;
+        return;
+    }
+
+    COPIED uint64_t last = view->top;
+    for (uint64_t r = 1; r < view->rows && last < row; r++)
+    {
+        last = view_row_next_(view, last);
+    }
+    if (row <= last)
+    {
+        return;
+    }
+
+    /* put the cursor row at the bottom */
+    view->top = row;
+    for (uint64_t r = 1; r < view->rows && view->top > 0; r++)
+    {
+        view->top = view_row_prev_(view, view->top);
+    }
+}
+
+/*
+ * The layout engine: the most bytes per row that fit the width, in the
+ * shortest words that still fit. 80 columns keep 16 single bytes, 120 take
+ * 32 in words of 4, and 220 or more 64. Below 38 columns nothing fits and
+ * the narrowest layout is clipped.
+ */
+static void view_fit_(BORROWED vib_view_t * view)
+{
+    COPIED uint64_t digits = view_digits_(view);
+
+    for (uint64_t bytes = VIB_HEX_ROW_MAX; bytes >= VIB_HEX_GROUP; bytes /= 2)
+    {
+        for (uint64_t word = 1; word <= VIB_HEX_WORD_MAX; word *= 2)
+        {
+            /* offset, two spaces, digits, ` |`, gutter, `|` */
+            if (digits + 2 + VIB_HEX_WIDTH(bytes, word) + 2 + bytes + 1 <= view->columns)
+            {
+                view->bytes_per_row = bytes;
+                view->word          = word;
+                return;
+            }
+        }
+    }
+
+    view->bytes_per_row = VIB_HEX_GROUP;
+    view->word          = VIB_HEX_WORD_MAX;
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Edits
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+static COPIED bool view_handle_replace_(BORROWED vib_view_t * view, COPIED vib_key_t key)
+{
+    if (!cis_xdigit(key))
+    {
+        view->pending = VIB_KEY_NONE;
+        return true;
+    }
+
+    COPIED uint8_t nibble = cis_digit(key) ? (uint8_t) (key - '0') : (uint8_t) (cto_english_lowerletter(key) - 'a' + 10);
+    view->value = (uint8_t) ((view->value << 4) | nibble);
+    if (++view->digits < 2)
+    {
+        return true;
+    }
+
+    view->pending = VIB_KEY_NONE;
+    if (view->cursor < vib_buffer_size(view->buffer))
+    {
+        vib_buffer_replace(view->buffer, view->cursor, &view->value, 1);
+    }
+    return true;
+}
+
+COPIED bool vib_view_handle_key(BORROWED vib_view_t * view, COPIED vib_key_t key)
+{
+    COPIED int64_t page = (int64_t) view->rows;
+
+    COPIED bool noted = !EQ(view->message[0], '\0');
+    view->message[0] = '\0';
+
+    if (EQ(view->pending, 'r'))
+    {
+        return view_handle_replace_(view, key) || noted;
+    }
+
+    switch (key)
+    {
+        case 'w':
+        {
+            view_save_(view);
+        } break;
+
+        case 'm':
+        {
+            view_memory_(view);
+        } break;
+
+        case 'r':
+        {
+            view->pending = 'r';
+            view->digits  = 0;
+            view->value   = 0;
+        } return false;
+
+        case 'x':
+        case VIB_KEY_DELETE:
+        {
+            if (view->cursor < vib_buffer_size(view->buffer))
+            {
+                vib_buffer_delete(view->buffer, view->cursor, 1);
+            }
+            view_move_cursor_(view, 0);
+        } break;
+
+        case 'h':
+        case VIB_KEY_LEFT:
+        {
+            view_move_cursor_(view, -1);
+            view_skip_hole_(view, false);
+        } break;
+
+        case 'l':
+        case VIB_KEY_RIGHT:
+        {
+            view_move_cursor_(view, 1);
+            view_skip_hole_(view, true);
+        } break;
+
+        case 'k':
+        case VIB_KEY_UP:
+        {
+            view_move_rows_(view, -1);
+        } break;
+
+        case 'j':
+        case VIB_KEY_DOWN:
+        {
+            view_move_rows_(view, 1);
+        } break;
+
+        case (VIB_CTRL | 'b'):
+        case VIB_KEY_PAGE_UP:
+        {
+            view_move_rows_(view, -page);
+        } break;
+
+        case (VIB_CTRL | 'f'):
+        case VIB_KEY_PAGE_DOWN:
+        {
+            view_move_rows_(view, page);
+        } break;
+
+        case (VIB_CTRL | 'u'):
+        {
+            view_move_rows_(view, -(page / 2));
+        } break;
+
+        case (VIB_CTRL | 'd'):
+        {
+            view_move_rows_(view, page / 2);
+        } break;
+
+        case '0':
+        {
+            view->cursor = view_row_start_(view, view->cursor);
+        } break;
+
+        case '$':
+        {
+            COPIED uint64_t row = view_row_start_(view, view->cursor);
+            view->cursor = row;
+            view_move_cursor_(view, (int64_t) (view_row_next_(view, row) - row - 1));
+        } break;
+
+        case 'g':
+        case VIB_KEY_HOME:
+        {
+            view->cursor = 0;
+        } break;
+
+        case 'G':
+        case VIB_KEY_END:
+        {
+            view->cursor = view_last_offset_(view);
+        } break;
+
+        default:
+        {
+            return false;
+        }
+    }
+
+    view_follow_cursor_(view);
+    vib_buffer_advise(view->buffer, VIB_ACCESS_SCROLL, view->top, view_window_bytes_(view));
+    return true;
+}
+
+/* ─────────────────────────────────────────────────────────────────────────────
+ * Rendering
+ * ───────────────────────────────────────────────────────────────────────────── */
+
+static void view_append_(BORROWED char * line, BORROWED uint64_t * n, COPIED uint64_t capacity, BORROWED const char * fmt, ...)
+{
+    if (*n + 1 >= capacity)
+    {
+        return;
+    }
+
+    va_list args;
+    va_start(args, fmt);
+    int written = vsnprintf(line + *n, capacity - *n, fmt, args);
+    va_end(args);
+
+    if (written > 0)
+    {
+        *n += ((uint64_t) written < capacity - *n) ? (uint64_t) written : capacity - *n - 1;
+    }
+}
+
+/**
+ * Borrow the bytes of one row. Zero-copy when the backend has them in one
+ * span; a row straddling two cache pages is gathered into `scratch`.
+ */
+static COPIED vib_span_t view_row_bytes_(BORROWED vib_view_t * view, COPIED uint64_t offset, BORROWED uint8_t * scratch)
+{
+    COPIED uint64_t   bpr  = view->bytes_per_row;
+    COPIED vib_span_t span = vib_buffer_span(view->buffer, offset, bpr);
+    if (EQ(span.length, bpr) || EQ(span.length, 0))
+    {
+        return span;
+    }
+
+    COPIED uint64_t n = 0;
+    while (n < bpr && span.length > 0)
+    {
+        memcpy(scratch + n, span.data, span.length);
+        n += span.length;
+        span = vib_buffer_span(view->buffer, offset + n, bpr - n);
+    }
+
+    span.data   = scratch;
+    span.length = n;
+    return span;
+}
+
+/* 32-bit offsets are enough for anything under 4 GiB and save 8 columns */
+static COPIED uint64_t view_digits_(BORROWED vib_view_t * view)
+{
+    return (vib_buffer_size(view->buffer) > 0xFFFFFFFFUL) ? 16 : 8;
+}
+
+/* Everything a formatted row depends on besides its bytes. */
+static COPIED uint64_t view_layout_(BORROWED vib_view_t * view)
+{
+    return view->bytes_per_row | (view->word << 8) | (view_digits_(view) << 32);
+}
+
+/*
+ * Formatted rows are cached by offset in a direct-mapped table of at least
+ * twice the screen rows, so scrolling back finds rows that just left. The
+ * table is emptied when the layout or the bytes change; appended bytes only
+ * change a row's length, which every lookup checks. The screen rows
+ * composed last time are forgotten with it.
+ */
+static void view_lines_prepare_(BORROWED vib_view_t * view)
+{
+    COPIED uint64_t layout     = view_layout_(view);
+    COPIED uint64_t generation = view->buffer->generation;
+    COPIED uint64_t slots      = VIB_VIEW_LINE_SLOTS;
+    while (slots < 2 * view->rows)
+    {
+        slots *= 2;
+    }
+
+    COPIED bool stale = NEQ(layout, view->layout) || NEQ(generation, view->generation);
+    if (NEQ(slots, view->line_slots) || NEQ(layout, view->layout))
+    {
+        /* offset, digits with their scratch byte, gutter and NUL */
+        COPIED uint64_t stride = view_digits_(view) + 2 + VIB_HEX_WIDTH(view->bytes_per_row, view->word) + 1 + 2 + view->bytes_per_row + 2;
+        ASSERTF(stride <= VIB_VIEW_LINE_CAPACITY, "%s(): %lu bytes per row do not fit a line", __func__, view->bytes_per_row);
+
+        free_smart(view->lines);
+        free_smart(view->line_text);
+        free_smart(view->line_classes);
+        view->line_slots   = slots;
+        view->line_stride  = stride;
+        view->lines        = new(slots * sizeof(vib_view_line_t));
+        view->line_text    = new(slots * stride);
+        view->line_classes = new(slots * view->bytes_per_row);
+        stale              = true;
+    }
+
+    if (stale)
+    {
+        for (uint64_t i = 0; i < view->line_slots; i++)
+        {
+            view->lines[i].offset = VIB_VIEW_NOWHERE;
+        }
+        view->layout     = layout;
+        view->generation = generation;
+
+        free_smart(view->drawn);
+        view->drawn      = NIL;
+        view->drawn_rows = 0;
+    }
+
+    if (NEQ(view->drawn_rows, view->rows))
+    {
+        free_smart(view->drawn);
+        view->drawn      = new(view->rows * sizeof(vib_view_drawn_t));
+        view->drawn_rows = view->rows;
+        for (uint64_t r = 0; r < view->rows; r++)
+        {
+            view->drawn[r].offset = VIB_VIEW_NOWHERE;
+        }
+    }
+}
+
+/*
+ * Format one row as `OFFSET  XX XX .. XX  |ascii|`, NUL terminated, and the
+ * class of each byte read; `classified` is how many that was.
+ */
+static COPIED uint64_t view_format_row_(BORROWED vib_view_t * view, COPIED uint64_t offset, BORROWED char * line, BORROWED uint8_t * classes, BORROWED uint64_t * classified)
+{
+    COPIED uint8_t    scratch[VIB_HEX_ROW_MAX];
+    COPIED uint64_t   n    = 0;
+    COPIED vib_span_t span = view_row_bytes_(view, offset, scratch);
+
+    n += vib_hex_offset(line + n, offset, view_digits_(view));
+    line[n++] = ' ';
+    line[n++] = ' ';
+    n += vib_hex_digits(line + n, span.data, span.length, view->bytes_per_row, view->word);
+    line[n++] = ' ';
+    line[n++] = '|';
+    n += vib_hex_ascii(line + n, span.data, span.length);
+    line[n++] = '|';
+    line[n]   = '\0';
+    *classified = vib_hex_classify(classes, span.data, span.length);
+    return n;
+}
+
+/* Text and byte classes of the `length`-byte row at `offset`, formatted only on a cache miss. */
+static BORROWED const char * view_row_text_(BORROWED vib_view_t * view, COPIED uint64_t offset, COPIED uint64_t length, BORROWED const uint8_t ** classes, BORROWED uint64_t * classified)
+{
+    COPIED   uint64_t          slot  = (offset / view->bytes_per_row) & (view->line_slots - 1);
+    BORROWED vib_view_line_t * line  = &view->lines[slot];
+    BORROWED char            * text  = view->line_text + slot * view->line_stride;
+    BORROWED uint8_t         * class = view->line_classes + slot * view->bytes_per_row;
+
+    if (NEQ(line->offset, offset) || NEQ(line->length, length))
+    {
+        line->offset      = offset;
+        line->length      = length;
+        line->text_length = view_format_row_(view, offset, text, class, &line->classified);
+    }
+    *classes    = class;
+    *classified = line->classified;
+    return text;
+}
+
+/*
+ * Foreground of each byte's cells from its class, a table lookup with no
+ * test per byte. The space after a pair takes the pair's color too, so a
+ * run of one class is a single pen change on the wire. `length` is the
+ * number of bytes classified, not the row's: a short read leaves the rest
+ * of `classes` unset.
+ */
+static void view_row_colors_(BORROWED vib_view_t * view, COPIED uint64_t row, COPIED uint64_t length, BORROWED const uint8_t * classes)
+{
+    BORROWED vib_cell_t * cells = vib_screen_row(row);
+    if (!cells || !_view_colors)
+    {
+        return;
+    }
+
+    COPIED uint64_t columns = vib_terminal_get_columns();
+    COPIED uint64_t hex     = view_digits_(view) + 2;
+    COPIED uint64_t ascii   = hex + VIB_HEX_WIDTH(view->bytes_per_row, view->word) + 2;
+    COPIED uint64_t word    = view->word;
+    COPIED uint64_t i       = 0;
+
+    /* a pair's cells after its digits are a space or the next pair's, which is colored next */
+    for (; i < length && hex + VIB_HEX_COLUMN(i, word) + 3 < columns; i++)
+    {
+        COPIED uint32_t fg = VIB_VIEW_PALETTE[classes[i]];
+        COPIED uint64_t c  = hex + VIB_HEX_COLUMN(i, word);
+        cells[c].fg     = fg;
+        cells[c + 1].fg = fg;
+        cells[c + 2].fg = fg;
+        cells[c + 3].fg = fg;
+    }
+    /* the last pairs before a narrow screen's edge */
+    for (; i < length && hex + VIB_HEX_COLUMN(i, word) + 1 < columns; i++)
+    {
+        COPIED uint64_t c = hex + VIB_HEX_COLUMN(i, word);
+        cells[c].fg     = VIB_VIEW_PALETTE[classes[i]];
+        cells[c + 1].fg = VIB_VIEW_PALETTE[classes[i]];
+    }
+
+    for (i = 0; i < length && ascii + i < columns; i++)
+    {
+        cells[ascii + i].fg = VIB_VIEW_PALETTE[classes[i]];
+    }
+}
+
+/* The byte under the cursor, if it is in this row, in both columns. */
+static void view_row_marks_(BORROWED vib_view_t * view, COPIED uint64_t offset, COPIED uint64_t length, BORROWED vib_view_mark_t * marks)
+{
+    if (view->cursor < offset || view->cursor >= offset + length)
+    {
+        return;
+    }
+
+    COPIED uint64_t i   = view->cursor - offset;
+    COPIED uint64_t hex = view_digits_(view) + 2;
+    marks[0].column = hex + VIB_HEX_COLUMN(i, view->word);
+    marks[0].length = 2;
+    marks[1].column = hex + VIB_HEX_WIDTH(view->bytes_per_row, view->word) + 2 + i;
+    marks[1].length = 1;
+}
+
+static void view_draw_status_(BORROWED vib_view_t * view)
+{
+    COPIED uint64_t size    = vib_buffer_size(view->buffer);
+    COPIED uint64_t percent = (size > 0) ? (view->cursor * 100) / size : 0;
+    COPIED uint64_t row     = view->rows;
+
+    vib_screen_erase(row, 0);
+    COPIED uint64_t column = vib_screen_printf(row, 0, VIB_ATTR_REVERSED, " %s%s ",
+                                               view->buffer->path,
+                                               vib_buffer_is_modified(view->buffer) ? " [+]" : "");
+    vib_screen_printf(row, column, 0, "  0x%lX / 0x%lX%s  %lu%%%s%s",
+                      view->cursor,
+                      size,
+                      view->buffer->size_known ? "" : " (growing)",
+                      percent,
+                      view->message[0] ? "  " : "",
+                      view->message);
+}
+
+/* One line of vib_governor counters, MiB and totals across all caches. */
+static void view_memory_(BORROWED vib_view_t * view)
+{
+    COPIED vib_governor_stats_t stats = vib_governor_stats();
+    snprintf(view->message, sizeof(view->message),
+             "mem %lu/%lu MiB, pages %lu MiB, hits %lu misses %lu evictions %lu",
+             stats.heap >> 20,
+             stats.budget >> 20,
+             stats.charged[VIB_MEMORY_PAGES] >> 20,
+             stats.hits,
+             stats.misses,
+             stats.evictions);
+}
+
+static void view_save_(BORROWED vib_view_t * view)
+{
+    if (!vib_buffer_is_modified(view->buffer))
+    {
+        snprintf(view->message, sizeof(view->message), "no changes");
+        return;
+    }
+
+    COPIED vib_save_stats_t stats;
+    COPIED result_t         r = vib_save(view->buffer, VIB_SAVE_AUTO, &stats);
+    if (RESULT_IS_ERR(r))
+    {
+        snprintf(view->message, sizeof(view->message), "save failed: %s", strerror((int) r.err));
+        return;
+    }
+
+    if (stats.in_place)
+    {
+        snprintf(view->message, sizeof(view->message), "saved in place: %lu bytes patched", stats.written);
+    }
+    else
+    {
+        snprintf(view->message, sizeof(view->message), "saved: %lu written, %lu reflinked, %lu copied",
+                 stats.written, stats.cloned, stats.moved);
+    }
+    view_move_cursor_(view, 0);
+}
+
+/* Format a collapsed hole as `OFFSET  * hole, N zero bytes up to END`. */
+static COPIED uint64_t view_format_hole_(BORROWED vib_view_t * view, COPIED vib_extent_t run, BORROWED char * line, COPIED uint64_t capacity, BORROWED vib_view_mark_t * marks)
+{
+    COPIED uint64_t n     = 0;
+    COPIED int      width = (int) view_digits_(view);
+
+    view_append_(line, &n, capacity, "%0*lX  ", width, run.offset);
+    COPIED uint64_t start = n;
+    view_append_(line, &n, capacity, "* hole, 0x%lX zero bytes up to %0*lX",
+                 run.length,
+                 width, run.offset + run.length);
+
+    if (run.offset <= view->cursor && view->cursor < run.offset + run.length)
+    {
+        marks[0].column = start;
+        marks[0].length = n - start;
+    }
+    return n;
+}
+
+/*
+ * Compose screen row `row` from the screen row starting at `offset`. A row
+ * the back grid already holds is left alone unless the cursor enters or
+ * leaves it.
+ */
+static void view_draw_row_(BORROWED vib_view_t * view, COPIED uint64_t row, COPIED uint64_t offset)
+{
+    static char line[VIB_VIEW_LINE_CAPACITY];
+
+    COPIED   vib_view_mark_t    marks[VIB_VIEW_MARKS] = { 0 };
+    COPIED   uint64_t           size   = vib_buffer_size(view->buffer);
+    COPIED   uint64_t           length = (offset < size) ? size - offset : 0;
+    BORROWED vib_view_drawn_t * drawn  = &view->drawn[row];
+
+    length = (length < view->bytes_per_row) ? length : view->bytes_per_row;
+    COPIED bool marked = offset <= view->cursor && view->cursor < offset + length;
+
+    COPIED vib_extent_t run = view_collapsed_(view, offset);
+    if (!run.length && !marked && !drawn->marked && EQ(drawn->offset, offset) && EQ(drawn->length, length))
+    {
+        return;
+    }
+
+    /* hole rows are rare and cheap, and their mark spans the whole run: never kept */
+    drawn->offset = run.length ? VIB_VIEW_NOWHERE : offset;
+    drawn->length = length;
+    drawn->marked = marked;
+
+    vib_screen_erase(row, 0);
+    if (offset >= size && (offset > 0 || size > 0))
+    {
+        vib_screen_put(row, 0, 0, "~");
+        return;
+    }
+
+    if (run.length)
+    {
+        view_format_hole_(view, run, line, sizeof(line), marks);
+        vib_screen_put(row, 0, 0, line);
+    }
+    else
+    {
+        BORROWED const uint8_t * classes    = NIL;
+        COPIED   uint64_t        classified = 0;
+        vib_screen_put(row, 0, 0, view_row_text_(view, offset, length, &classes, &classified));
+        view_row_colors_(view, row, classified, classes);
+        view_row_marks_(view, offset, length, marks);
+    }
+
+    for (uint64_t i = 0; i < VIB_VIEW_MARKS; i++)
+    {
+        vib_screen_paint(row, marks[i].column, marks[i].length, VIB_ATTR_REVERSED);
+    }
+}
+
+void vib_view_draw(BORROWED vib_view_t * view)
+{
+    view_lines_prepare_(view);
+
+    COPIED uint64_t offset = view->top;
+    for (uint64_t r = 0; r < view->rows; r++)
+    {
+        view_draw_row_(view, r, offset);
+        offset = view_row_next_(view, offset);
+    }
+
+    view_draw_status_(view);
+    vib_screen_present();
+}
+
+void vib_view_grown(BORROWED vib_view_t * view, COPIED uint64_t old_size)
+{
+    COPIED uint64_t size = vib_buffer_size(view->buffer);
+
+    /* like tail -f: a cursor parked on the last byte keeps following the end */
+    if (size > old_size && old_size > 0 && EQ(view->cursor, old_size - 1))
+    {
+        view->cursor = size - 1;
+    }
+    if (view->cursor >= size)
+    {
+        view->cursor = (size > 0) ? size - 1 : 0;
+    }
+
+    view_follow_cursor_(view);
+}